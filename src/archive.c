@@ -0,0 +1,515 @@
+/*
+ *
+ *  libr archive - Many resources packed into a single ELF section
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+/*
+ * Layout of the archive section (host byte order, like the resource headers):
+ *   "LPK1", uint32 number of entries, uint32 bytes of names, uint32 reserved
+ *   directory, sorted by name: uint64 offset, uint64 length, uint32 name offset, uint32 name length,
+ *     uint32 alignment, uint32 reserved
+ *   names, each followed by a NUL
+ *   resources, each a complete libr resource (header and stored data) on an aligned offset
+ */
+
+#include "archive.h"
+
+/* For malloc/free and qsort */
+#include <stdlib.h>
+
+/* For string handling */
+#include <string.h>
+
+#define ARCHIVE_MAGIC            "LPK1"
+#define ARCHIVE_HEADER           ((size_t) 16)
+#define ARCHIVE_ENTRY            ((size_t) 32)
+#define ARCHIVE_ALIGN            ((size_t) 8)
+#define ARCHIVE_MINSIZE          16
+#define OFFSET_COUNT             4
+#define OFFSET_NAMES             8
+#define ENTRY_OFFSET             0
+#define ENTRY_LENGTH             8
+#define ENTRY_NAME               16
+#define ENTRY_NAME_LENGTH        20
+#define ENTRY_ALIGNMENT          24
+
+/*
+ * Append an entry to the archive of a handle
+ */
+static libr_packed *archive_add(libr_archive *archive, const char *name, uint64_t offset, uint64_t length, size_t alignment, char *data)
+{
+	libr_packed **entries, *entry;
+	
+	if(archive->count == archive->max)
+	{
+		unsigned long max = (archive->max == 0 ? ARCHIVE_MINSIZE : archive->max*2);
+		
+		entries = (libr_packed **) realloc(archive->entries, max*sizeof(libr_packed *));
+		if(entries == NULL)
+			return NULL;
+		archive->entries = entries;
+		archive->max = max;
+	}
+	if((entry = (libr_packed *) calloc(1, sizeof(libr_packed))) == NULL)
+		return NULL;
+	if((entry->name = strdup(name)) == NULL)
+	{
+		free(entry);
+		return NULL;
+	}
+	entry->offset = offset;
+	entry->length = length;
+	entry->alignment = alignment;
+	entry->data = data;
+	entry->slot = archive->count;
+	if(!nameindex_add(&archive->names, entry->name, entry))
+	{
+		free(entry->name);
+		free(entry);
+		return NULL;
+	}
+	archive->entries[archive->count++] = entry;
+	return entry;
+}
+
+/*
+ * Check the header of an archive and find the size of its directory
+ */
+static libr_intstatus archive_header(const char *header, size_t section_length, uint32_t *count, uint32_t *names_size)
+{
+	if(memcmp(header, ARCHIVE_MAGIC, strlen(ARCHIVE_MAGIC)) != 0)
+		RETURN(LIBR_ERROR_NOTRESOURCE, "Not a valid libr-resource");
+	memcpy(count, &header[OFFSET_COUNT], sizeof(uint32_t));
+	memcpy(names_size, &header[OFFSET_NAMES], sizeof(uint32_t));
+	if(*count > (section_length-ARCHIVE_HEADER)/ARCHIVE_ENTRY
+		|| *names_size > section_length-ARCHIVE_HEADER-*count*ARCHIVE_ENTRY)
+		RETURN(LIBR_ERROR_SIZEMISMATCH, "Section's data size does not make sense");
+	RETURN_OK;
+}
+
+/*
+ * Add the entries of an archive directory (the offsets of the entries are taken from origin)
+ */
+static libr_intstatus archive_index(libr_archive *archive, const char *directory, uint32_t count, uint32_t names_size,
+	size_t section_length, uint64_t origin)
+{
+	uint32_t name_offset, name_length, alignment;
+	const char *names = &directory[count*ARCHIVE_ENTRY];
+	uint64_t offset, length;
+	unsigned long i;
+	
+	for(i=0;i<count;i++)
+	{
+		const char *record = &directory[i*ARCHIVE_ENTRY];
+		
+		memcpy(&offset, &record[ENTRY_OFFSET], sizeof(uint64_t));
+		memcpy(&length, &record[ENTRY_LENGTH], sizeof(uint64_t));
+		memcpy(&name_offset, &record[ENTRY_NAME], sizeof(uint32_t));
+		memcpy(&name_length, &record[ENTRY_NAME_LENGTH], sizeof(uint32_t));
+		memcpy(&alignment, &record[ENTRY_ALIGNMENT], sizeof(uint32_t));
+		if(offset > section_length || length > section_length-offset
+			|| name_offset >= names_size || name_length >= names_size-name_offset || names[name_offset+name_length] != '\0'
+			|| alignment == 0 || (alignment & (alignment-1)) != 0)
+			RETURN(LIBR_ERROR_SIZEMISMATCH, "Section's data size does not make sense");
+		if(archive_add(archive, &names[name_offset], origin+offset, length, alignment, NULL) == NULL)
+			RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	}
+	RETURN_OK;
+}
+
+/*
+ * Index the archives of an image loaded into memory (the offsets of the entries are addresses)
+ */
+static libr_intstatus archive_load_image(libr_file *file_handle)
+{
+	libr_archive *archive = &file_handle->front.archive;
+	libr_image *image = &file_handle->front.image;
+	uint32_t count, names_size, total = 0;
+	libr_intstatus ret;
+	unsigned long i;
+	
+	for(i=0;i<image->count;i++)
+	{
+		if(image->sizes[i] < ARCHIVE_HEADER)
+			RETURN(LIBR_ERROR_SIZEMISMATCH, "Section's data size does not make sense");
+		if((ret = archive_header(image->archives[i], image->sizes[i], &count, &names_size)).status != LIBR_OK)
+			return ret;
+		total += count;
+	}
+	if(!nameindex_init(&archive->names, total, false))
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	archive->loaded = true;
+	for(i=0;i<image->count;i++)
+	{
+		archive_header(image->archives[i], image->sizes[i], &count, &names_size);
+		ret = archive_index(archive, &image->archives[i][ARCHIVE_HEADER], count, names_size, image->sizes[i],
+			(uint64_t) (uintptr_t) image->archives[i]);
+		if(ret.status != LIBR_OK)
+		{
+			archive_free(file_handle);
+			return ret;
+		}
+	}
+	RETURN_OK;
+}
+
+/*
+ * Find the section the archive is read from, a program linked with the archive of
+ * libr_open_embed only carries it in the loaded section
+ */
+libr_intstatus archive_section(libr_file *file_handle, libr_section **scn)
+{
+	libr_intstatus ret;
+	
+	ret = find_section(file_handle, ARCHIVE_SECTION, scn);
+	if(ret.status == LIBR_ERROR_NOSECTION)
+		ret = find_section(file_handle, ARCHIVE_LOADED_SECTION, scn);
+	return ret;
+}
+
+/*
+ * Read the directory of the archive section (only done once per handle)
+ */
+libr_intstatus archive_load(libr_file *file_handle)
+{
+	libr_archive *archive = &file_handle->front.archive;
+	uint32_t count = 0, names_size = 0;
+	size_t section_length, directory_size;
+	char header[ARCHIVE_HEADER], *directory;
+	libr_section *scn = NULL;
+	libr_intstatus ret;
+	
+	if(archive->loaded)
+		RETURN_OK;
+	if(file_handle->front.image.loaded)
+		return archive_load_image(file_handle);
+	/* Sources for linking start out without an archive */
+	if(!file_handle->front.embed.enabled)
+	{
+		ret = archive_section(file_handle, &scn);
+		if(ret.status != LIBR_OK && ret.status != LIBR_ERROR_NOSECTION)
+			return ret;
+		if(ret.status == LIBR_OK)
+		{
+			section_length = section_size(file_handle, scn);
+			if(read_section(file_handle, scn, 0, header, ARCHIVE_HEADER) != ARCHIVE_HEADER)
+				RETURN(LIBR_ERROR_NOTRESOURCE, "Not a valid libr-resource");
+			if((ret = archive_header(header, section_length, &count, &names_size)).status != LIBR_OK)
+				return ret;
+		}
+	}
+	if(!nameindex_init(&archive->names, count, false))
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	archive->loaded = true;
+	if(count == 0)
+		RETURN_OK;
+	/* The whole directory (and the names following it) is read at once */
+	directory_size = count*ARCHIVE_ENTRY+names_size;
+	if((directory = (char *) malloc(directory_size)) == NULL)
+	{
+		archive_free(file_handle);
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	}
+	if(read_section(file_handle, scn, ARCHIVE_HEADER, directory, directory_size) != directory_size)
+	{
+		free(directory);
+		archive_free(file_handle);
+		RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+	}
+	ret = archive_index(archive, directory, count, names_size, section_length, 0);
+	free(directory);
+	if(ret.status != LIBR_OK)
+		archive_free(file_handle);
+	return ret;
+}
+
+/*
+ * Find a resource in the archive
+ */
+libr_intstatus archive_find(libr_file *file_handle, const char *name, libr_packed **entry)
+{
+	libr_intstatus ret;
+	
+	ret = archive_load(file_handle);
+	if(ret.status != LIBR_OK)
+		return ret;
+	if((*entry = (libr_packed *) nameindex_find(&file_handle->front.archive.names, name)) == NULL)
+		RETURN(LIBR_ERROR_NOSECTION, "ELF resource section not found");
+	RETURN_OK;
+}
+
+/*
+ * Add (or replace) a resource in the archive, the archive takes over the data
+ */
+libr_intstatus archive_put(libr_file *file_handle, const char *name, char *data, size_t length, size_t alignment)
+{
+	libr_packed *entry;
+	libr_intstatus ret;
+	
+	ret = archive_load(file_handle);
+	if(ret.status != LIBR_OK)
+	{
+		free(data);
+		return ret;
+	}
+	if((entry = (libr_packed *) nameindex_find(&file_handle->front.archive.names, name)) != NULL)
+	{
+		free(entry->data);
+		entry->data = data;
+		entry->length = length;
+		entry->alignment = alignment;
+		entry->raw = false;
+	}
+	else if(archive_add(&file_handle->front.archive, name, 0, length, alignment, data) == NULL)
+	{
+		free(data);
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	}
+	file_handle->front.archive.changed = true;
+	RETURN_OK;
+}
+
+/*
+ * Remove a resource from the archive
+ */
+void archive_remove(libr_file *file_handle, libr_packed *entry)
+{
+	libr_archive *archive = &file_handle->front.archive;
+	
+	nameindex_remove(&archive->names, entry->name, entry);
+	/* The last entry fills the gap (the directory is sorted when it is written) */
+	archive->entries[entry->slot] = archive->entries[--archive->count];
+	archive->entries[entry->slot]->slot = entry->slot;
+	free(entry->data);
+	free(entry->name);
+	free(entry);
+	archive->changed = true;
+}
+
+/*
+ * Return an entry of the archive by position (NULL past the last entry)
+ */
+libr_packed *archive_entry(libr_file *file_handle, unsigned long index)
+{
+	if(index >= file_handle->front.archive.count)
+		return NULL;
+	return file_handle->front.archive.entries[index];
+}
+
+/*
+ * Order entries by name
+ */
+static int compare_entries(const void *a, const void *b)
+{
+	return strcmp((*(libr_packed **) a)->name, (*(libr_packed **) b)->name);
+}
+
+/*
+ * Remove the archive section once the last resource is gone
+ */
+static libr_intstatus archive_clear(libr_file *file_handle, libr_section *scn)
+{
+	libr_data *data;
+	libr_intstatus ret;
+	
+	if((data = get_data(file_handle, scn)) == NULL)
+		RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+	ret = set_data(file_handle, scn, data, 0, NULL, 0);
+	free_data(file_handle, scn, data);
+	if(ret.status != LIBR_OK)
+		return ret;
+	return remove_section(file_handle, scn);
+}
+
+/*
+ * Lay out the directory (sorted by name) followed by the names and the aligned resources,
+ * resources that were already written are carried over from the old section "scn"
+ */
+static libr_intstatus archive_layout(libr_file *file_handle, libr_section *scn, char **archive_buffer, size_t *archive_size,
+	uint64_t **archive_offsets, size_t *archive_alignment)
+{
+	size_t names_size = 0, name_position = 0, position, alignment = ARCHIVE_ALIGN;
+	libr_archive *archive = &file_handle->front.archive;
+	uint64_t *offsets;
+	uint32_t field;
+	unsigned long i;
+	char *buffer;
+	
+	qsort(archive->entries, archive->count, sizeof(libr_packed *), compare_entries);
+	for(i=0;i<archive->count;i++)
+	{
+		archive->entries[i]->slot = i;
+		names_size += strlen(archive->entries[i]->name)+1;
+		if(archive->entries[i]->alignment > alignment)
+			alignment = archive->entries[i]->alignment;
+	}
+	if((offsets = (uint64_t *) malloc(archive->count*sizeof(uint64_t))) == NULL)
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	position = ARCHIVE_HEADER+archive->count*ARCHIVE_ENTRY+names_size;
+	for(i=0;i<archive->count;i++)
+	{
+		size_t boundary = (archive->entries[i]->alignment > ARCHIVE_ALIGN ? archive->entries[i]->alignment : ARCHIVE_ALIGN);
+		
+		position = (position+boundary-1) & ~(boundary-1);
+		offsets[i] = position;
+		position += archive->entries[i]->length;
+	}
+	if((buffer = (char *) calloc(1, position)) == NULL)
+	{
+		free(offsets);
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	}
+	memcpy(buffer, ARCHIVE_MAGIC, strlen(ARCHIVE_MAGIC));
+	field = archive->count;
+	memcpy(&buffer[OFFSET_COUNT], &field, sizeof(uint32_t));
+	field = names_size;
+	memcpy(&buffer[OFFSET_NAMES], &field, sizeof(uint32_t));
+	for(i=0;i<archive->count;i++)
+	{
+		char *record = &buffer[ARCHIVE_HEADER+i*ARCHIVE_ENTRY];
+		libr_packed *entry = archive->entries[i];
+		uint64_t length = entry->length;
+		
+		memcpy(&record[ENTRY_OFFSET], &offsets[i], sizeof(uint64_t));
+		memcpy(&record[ENTRY_LENGTH], &length, sizeof(uint64_t));
+		field = name_position;
+		memcpy(&record[ENTRY_NAME], &field, sizeof(uint32_t));
+		field = entry->alignment;
+		memcpy(&record[ENTRY_ALIGNMENT], &field, sizeof(uint32_t));
+		field = strlen(entry->name);
+		memcpy(&record[ENTRY_NAME_LENGTH], &field, sizeof(uint32_t));
+		strcpy(&buffer[ARCHIVE_HEADER+archive->count*ARCHIVE_ENTRY+name_position], entry->name);
+		name_position += field+1;
+		if(entry->data != NULL)
+			memcpy(&buffer[offsets[i]], entry->data, entry->length);
+		else if(scn == NULL || read_section(file_handle, scn, entry->offset, &buffer[offsets[i]], entry->length) != entry->length)
+		{
+			free(buffer);
+			free(offsets);
+			RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+		}
+	}
+	*archive_buffer = buffer;
+	*archive_size = position;
+	*archive_offsets = offsets;
+	*archive_alignment = alignment;
+	RETURN_OK;
+}
+
+/*
+ * Build the archive in memory (for handles that have no section to write it to)
+ */
+libr_intstatus archive_image(libr_file *file_handle, char **buffer, size_t *size, size_t *alignment)
+{
+	uint64_t *offsets;
+	libr_intstatus ret;
+	
+	ret = archive_layout(file_handle, NULL, buffer, size, &offsets, alignment);
+	if(ret.status == LIBR_OK)
+		free(offsets);
+	return ret;
+}
+
+/*
+ * Write out the archive section with the changes made to the archive
+ */
+libr_intstatus archive_flush(libr_file *file_handle)
+{
+	libr_archive *archive = &file_handle->front.archive;
+	libr_section *scn = NULL, *source = NULL;
+	size_t position, alignment;
+	libr_data *data = NULL;
+	uint64_t *offsets;
+	libr_intstatus ret;
+	unsigned long i;
+	char *buffer;
+	
+	if(!archive->loaded || !archive->changed)
+		RETURN_OK;
+	ret = find_section(file_handle, ARCHIVE_SECTION, &scn);
+	if(ret.status != LIBR_OK && ret.status != LIBR_ERROR_NOSECTION)
+		return ret;
+	if(ret.status == LIBR_OK)
+		source = scn;
+	else
+	{
+		scn = NULL;
+		/* The loaded section is left alone (the note points at it), its resources move to a new archive */
+		ret = find_section(file_handle, ARCHIVE_LOADED_SECTION, &source);
+		if(ret.status != LIBR_OK && ret.status != LIBR_ERROR_NOSECTION)
+			return ret;
+		if(ret.status != LIBR_OK)
+			source = NULL;
+	}
+	/* An empty archive still has to hide the one in the loaded section */
+	if(archive->count == 0 && (source == NULL || source == scn))
+	{
+		if(scn != NULL && (ret = archive_clear(file_handle, scn)).status != LIBR_OK)
+			return ret;
+		archive->changed = false;
+		RETURN_OK;
+	}
+	if((ret = archive_layout(file_handle, source, &buffer, &position, &offsets, &alignment)).status != LIBR_OK)
+		return ret;
+	if(scn == NULL)
+	{
+		if((ret = add_section(file_handle, ARCHIVE_SECTION, &scn)).status == LIBR_OK && (data = new_data(file_handle, scn)) == NULL)
+			ret = SET_ERROR(LIBR_ERROR_NEWDATA, "Failed to create data for section");
+	}
+	else if((data = get_data(file_handle, scn)) == NULL)
+		ret = SET_ERROR(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+	/* The resources are only aligned within the file when the section is */
+	if(ret.status == LIBR_OK)
+		ret = set_alignment(file_handle, scn, alignment);
+	if(ret.status == LIBR_OK && (ret = set_data(file_handle, scn, data, 0, buffer, position)).status != LIBR_OK)
+		free_data(file_handle, scn, data);
+	if(ret.status == LIBR_OK)
+	{
+		for(i=0;i<archive->count;i++)
+		{
+			archive->entries[i]->offset = offsets[i];
+			free(archive->entries[i]->data);
+			archive->entries[i]->data = NULL;
+		}
+		archive->changed = false;
+	}
+	free(buffer);
+	free(offsets);
+	return ret;
+}
+
+/*
+ * Release the archive of a handle (changes that were not flushed are lost)
+ */
+void archive_free(libr_file *file_handle)
+{
+	libr_archive *archive = &file_handle->front.archive;
+	int enabled = archive->enabled;
+	unsigned long i;
+	
+	for(i=0;i<archive->count;i++)
+	{
+		free(archive->entries[i]->data);
+		free(archive->entries[i]->name);
+		free(archive->entries[i]);
+	}
+	free(archive->entries);
+	nameindex_free(&archive->names);
+	memset(archive, 0, sizeof(libr_archive));
+	archive->enabled = enabled;
+}
@@ -0,0 +1,31 @@
+#ifndef __ARCHIVE_H
+#define __ARCHIVE_H
+
+#include "libr.h"
+
+/* Section holding the resources written in archive mode */
+#define ARCHIVE_SECTION ".libr.pack"
+
+/* Section holding an archive that is loaded with the image (see libr_open_embed) */
+#define ARCHIVE_LOADED_SECTION ".libr.loaded"
+
+/*
+ * Note pointing at an archive that is loaded with the image (see libr_open_loaded),
+ * the descriptor holds the signed offset of the archive from the start of the descriptor
+ * followed by the size of the archive (both the size of a pointer)
+ */
+#define ARCHIVE_NOTE_NAME "libr"
+#define ARCHIVE_NOTE_TYPE 0x4c504b31
+#define ARCHIVE_NOTE_SIZE (2*sizeof(intptr_t))
+
+libr_intstatus archive_section(libr_file *file_handle, libr_section **scn);
+libr_intstatus archive_load(libr_file *file_handle);
+libr_intstatus archive_find(libr_file *file_handle, const char *name, libr_packed **entry);
+libr_intstatus archive_put(libr_file *file_handle, const char *name, char *data, size_t length, size_t alignment);
+void archive_remove(libr_file *file_handle, libr_packed *entry);
+libr_packed *archive_entry(libr_file *file_handle, unsigned long index);
+libr_intstatus archive_flush(libr_file *file_handle);
+libr_intstatus archive_image(libr_file *file_handle, char **buffer, size_t *size, size_t *alignment);
+void archive_free(libr_file *file_handle);
+
+#endif /* __ARCHIVE_H */
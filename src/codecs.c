@@ -0,0 +1,199 @@
+/*
+ *
+ *  libr codecs - Registry of the compression methods used to store resources
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+/* Include compile-time parameters */
+#include "config.h"
+
+#include "libr.h"
+#include "codecs.h"
+
+/* For C99 number types */
+#include <stdint.h>
+
+/* For INT_MAX */
+#include <limits.h>
+
+/* Compression libraries */
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
+/*
+ * Largest possible zlib stream for a buffer
+ */
+static size_t zlib_bound(size_t size)
+{
+	return compressBound(size);
+}
+
+/*
+ * Compress a buffer as a zlib stream
+ */
+static int zlib_pack(char *output, size_t *output_size, char *input, size_t size, int level)
+{
+	uLongf packed_size = *output_size;
+	
+	if(level == CODEC_DEFAULT_LEVEL)
+		level = Z_DEFAULT_COMPRESSION;
+	else if(level > Z_BEST_COMPRESSION)
+		level = Z_BEST_COMPRESSION;
+	if(compress2((Bytef *) output, &packed_size, (Bytef *) input, size, level) != Z_OK)
+		return false;
+	*output_size = packed_size;
+	return true;
+}
+
+/*
+ * Uncompress a zlib stream
+ */
+static int zlib_unpack(char *output, size_t size, char *input, size_t input_size)
+{
+	uLongf unpacked_size = size;
+	
+	return (uncompress((Bytef *) output, &unpacked_size, (Bytef *) input, input_size) == Z_OK
+		&& unpacked_size == size);
+}
+
+#ifdef HAVE_ZSTD
+
+/*
+ * Largest possible zstd frame for a buffer
+ */
+static size_t zstd_bound(size_t size)
+{
+	return ZSTD_compressBound(size);
+}
+
+/*
+ * Compress a buffer as a zstd frame (level 0 is the zstd default)
+ */
+static int zstd_pack(char *output, size_t *output_size, char *input, size_t size, int level)
+{
+	size_t ret;
+	
+	if(level > ZSTD_maxCLevel())
+		level = ZSTD_maxCLevel();
+	ret = ZSTD_compress(output, *output_size, input, size, level);
+	if(ZSTD_isError(ret))
+		return false;
+	*output_size = ret;
+	return true;
+}
+
+/*
+ * Uncompress a zstd frame
+ */
+static int zstd_unpack(char *output, size_t size, char *input, size_t input_size)
+{
+	size_t ret = ZSTD_decompress(output, size, input, input_size);
+	
+	return (!ZSTD_isError(ret) && ret == size);
+}
+
+#endif /* HAVE_ZSTD */
+
+#ifdef HAVE_LZ4
+
+/*
+ * Largest possible lz4 block for a buffer (0 if the buffer is too large for lz4)
+ */
+static size_t lz4_bound(size_t size)
+{
+	if(size > LZ4_MAX_INPUT_SIZE)
+		return 0;
+	return LZ4_compressBound((int) size);
+}
+
+/*
+ * Compress a buffer as an lz4 block (lz4 has a single level)
+ */
+static int lz4_pack(char *output, size_t *output_size, char *input, size_t size, int level)
+{
+	int capacity = (*output_size > INT_MAX ? INT_MAX : (int) *output_size), ret;
+	
+	if(size > LZ4_MAX_INPUT_SIZE)
+		return false;
+	if((ret = LZ4_compress_default(input, output, (int) size, capacity)) <= 0)
+		return false;
+	*output_size = ret;
+	return true;
+}
+
+/*
+ * Uncompress an lz4 block
+ */
+static int lz4_unpack(char *output, size_t size, char *input, size_t input_size)
+{
+	if(size > INT_MAX || input_size > INT_MAX)
+		return false;
+	return (LZ4_decompress_safe(input, output, (int) input_size, (int) size) == (int) size);
+}
+
+#endif /* HAVE_LZ4 */
+
+/* Every codec known to libr, whether or not this build can use it */
+static const libr_codec codecs[] = {
+	{LIBR_COMPRESSED, "zlib", 9, zlib_bound, zlib_pack, zlib_unpack},
+#ifdef HAVE_ZSTD
+	{LIBR_ZSTD, "zstd", 22, zstd_bound, zstd_pack, zstd_unpack},
+#else
+	{LIBR_ZSTD, "zstd", 22, NULL, NULL, NULL},
+#endif
+#ifdef HAVE_LZ4
+	{LIBR_LZ4, "lz4", 0, lz4_bound, lz4_pack, lz4_unpack},
+#else
+	{LIBR_LZ4, "lz4", 0, NULL, NULL, NULL},
+#endif
+};
+
+/*
+ * Find the codec used for a storage type (NULL if the type is not a codec)
+ */
+const libr_codec *codec_find(int type)
+{
+	unsigned int i;
+	
+	for(i = 0; i < sizeof(codecs)/sizeof(codecs[0]); i++)
+	{
+		if(codecs[i].type == type)
+			return &codecs[i];
+	}
+	return NULL;
+}
+
+/*
+ * Find the highest compression level accepted by a codec of this build
+ */
+int codec_max_level(void)
+{
+	unsigned int i;
+	int level = 0;
+	
+	for(i = 0; i < sizeof(codecs)/sizeof(codecs[0]); i++)
+	{
+		if(codecs[i].pack != NULL && codecs[i].max_level > level)
+			level = codecs[i].max_level;
+	}
+	return level;
+}
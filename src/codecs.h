@@ -0,0 +1,28 @@
+#ifndef __CODECS_H
+#define __CODECS_H
+
+/* For size_t */
+#include <stddef.h>
+
+/* Level passed to a codec to use its own default */
+#define CODEC_DEFAULT_LEVEL 0
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+/* Compression method storing a resource in one piece, keyed by the header type byte */
+typedef struct {
+	int type;                 /* libr_type_t value stored in the resource header */
+	const char *name;
+	int max_level;            /* highest compression level (0 for a codec with a single level) */
+	/* The functions are NULL when libr is built without the library */
+	size_t (*bound)(size_t size);
+	int (*pack)(char *output, size_t *output_size, char *input, size_t size, int level);
+	int (*unpack)(char *output, size_t size, char *input, size_t input_size);
+} libr_codec;
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+const libr_codec *codec_find(int type);
+int codec_max_level(void);
+
+#endif /* __CODECS_H */
@@ -0,0 +1,190 @@
+/*
+ *
+ *  libr embed - Write resources as assembler source for linking into a program
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+/*
+ * The resources are written as an archive (see archive.c) to a data file next to the source,
+ * the source pulls the archive into a loaded, read-only section with .incbin and adds the note
+ * that libr_open_self_mapped and libr_open_loaded look for:
+ *   namesz, descsz, type "LPK1", "libr"
+ *   descriptor: the offset of the archive from the descriptor, the size of the archive
+ *     (both address-sized, so that the linker resolves the offset)
+ *
+ * Nothing about the build (paths, times) ends up in the archive, which is sorted by name,
+ * so the same resources always give the same object.
+ */
+
+#include "embed.h"
+#include "archive.h"
+
+/* For malloc/free */
+#include <stdlib.h>
+
+/* For writing the source */
+#include <stdio.h>
+
+/* For string handling */
+#include <string.h>
+
+/* For removing partially written files */
+#include <unistd.h>
+
+#define EMBED_DATA_EXT           ".pack"
+
+/*
+ * Collect a resource for the source (the contents are encoded when the source is written)
+ */
+libr_intstatus embed_put(libr_file *file_handle, const char *name, char *buffer, size_t size, libr_type_t type, int overwrite)
+{
+	libr_packed *entry = NULL;
+	libr_intstatus ret;
+	char *data;
+	
+	if(archive_find(file_handle, name, &entry).status == LIBR_OK && !overwrite)
+		RETURN(LIBR_ERROR_OVERWRITE, "Section already exists, over-write not specified");
+	/* NOTE: malloc(0) is not guaranteed to return a buffer */
+	if((data = (char *) malloc(size == 0 ? 1 : size)) == NULL)
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	memcpy(data, buffer, size);
+	ret = archive_put(file_handle, name, data, size, file_handle->front.policy.alignment);
+	if(ret.status != LIBR_OK)
+		return ret;
+	if((ret = archive_find(file_handle, name, &entry)).status != LIBR_OK)
+		return ret;
+	entry->raw = true;
+	entry->type = type;
+	RETURN_OK;
+}
+
+/*
+ * Name of the file holding the archive ("resources.S" keeps its archive in "resources.pack")
+ */
+static char *embed_data_name(const char *output)
+{
+	const char *slash = strrchr(output, '/'), *dot = strrchr(output, '.');
+	size_t length = strlen(output);
+	char *name;
+	
+	if(dot != NULL && (slash == NULL || dot > slash) && strcmp(dot, EMBED_DATA_EXT) != 0)
+		length = dot-output;
+	if((name = (char *) malloc(length+strlen(EMBED_DATA_EXT)+1)) == NULL)
+		return NULL;
+	memcpy(name, output, length);
+	strcpy(&name[length], EMBED_DATA_EXT);
+	return name;
+}
+
+/*
+ * Write a string for the assembler (quoted, with quotes and backslashes escaped)
+ */
+static void embed_quote(FILE *source, const char *string)
+{
+	fputc('"', source);
+	for(; *string != '\0'; string++)
+	{
+		if(*string == '"' || *string == '\\')
+			fputc('\\', source);
+		fputc(*string, source);
+	}
+	fputc('"', source);
+}
+
+/*
+ * Write the archive and the assembler source for the resources collected by the handle
+ */
+libr_intstatus embed_write(libr_file *file_handle)
+{
+	char *buffer = NULL, *data_name;
+	size_t size = 0, alignment = 1;
+	FILE *data, *source;
+	libr_intstatus ret;
+	int failed;
+	
+	if(!file_handle->front.archive.changed)
+		RETURN_OK;
+	if((ret = archive_load(file_handle)).status != LIBR_OK)
+		return ret;
+	if(file_handle->front.archive.count != 0 && (ret = archive_image(file_handle, &buffer, &size, &alignment)).status != LIBR_OK)
+		return ret;
+	if((data_name = embed_data_name(file_handle->front.embed.output)) == NULL)
+	{
+		free(buffer);
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	}
+	if((data = fopen(data_name, "wb")) == NULL)
+	{
+		free(data_name);
+		free(buffer);
+		RETURN(LIBR_ERROR_WRITEPERM, "No write permission for file");
+	}
+	failed = (fwrite(buffer, 1, size, data) != size);
+	failed |= (fclose(data) != 0);
+	free(buffer);
+	if(failed || (source = fopen(file_handle->front.embed.output, "w")) == NULL)
+	{
+		/* A partial archive must not be linked in */
+		unlink(data_name);
+		free(data_name);
+		RETURN(LIBR_ERROR_WRITEPERM, "No write permission for file");
+	}
+	fprintf(source, "/* Resources for libr_open_self_mapped and libr_open_loaded (written by libr) */\n");
+	/* Without any resources there is nothing for the note to point at */
+	if(size != 0)
+	{
+		fprintf(source, "\t.section .note.libr,\"a\",%%note\n");
+		fprintf(source, "\t.balign 4\n");
+		fprintf(source, "\t.long 2f-1f\n");
+		fprintf(source, "\t.long 4f-3f\n");
+		fprintf(source, "\t.long 0x%lx\n", (unsigned long) ARCHIVE_NOTE_TYPE);
+		fprintf(source, "1:\t.asciz \"%s\"\n", ARCHIVE_NOTE_NAME);
+		fprintf(source, "2:\t.balign 4\n");
+		fprintf(source, "3:\t.dc.a .Llibr_archive-3b\n");
+		fprintf(source, "\t.dc.a %lu\n", (unsigned long) size);
+		fprintf(source, "4:\t.balign 4\n");
+		fprintf(source, "\t.section %s,\"a\",%%progbits\n", ARCHIVE_LOADED_SECTION);
+		fprintf(source, "\t.balign %lu\n", (unsigned long) alignment);
+		fprintf(source, ".Llibr_archive:\n");
+		fprintf(source, "\t.incbin ");
+		embed_quote(source, data_name);
+		fprintf(source, "\n");
+	}
+	/* The resources never need an executable stack */
+	fprintf(source, "\t.section .note.GNU-stack,\"\",%%progbits\n");
+	failed = (ferror(source) != 0);
+	failed |= (fclose(source) != 0);
+	if(failed)
+	{
+		unlink(file_handle->front.embed.output);
+		unlink(data_name);
+		free(data_name);
+		RETURN(LIBR_ERROR_WRITEPERM, "No write permission for file");
+	}
+	free(data_name);
+	file_handle->front.archive.changed = false;
+	RETURN_OK;
+}
+
+/*
+ * Forget the resources collected since the source was last written (closing the handle
+ * then leaves the source and archive alone)
+ */
+void embed_discard(libr_file *file_handle)
+{
+	file_handle->front.archive.changed = false;
+}
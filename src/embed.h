@@ -0,0 +1,10 @@
+#ifndef __EMBED_H
+#define __EMBED_H
+
+#include "libr.h"
+
+libr_intstatus embed_put(libr_file *file_handle, const char *name, char *buffer, size_t size, libr_type_t type, int overwrite);
+libr_intstatus embed_write(libr_file *file_handle);
+void embed_discard(libr_file *file_handle);
+
+#endif /* __EMBED_H */
@@ -6,15 +6,23 @@
  * from leaving out one of these critical functions.
  */
 INTERNAL_FN libr_intstatus add_section(libr_file *file_handle, char *resource_name, libr_section **retscn);
+INTERNAL_FN libr_intstatus begin_update(libr_file *file_handle);
+INTERNAL_FN libr_intstatus commit_update(libr_file *file_handle);
 INTERNAL_FN void *data_pointer(libr_section *scn, libr_data *data);
 INTERNAL_FN size_t data_size(libr_section *scn, libr_data *data);
 INTERNAL_FN libr_intstatus find_section(libr_file *file_handle, char *section, libr_section **retscn);
+INTERNAL_FN void free_data(libr_file *file_handle, libr_section *scn, libr_data *data);
 INTERNAL_FN libr_data *get_data(libr_file *file_handle, libr_section *scn);
 INTERNAL_FN void initialize_backend(void);
+INTERNAL_FN int input_descriptor(libr_file *file_handle);
 INTERNAL_FN libr_data *new_data(libr_file *file_handle, libr_section *scn);
 INTERNAL_FN libr_section *next_section(libr_file *file_handle, libr_section *scn);
+INTERNAL_FN size_t read_section(libr_file *file_handle, libr_section *scn, off_t offset, char *buffer, size_t size);
 INTERNAL_FN libr_intstatus remove_section(libr_file *file_handle, libr_section *scn);
 INTERNAL_FN char *section_name(libr_file *file_handle, libr_section *scn);
+INTERNAL_FN off_t section_offset(libr_file *file_handle, libr_section *scn);
+INTERNAL_FN size_t section_size(libr_file *file_handle, libr_section *scn);
+INTERNAL_FN libr_intstatus set_alignment(libr_file *file_handle, libr_section *scn, size_t alignment);
 INTERNAL_FN libr_intstatus set_data(libr_file *file_handle, libr_section *scn, libr_data *data, off_t offset, char *buffer, size_t size);
 INTERNAL_FN libr_intstatus open_handles(libr_file *file_handle, char *filename, libr_access_t access);
 INTERNAL_FN void write_output(libr_file *file_handle);
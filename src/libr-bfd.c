@@ -37,22 +37,86 @@
 /* Safe rename requires some errno() knowledge */
 #include <errno.h>
 
+/* ELF structures for writing changes in place */
+#include <elf.h>
+
 #include <sys/stat.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
 
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+/*
+ * Appending leaves the old copies of the sections behind, the file is rebuilt (dropping them)
+ * once the unused bytes exceed both the minimum and the given fraction of the bytes in use
+ */
+#define APPEND_DEAD_MIN          (64*1024)
+#define APPEND_DEAD_FRACTION     4
+
+/*
+ * ELF header and section header table of the input file
+ * (32-bit files are widened to the 64-bit structures while they are edited)
+ */
+typedef struct {
+	int elfclass;
+	Elf64_Ehdr ehdr;
+	Elf64_Shdr *shdrs;
+	char *strtab;
+	size_t strtab_size;
+} elf_layout;
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+/* Copy the ELF header fields between the 32-bit and 64-bit structures */
+#define COPY_EHDR(to, from) \
+	memcpy((to)->e_ident, (from)->e_ident, EI_NIDENT); \
+	(to)->e_type = (from)->e_type; \
+	(to)->e_machine = (from)->e_machine; \
+	(to)->e_version = (from)->e_version; \
+	(to)->e_entry = (from)->e_entry; \
+	(to)->e_phoff = (from)->e_phoff; \
+	(to)->e_shoff = (from)->e_shoff; \
+	(to)->e_flags = (from)->e_flags; \
+	(to)->e_ehsize = (from)->e_ehsize; \
+	(to)->e_phentsize = (from)->e_phentsize; \
+	(to)->e_phnum = (from)->e_phnum; \
+	(to)->e_shentsize = (from)->e_shentsize; \
+	(to)->e_shnum = (from)->e_shnum; \
+	(to)->e_shstrndx = (from)->e_shstrndx
+
+/* Copy the section header fields between the 32-bit and 64-bit structures */
+#define COPY_SHDR(to, from) \
+	(to)->sh_name = (from)->sh_name; \
+	(to)->sh_type = (from)->sh_type; \
+	(to)->sh_flags = (from)->sh_flags; \
+	(to)->sh_addr = (from)->sh_addr; \
+	(to)->sh_offset = (from)->sh_offset; \
+	(to)->sh_size = (from)->sh_size; \
+	(to)->sh_link = (from)->sh_link; \
+	(to)->sh_info = (from)->sh_info; \
+	(to)->sh_addralign = (from)->sh_addralign; \
+	(to)->sh_entsize = (from)->sh_entsize
+
 /*
  * Build the libr_file handle for processing with libbfd
  */
 libr_intstatus open_handles(libr_file *file_handle, char *filename, libr_access_t access)
 {
 	bfd *handle = NULL;
+	int fd_input, fd_bfd;
 	
-	handle = bfd_openr(filename, "default");
-	if(!handle)
+	/* libbfd reads through a copy of a descriptor that stays open for mapping the same file */
+	if((fd_input = open(filename, O_RDONLY)) == ERROR)
+		RETURN(LIBR_ERROR_OPENFAILED, "Failed to open input file");
+	/* NOTE: libbfd closes its copy when it fails to open the file */
+	if((fd_bfd = dup(fd_input)) == ERROR || (handle = bfd_fdopenr(filename, "default", fd_bfd)) == NULL)
+	{
+		close(fd_input);
 		RETURN(LIBR_ERROR_OPENFAILED, "Failed to open input file");
+	}
+	file_handle->fd_input = fd_input;
 	if(!bfd_check_format(handle, bfd_object))
 		RETURN(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: not a libbfd object");
 	if(bfd_get_flavour(handle) != bfd_target_elf_flavour)
@@ -61,6 +125,7 @@ libr_intstatus open_handles(libr_file *file_handle, char *filename, libr_access_
 	file_handle->filename = filename;
 	file_handle->bfd_read = handle;
 	file_handle->access = access;
+	file_handle->section_count = bfd_count_sections(handle);
 	if(access == LIBR_READ_WRITE)
 	{
 		struct stat file_stat;
@@ -98,6 +163,14 @@ libr_intstatus open_handles(libr_file *file_handle, char *filename, libr_access_
 	RETURN_OK;
 }
 
+/*
+ * Return the descriptor of the file that was parsed
+ */
+int input_descriptor(libr_file *file_handle)
+{
+	return file_handle->fd_input;
+}
+
 /*
  * Check to see if a symbol should be kept
  */
@@ -326,6 +399,299 @@ int safe_rename(const char *old, const char *new)
 	return remove(old);
 }
 
+/*
+ * Read the ELF header, section header table and section name table of the input file
+ * (only files in the byte order of the host are handled)
+ */
+int read_layout(int fd, elf_layout *layout)
+{
+	const uint16_t byte_order = 1;
+	unsigned char host_data;
+	Elf64_Shdr *strshdr;
+	Elf32_Ehdr ehdr32;
+	Elf32_Shdr shdr32;
+	size_t shdr_size;
+	unsigned int i;
+	
+	memset(layout, 0, sizeof(elf_layout));
+	host_data = (*((char *) &byte_order) == 1 ? ELFDATA2LSB : ELFDATA2MSB);
+	if(pread(fd, layout->ehdr.e_ident, EI_NIDENT, 0) != EI_NIDENT)
+		return false;
+	if(memcmp(layout->ehdr.e_ident, ELFMAG, SELFMAG) != 0 || layout->ehdr.e_ident[EI_DATA] != host_data)
+		return false;
+	layout->elfclass = layout->ehdr.e_ident[EI_CLASS];
+	switch(layout->elfclass)
+	{
+		case ELFCLASS32:
+			if(pread(fd, &ehdr32, sizeof(Elf32_Ehdr), 0) != sizeof(Elf32_Ehdr))
+				return false;
+			COPY_EHDR(&(layout->ehdr), &ehdr32);
+			shdr_size = sizeof(Elf32_Shdr);
+			break;
+		case ELFCLASS64:
+			if(pread(fd, &(layout->ehdr), sizeof(Elf64_Ehdr), 0) != sizeof(Elf64_Ehdr))
+				return false;
+			shdr_size = sizeof(Elf64_Shdr);
+			break;
+		default:
+			return false;
+	}
+	/* Extended section numbering is left to the full rebuild */
+	if(layout->ehdr.e_shentsize != shdr_size || layout->ehdr.e_shnum == 0
+		|| layout->ehdr.e_shstrndx == SHN_UNDEF || layout->ehdr.e_shstrndx >= layout->ehdr.e_shnum)
+		return false;
+	layout->shdrs = (Elf64_Shdr *) malloc(sizeof(Elf64_Shdr)*layout->ehdr.e_shnum);
+	if(layout->shdrs == NULL)
+		return false;
+	for(i=0;i<layout->ehdr.e_shnum;i++)
+	{
+		off_t offset = layout->ehdr.e_shoff+i*shdr_size;
+		
+		if(layout->elfclass == ELFCLASS32)
+		{
+			if(pread(fd, &shdr32, shdr_size, offset) != shdr_size)
+				return false;
+			COPY_SHDR(&(layout->shdrs[i]), &shdr32);
+		}
+		else if(pread(fd, &(layout->shdrs[i]), shdr_size, offset) != shdr_size)
+			return false;
+	}
+	strshdr = &(layout->shdrs[layout->ehdr.e_shstrndx]);
+	layout->strtab_size = strshdr->sh_size;
+	layout->strtab = (char *) malloc(layout->strtab_size+1);
+	if(layout->strtab == NULL)
+		return false;
+	if(pread(fd, layout->strtab, layout->strtab_size, strshdr->sh_offset) != layout->strtab_size)
+		return false;
+	layout->strtab[layout->strtab_size] = '\0';
+	return true;
+}
+
+/*
+ * Release the memory used to describe the layout of the input file
+ */
+void free_layout(elf_layout *layout)
+{
+	free(layout->shdrs);
+	free(layout->strtab);
+}
+
+/*
+ * Write data to the end of the file (respecting the requested alignment)
+ */
+int append_data(int fd, off_t *end, size_t align, void *buffer, size_t size, Elf64_Off *offset)
+{
+	if(align > 1)
+		*end = (*end+align-1) & ~((off_t) align-1);
+	if(pwrite(fd, buffer, size, *end) != size)
+		return false;
+	*offset = *end;
+	*end += size;
+	return true;
+}
+
+/*
+ * Write the section header table to the end of the file and point the ELF header at it
+ */
+int write_layout(int fd, off_t *end, elf_layout *layout)
+{
+	size_t shdr_size = layout->ehdr.e_shentsize;
+	Elf32_Ehdr ehdr32;
+	Elf32_Shdr shdr32;
+	Elf64_Off shoff;
+	unsigned int i;
+	
+	*end = (*end+7) & ~((off_t) 7);
+	shoff = *end;
+	for(i=0;i<layout->ehdr.e_shnum;i++)
+	{
+		Elf64_Off offset;
+		
+		if(layout->elfclass == ELFCLASS32)
+		{
+			COPY_SHDR(&shdr32, &(layout->shdrs[i]));
+			if(!append_data(fd, end, 1, &shdr32, shdr_size, &offset))
+				return false;
+		}
+		else if(!append_data(fd, end, 1, &(layout->shdrs[i]), shdr_size, &offset))
+			return false;
+	}
+	/* Nothing refers to the new data until the ELF header is updated */
+	layout->ehdr.e_shoff = shoff;
+	if(layout->elfclass == ELFCLASS32)
+	{
+		COPY_EHDR(&ehdr32, &(layout->ehdr));
+		return (pwrite(fd, &ehdr32, sizeof(Elf32_Ehdr), 0) == sizeof(Elf32_Ehdr));
+	}
+	return (pwrite(fd, &(layout->ehdr), sizeof(Elf64_Ehdr), 0) == sizeof(Elf64_Ehdr));
+}
+
+/*
+ * Find the section header of an existing section (NULL if the name is missing or ambiguous)
+ */
+Elf64_Shdr *find_shdr(elf_layout *layout, const char *name)
+{
+	Elf64_Shdr *shdr = NULL;
+	unsigned int i;
+	
+	for(i=1;i<layout->ehdr.e_shnum;i++)
+	{
+		if(layout->shdrs[i].sh_type == SHT_NULL || layout->shdrs[i].sh_name >= layout->strtab_size)
+			continue;
+		if(strcmp(&(layout->strtab[layout->shdrs[i].sh_name]), name) != 0)
+			continue;
+		if(shdr != NULL)
+			return NULL;
+		shdr = &(layout->shdrs[i]);
+	}
+	return shdr;
+}
+
+/*
+ * Add a name to the section name table of the output
+ */
+int add_name(elf_layout *layout, const char *name, Elf64_Word *offset)
+{
+	size_t length = strlen(name)+1;
+	char *strtab;
+	
+	strtab = (char *) realloc(layout->strtab, layout->strtab_size+length);
+	if(strtab == NULL)
+		return false;
+	memcpy(&strtab[layout->strtab_size], name, length);
+	*offset = layout->strtab_size;
+	layout->strtab = strtab;
+	layout->strtab_size += length;
+	return true;
+}
+
+/*
+ * Write the changes to the end of the input file instead of rebuilding it
+ * (only possible when the changed sections are not loaded into memory)
+ */
+int append_sections(libr_file *file_handle, int fd, off_t *end, elf_layout *layout)
+{
+	size_t strtab_size = layout->strtab_size;
+	unsigned int changes = 0;
+	libr_section *scn;
+	Elf64_Shdr *shdr;
+	
+	for(scn = file_handle->bfd_read->sections; scn != NULL; scn = scn->next)
+	{
+		int new_section = (scn->index >= file_handle->section_count);
+		
+		shdr = (new_section ? NULL : find_shdr(layout, scn->name));
+		/* Skip sections that are unchanged (or that were added then removed again) */
+		if(scn->userdata == NULL && (new_section || (shdr != NULL && scn->size == shdr->sh_size)))
+			continue;
+		if(bfd_section_flags(scn) & SEC_ALLOC)
+			return false;
+		if(new_section)
+		{
+			Elf64_Shdr *shdrs;
+			
+			if(layout->ehdr.e_shnum+1 >= SHN_LORESERVE)
+				return false;
+			shdrs = (Elf64_Shdr *) realloc(layout->shdrs, sizeof(Elf64_Shdr)*(layout->ehdr.e_shnum+1));
+			if(shdrs == NULL)
+				return false;
+			layout->shdrs = shdrs;
+			shdr = &(layout->shdrs[layout->ehdr.e_shnum++]);
+			memset(shdr, 0, sizeof(Elf64_Shdr));
+			shdr->sh_type = SHT_PROGBITS;
+			shdr->sh_addralign = 1;
+			if(!add_name(layout, scn->name, &(shdr->sh_name)))
+				return false;
+		}
+		else if(shdr == NULL || (shdr->sh_flags & SHF_ALLOC) || shdr->sh_type == SHT_NOBITS)
+			return false;
+		if(((Elf64_Xword) 1 << bfd_section_alignment(scn)) > shdr->sh_addralign)
+			shdr->sh_addralign = (Elf64_Xword) 1 << bfd_section_alignment(scn);
+		changes++;
+		/* Removed sections keep their slot (section indexes elsewhere in the file stay valid) */
+		if(scn->size == 0)
+		{
+			memset(shdr, 0, sizeof(Elf64_Shdr));
+			continue;
+		}
+		if(!append_data(fd, end, shdr->sh_addralign, scn->userdata, scn->size, &(shdr->sh_offset)))
+			return false;
+		shdr->sh_size = scn->size;
+	}
+	if(changes == 0)
+		return true;
+	/* Store the names of new sections in a new copy of the section name table */
+	if(layout->strtab_size != strtab_size)
+	{
+		shdr = &(layout->shdrs[layout->ehdr.e_shstrndx]);
+		if(!append_data(fd, end, 1, layout->strtab, layout->strtab_size, &(shdr->sh_offset)))
+			return false;
+		shdr->sh_size = layout->strtab_size;
+	}
+	return write_layout(fd, end, layout);
+}
+
+/*
+ * Check whether the file holds too many bytes that no header or section refers to any more
+ */
+int too_much_dead(elf_layout *layout, off_t file_size)
+{
+	off_t live, dead;
+	unsigned int i;
+	
+	live = layout->ehdr.e_ehsize + (off_t) layout->ehdr.e_phnum*layout->ehdr.e_phentsize
+		+ (off_t) layout->ehdr.e_shnum*layout->ehdr.e_shentsize;
+	for(i=0;i<layout->ehdr.e_shnum;i++)
+	{
+		if(layout->shdrs[i].sh_type != SHT_NOBITS)
+			live += layout->shdrs[i].sh_size;
+	}
+	dead = file_size-live;
+	return (dead > APPEND_DEAD_MIN && dead > live/APPEND_DEAD_FRACTION);
+}
+
+/*
+ * Try to write the output file in place, rewriting only the section tables
+ */
+int append_output(libr_file *file_handle)
+{
+	elf_layout layout;
+	libr_section *scn;
+	int ret = false;
+	off_t end;
+	int fd;
+	
+	if((fd = open(file_handle->filename, O_RDWR)) == ERROR)
+		return false;
+	if((end = lseek(fd, 0, SEEK_END)) == ERROR)
+	{
+		close(fd);
+		return false;
+	}
+	/* A file that has grown too much through appending is rebuilt from scratch instead */
+	if(read_layout(fd, &layout) && !too_much_dead(&layout, end))
+	{
+		off_t file_size = end;
+		
+		ret = append_sections(file_handle, fd, &end, &layout);
+		/* Discard anything partially appended, the file is rebuilt from scratch instead */
+		if(!ret && end != file_size && ftruncate(fd, file_size) == ERROR)
+			printf("failed to restore output file size.\n");
+	}
+	free_layout(&layout);
+	if(close(fd) == ERROR)
+		ret = false;
+	if(ret)
+	{
+		for(scn = file_handle->bfd_read->sections; scn != NULL; scn = scn->next)
+		{
+			free(scn->userdata);
+			scn->userdata = NULL;
+		}
+	}
+	return ret;
+}
+
 /*
  * Write the output file using the libbfd method
  */ 
@@ -333,6 +699,16 @@ void write_output(libr_file *file_handle)
 {
 	int write_ok = false;
 	
+	/* Adding or replacing resources does not need the whole file to be rebuilt */
+	if(file_handle->bfd_write != NULL && append_output(file_handle))
+	{
+		if(!bfd_close_all_done(file_handle->bfd_write))
+			printf("failed to close write handle.\n");
+		if(file_handle->fd_handle != 0 && close(file_handle->fd_handle))
+			printf("failed to close write file descriptor.\n");
+		unlink(file_handle->tempfile);
+		file_handle->bfd_write = NULL;
+	}
 	if(file_handle->bfd_write != NULL)
 	{
 		write_ok = true;
@@ -355,6 +731,7 @@ void write_output(libr_file *file_handle)
 	/* The read handle must be closed last since it is used in the write process */ 
 	if(!bfd_close(file_handle->bfd_read))
 		printf("failed to close read handle.\n");
+	close(file_handle->fd_input);
 	/* Copy the temporary output over the input */
 	if(write_ok)
 	{
@@ -377,15 +754,12 @@ libr_intstatus find_section(libr_file *file_handle, char *section_name, libr_sec
 {
 	libr_section *scn;
 	
-	for(scn = file_handle->bfd_read->sections; scn != NULL; scn = scn->next)
-	{
-		if(strcmp(scn->name, section_name) == 0)
-		{
-			*retscn = scn;
-			RETURN_OK;
-		}
-	}
-	RETURN(LIBR_ERROR_NOSECTION, "ELF resource section not found");
+	/* libbfd keeps its own hash table of section names, so this is a constant-time lookup */
+	scn = bfd_get_section_by_name(file_handle->bfd_read, section_name);
+	if(scn == NULL)
+		RETURN(LIBR_ERROR_NOSECTION, "ELF resource section not found");
+	*retscn = scn;
+	RETURN_OK;
 }
 
 /*
@@ -393,17 +767,51 @@ libr_intstatus find_section(libr_file *file_handle, char *section_name, libr_sec
  */
 libr_data *get_data(libr_file *file_handle, libr_section *scn)
 {
-	libr_data *data = malloc(scn->size);
+	libr_data *data;
 	
+	/* Data that is waiting to be written is the current content of the section */
+	if(scn->userdata != NULL)
+		return scn->userdata;
+	data = malloc(scn->size);
 	if(!bfd_get_section_contents(file_handle->bfd_read, scn, data, 0, scn->size))
 	{
 		free(data);
 		data = NULL;
 	}
-	scn->userdata = data;
 	return data;
 }
 
+/*
+ * Release the section data obtained with get_data
+ * (data waiting to be written belongs to the section)
+ */
+void free_data(libr_file *file_handle, libr_section *scn, libr_data *data)
+{
+	if(data != scn->userdata)
+		free(data);
+}
+
+/*
+ * Read part of a section using libbfd (without loading the rest)
+ */
+size_t read_section(libr_file *file_handle, libr_section *scn, off_t offset, char *buffer, size_t size)
+{
+	if(offset >= scn->size)
+		return 0;
+	if(size > scn->size-offset)
+		size = scn->size-offset;
+	if(scn->userdata != NULL)
+	{
+		memcpy(buffer, &((char *) scn->userdata)[offset], size);
+		return size;
+	}
+	if(!(bfd_section_flags(scn) & SEC_HAS_CONTENTS))
+		return 0;
+	if(!bfd_get_section_contents(file_handle->bfd_read, scn, buffer, offset, size))
+		return 0;
+	return size;
+}
+
 /*
  * Create new data for a section using libbfd
  */
@@ -417,6 +825,21 @@ libr_data *new_data(libr_file *file_handle, libr_section *scn)
 	return scn->userdata;
 }
 
+/*
+ * Start the data of a section on a multiple of alignment bytes using libbfd
+ */
+libr_intstatus set_alignment(libr_file *file_handle, libr_section *scn, size_t alignment)
+{
+	unsigned int power = 0;
+	
+	/* libbfd stores the alignment as a power of two */
+	while(((size_t) 1 << power) < alignment)
+		power++;
+	if(power > bfd_section_alignment(scn) && !bfd_set_section_alignment(scn, power))
+		RETURN(LIBR_ERROR_SETALIGN, "Failed to set alignment for section: %s", bfd_errmsg(bfd_get_error()));
+	RETURN_OK;
+}
+
 /*
  * Create new data for a section using libbfd (at least, do so memory-wise)
  */
@@ -424,12 +847,13 @@ libr_intstatus set_data(libr_file *file_handle, libr_section *scn, libr_data *da
 {
 	char *intbuffer = NULL;
 	
-	/* special case: clear buffer */
+	/* special case: clear buffer (the data itself is released with free_data) */
 	if(buffer == NULL)
 	{
 		scn->size = 0;
-		if(scn->userdata != NULL)
+		if(scn->userdata != data)
 			free(scn->userdata);
+		scn->userdata = NULL;
 		RETURN_OK;
 	}
 	/* normal case: add new data to the buffer */
@@ -458,6 +882,22 @@ libr_intstatus add_section(libr_file *file_handle, char *resource_name, libr_sec
 	RETURN_OK;
 }
 
+/*
+ * Start a batch of changes (libbfd already holds every change until the handle is closed)
+ */
+libr_intstatus begin_update(libr_file *file_handle)
+{
+	RETURN_OK;
+}
+
+/*
+ * Finish a batch of changes (the output is built once, when the handle is closed)
+ */
+libr_intstatus commit_update(libr_file *file_handle)
+{
+	RETURN_OK;
+}
+
 /*
  * Remove a section and eliminate it from the ELF string table using libbfd
  */
@@ -498,6 +938,24 @@ libr_section *next_section(libr_file *file_handle, libr_section *scn)
 	return scn->next;
 }
 
+/*
+ * Return the file offset of the data in the section
+ */
+off_t section_offset(libr_file *file_handle, libr_section *scn)
+{
+	if(!(bfd_section_flags(scn) & SEC_HAS_CONTENTS))
+		return ERROR;
+	return scn->filepos;
+}
+
+/*
+ * Return the size of the section as stored in the file
+ */
+size_t section_size(libr_file *file_handle, libr_section *scn)
+{
+	return bfd_section_size(scn);
+}
+
 /*
  * Return the name of a section
  */
@@ -10,8 +10,9 @@
 /* Define the types we need if not already included */
 #define LIBR_TEMPFILE_LEN          22
 typedef enum {
-	LIBR_READ       = 0,
-	LIBR_READ_WRITE = 1,
+	LIBR_READ        = 0,
+	LIBR_READ_WRITE  = 1,
+	LIBR_READ_SHARED = 2,
 } libr_access_t;
 #endif
 
@@ -32,6 +33,7 @@ typedef enum {
 
 typedef struct _libr_file {
 	int fd_handle;
+	int fd_input;
 	bfd *bfd_read;
 	bfd *bfd_write;
 	char *filename;
@@ -40,6 +42,8 @@ typedef struct _libr_file {
 	gid_t filegroup;
 	char tempfile[LIBR_TEMPFILE_LEN];
 	libr_access_t access;
+	libr_frontend front;
+	unsigned int section_count;
 } libr_file;
 
 #endif /* DOXYGEN_SHOULD_SKIP_THIS */
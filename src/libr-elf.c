@@ -40,24 +40,64 @@
 extern void libr_set_error(libr_intstatus error);
 
 /*
- * Write the output file using libelf
+ * Lay out the ELF file and write it to the disk using libelf
  */
-void write_output(libr_file *file_handle)
+libr_intstatus update_file(libr_file *file_handle)
 {
-	/* Update the ELF file on the disk */
 	if(elf_update(file_handle->elf_handle, ELF_C_NULL) < 0)
-	{
-		printf("elf_update() failed: %s.", elf_errmsg(-1));
-		return;
-	}
+		RETURN(LIBR_ERROR_UPDATE, "Failed to perform dynamic update: %s.", elf_errmsg(-1));
 	if(elf_update(file_handle->elf_handle, ELF_C_WRITE) < 0)
+		RETURN(LIBR_ERROR_UPDATE, "Failed to perform dynamic update: %s.", elf_errmsg(-1));
+	file_handle->pending = false;
+	RETURN_OK;
+}
+
+/*
+ * Keep a private copy of a buffer until the batched changes have been written
+ */
+char *stage_buffer(libr_file *file_handle, char *buffer, size_t size)
+{
+	libr_staged *staged;
+	
+	if((staged = (libr_staged *) malloc(sizeof(libr_staged)+size)) == NULL)
+		return NULL;
+	memcpy(&staged[1], buffer, size);
+	staged->next = file_handle->staged;
+	file_handle->staged = staged;
+	return (char *) &staged[1];
+}
+
+/*
+ * Write the output file using libelf
+ */
+void write_output(libr_file *file_handle)
+{
+	libr_staged *staged, *next;
+	
+	/* Update the ELF file on the disk (if anything has changed since the last update) */
+	if(file_handle->pending && update_file(file_handle).status != LIBR_OK)
 	{
 		printf("elf_update() failed: %s.", elf_errmsg(-1));
 		return;
 	}
 	/* Close the handles */
+	nameindex_free(&(file_handle->index));
 	elf_end(file_handle->elf_handle);
 	close(file_handle->fd_handle);
+	/* Release the buffers that were staged for libelf */
+	for(staged = file_handle->staged; staged != NULL; staged = next)
+	{
+		next = staged->next;
+		free(staged);
+	}
+}
+
+/*
+ * Return the descriptor of the file that was parsed
+ */
+int input_descriptor(libr_file *file_handle)
+{
+	return file_handle->fd_handle;
 }
 
 /*
@@ -79,6 +119,10 @@ libr_intstatus open_handles(libr_file *file_handle, char *filename, libr_access_
 {
 	const int elf_access[2] = {ELF_C_READ, ELF_C_RDWR};
 	const int fd_access[2] = {O_RDONLY, O_RDWR};
+	Elf_Scn *scn = NULL;
+	char *name = NULL;
+	GElf_Ehdr ehdr;
+	GElf_Shdr shdr;
 	Elf *e = NULL;
 	int fd = 0;
 	
@@ -88,8 +132,24 @@ libr_intstatus open_handles(libr_file *file_handle, char *filename, libr_access_
 		RETURN(LIBR_ERROR_BEGINFAILED, "Failed to open ELF file: %s.", elf_errmsg(-1));
 	if(elf_kind(e) != ELF_K_ELF)
 		RETURN(LIBR_ERROR_WRONGFORMAT, "Invalid input file format");
+	if(gelf_getehdr(e, &ehdr) == NULL)
+		RETURN(LIBR_ERROR_GETEHDR, "Failed to obtain ELF header: %s", elf_errmsg(-1));
+	/* Index the section names for constant-time lookups */
+	if(!nameindex_init(&(file_handle->index), ehdr.e_shnum, true))
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	while((scn = elf_nextscn(e, scn)) != NULL)
+	{
+		if(gelf_getshdr(scn, &shdr) != &shdr)
+			RETURN(LIBR_ERROR_GETSHDR, "Failed to obtain ELF section header: %s", elf_errmsg(-1));
+		if((name = elf_strptr(e, ehdr.e_shstrndx, shdr.sh_name)) == NULL)
+			RETURN(LIBR_ERROR_STRPTR, "Failed to obtain section string pointer: %s.", elf_errmsg(-1));
+		if(!nameindex_add(&(file_handle->index), name, scn))
+			RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	}
 	
+	file_handle->shstrndx = ehdr.e_shstrndx;
 	file_handle->access = access;
+	file_handle->filename = filename;
 	file_handle->fd_handle = fd;
 	file_handle->elf_handle = e;
 	file_handle->file_size = file_size(fd);
@@ -158,6 +218,52 @@ libr_data *get_data(libr_file *file_handle, libr_section *scn)
 	return elf_getdata(scn, NULL);
 }
 
+/*
+ * Section data obtained with get_data belongs to libelf
+ */
+void free_data(libr_file *file_handle, libr_section *scn, libr_data *data) {}
+
+/*
+ * Read part of a section using libelf (without loading the rest)
+ */
+size_t read_section(libr_file *file_handle, libr_section *scn, off_t offset, char *buffer, size_t size)
+{
+	Elf_Data *data = NULL;
+	size_t total = 0;
+	GElf_Shdr shdr;
+	ssize_t n;
+	
+	if(gelf_getshdr(scn, &shdr) != &shdr || shdr.sh_type == SHT_NOBITS)
+		return 0;
+	/* The file on the disk is up-to-date for read-only handles */
+	if(file_handle->access == LIBR_READ)
+	{
+		if(offset >= shdr.sh_size)
+			return 0;
+		if(size > shdr.sh_size-offset)
+			size = shdr.sh_size-offset;
+		n = pread(file_handle->fd_handle, buffer, size, shdr.sh_offset+offset);
+		return (n < 0 ? 0 : n);
+	}
+	/* Otherwise gather the requested range from the data blocks of the section */
+	while((data = elf_getdata(scn, data)) != NULL)
+	{
+		off_t start = offset+total, end = offset+size;
+		size_t count;
+		
+		if(data->d_buf == NULL || start < data->d_off || start >= data->d_off+(off_t)data->d_size)
+			continue;
+		count = data->d_off+data->d_size-start;
+		if(count > end-start)
+			count = end-start;
+		memcpy(&buffer[total], &((char *) data->d_buf)[start-data->d_off], count);
+		total += count;
+		if(total == size)
+			break;
+	}
+	return total;
+}
+
 /*
  * Create new data for a section using libelf
  */
@@ -166,27 +272,56 @@ libr_data *new_data(libr_file *file_handle, libr_section *scn)
 	return elf_newdata(scn);
 }
 
+/*
+ * Start the data of a section on a multiple of alignment bytes using libelf
+ */
+libr_intstatus set_alignment(libr_file *file_handle, libr_section *scn, size_t alignment)
+{
+	GElf_Shdr shdr;
+	
+	if(gelf_getshdr(scn, &shdr) != &shdr)
+		RETURN(LIBR_ERROR_GETSHDR, "Failed to obtain ELF section header: %s", elf_errmsg(-1));
+	if(alignment <= shdr.sh_addralign)
+		RETURN_OK;
+	shdr.sh_addralign = alignment;
+	if(!gelf_update_shdr(scn, &shdr))
+		RETURN(LIBR_ERROR_SETALIGN, "Failed to set alignment for section: %s", elf_errmsg(-1));
+	RETURN_OK;
+}
+
 /*
  * Set data for a section using libelf (not written yet)
  */
 libr_intstatus set_data(libr_file *file_handle, libr_section *scn, libr_data *data, off_t offset, char *buffer, size_t size)
 {
+	GElf_Shdr shdr;
+	
+	/* Batched changes are written after the caller's buffer is gone */
+	if(file_handle->batch && buffer != NULL)
+	{
+		if((buffer = stage_buffer(file_handle, buffer, size)) == NULL)
+			RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	}
+	/* The start of the data carries the alignment of the section (libelf lays out by data alignment) */
 	data->d_align = 1;
+	if(offset == 0 && gelf_getshdr(scn, &shdr) == &shdr && shdr.sh_addralign > 1)
+		data->d_align = shdr.sh_addralign;
 	data->d_off = offset;
 	data->d_buf = buffer;
 	data->d_type = ELF_T_BYTE;
 	data->d_size = size;
 	data->d_version = file_handle->version;
+	file_handle->pending = true;
+	/* Batched changes are laid out and written once, by commit_update */
+	if(file_handle->batch)
+		RETURN_OK;
 #ifdef MANUAL_LAYOUT
 	if(expand_section(file_handle->elf_handle, scn, data->d_size, true) != LIBR_OK)
 		RETURN(LIBR_ERROR_EXPANDSECTION, "Failed to expand section");
+	RETURN_OK;
 #else
-	if(elf_update(file_handle->elf_handle, ELF_C_NULL) < 0)
-		RETURN(LIBR_ERROR_UPDATE, "Failed to perform dynamic update: %s.", elf_errmsg(-1));
-	if(elf_update(file_handle->elf_handle, ELF_C_WRITE) < 0)
-		RETURN(LIBR_ERROR_UPDATE, "Failed to perform dynamic update: %s.", elf_errmsg(-1));
+	return update_file(file_handle);
 #endif /* MANUAL_LAYOUT */
-	RETURN_OK;
 }
 
 /*
@@ -194,33 +329,13 @@ libr_intstatus set_data(libr_file *file_handle, libr_section *scn, libr_data *da
  */
 libr_intstatus find_section(libr_file *file_handle, char *section, libr_section **retscn)
 {
-	Elf *e = file_handle->elf_handle;
-	Elf_Scn *scn = NULL;
-	char *name = NULL;
-	GElf_Ehdr ehdr;
-	GElf_Shdr shdr;
-	uintmax_t si;
+	Elf_Scn *scn;
 	
-	if(gelf_getehdr(e, &ehdr) == NULL)
-		RETURN(LIBR_ERROR_GETEHDR, "Failed to obtain ELF header: %s", elf_errmsg(-1));
-	while((scn = elf_nextscn(e, scn)) != NULL)
-	{
-		if(gelf_getshdr(scn, &shdr) != &shdr)
-			RETURN(LIBR_ERROR_GETSHDR, "Failed to obtain ELF section header: %s", elf_errmsg(-1));
-		if((name = elf_strptr(e, ehdr.e_shstrndx, shdr.sh_name)) == NULL)
-			RETURN(LIBR_ERROR_STRPTR, "Failed to obtain section string pointer: %s.", elf_errmsg(-1));
-		
-		si = (uintmax_t) elf_ndxscn(scn);
-/*
-printf("%d: %s (%d %d)\n", (long) si, name, (long) shdr.sh_offset, (long) shdr.sh_size);
-*/
-		if(strcmp(name, section) == 0)
-		{
-			*retscn = scn;
-			RETURN_OK;
-		}
-	}
-	RETURN(LIBR_ERROR_NOSECTION, "ELF resource section not found");
+	scn = (Elf_Scn *) nameindex_find(&(file_handle->index), section);
+	if(scn == NULL)
+		RETURN(LIBR_ERROR_NOSECTION, "ELF resource section not found");
+	*retscn = scn;
+	RETURN_OK;
 }
 
 /*
@@ -249,31 +364,44 @@ libr_intstatus add_section(libr_file *file_handle, char *section, Elf_Scn **rets
 	if(data == NULL)
 		RETURN(LIBR_ERROR_NEWDATA, "Failed to create data for section");
 	data->d_align = 1;
-
+	
 #ifdef MANUAL_LAYOUT
 {
 	GElf_Shdr strshdr;
-	
+		
 	if(gelf_getshdr(strscn, &strshdr) != &strshdr)
 		RETURN(LIBR_ERROR_GETSHDR, "Failed to obtain ELF section header: %s", elf_errmsg(-1));
 	data->d_off = strshdr.sh_size;
 #endif /* MANUAL_LAYOUT */
-
+		
+	/* The name is read when the table is written, keep a copy that lives as long as the handle */
 	data->d_size = (size_t) strlen(section)+1;
 	data->d_type = ELF_T_BYTE;
-	data->d_buf = section;
+	data->d_buf = stage_buffer(file_handle, section, data->d_size);
+	if(data->d_buf == NULL)
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
 	data->d_version = file_handle->version;
-
+		
 #ifdef MANUAL_LAYOUT
 	if(expand_section(e, strscn, data->d_size, false) != LIBR_OK)
 		return false;
 }
 #else
+	if(file_handle->batch)
+	{
+		Elf_Data *strdata = NULL;
+		
+		/* The layout pass is deferred, place the name after the rest of the table by hand */
+		data->d_off = 0;
+		while((strdata = elf_getdata(strscn, strdata)) != NULL && strdata != data)
+			data->d_off += strdata->d_size;
+	}
 	/* Update the internal offset information */
-	if(elf_update(e, ELF_C_NULL) < 0)
+	else if(elf_update(e, ELF_C_NULL) < 0)
 		RETURN(LIBR_ERROR_UPDATE, "Failed to perform dynamic update: %s.", elf_errmsg(-1));
 #endif /* MANUAL_LAYOUT */
-
+	file_handle->pending = true;
+	
 	/* seek to the end of the section data */
 	if((scn = elf_newscn(e)) == NULL)
 		RETURN(LIBR_ERROR_NEWSECTION, "Failed to create new section");
@@ -290,21 +418,43 @@ libr_intstatus add_section(libr_file *file_handle, char *section, Elf_Scn **rets
 	shdr.sh_entsize = 0;
 	if(gelf_update_shdr(scn, &shdr) < 0)
 		RETURN(LIBR_ERROR_UPDATE, "Failed to perform dynamic update: %s.", elf_errmsg(-1));
+	if(!nameindex_add(&(file_handle->index), section, scn))
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
 	*retscn = scn;
 	RETURN_OK;
 }
 
+/*
+ * Start staging changes in memory instead of writing them as they are made
+ */
+libr_intstatus begin_update(libr_file *file_handle)
+{
+	file_handle->batch = true;
+	RETURN_OK;
+}
+
+/*
+ * Lay out and write all of the staged changes at once
+ */
+libr_intstatus commit_update(libr_file *file_handle)
+{
+	file_handle->batch = false;
+	if(!file_handle->pending)
+		RETURN_OK;
+	return update_file(file_handle);
+}
+
 /*
  * Remove a section and eliminate it from the ELF string table using libelf
  */
 libr_intstatus remove_section(libr_file *file_handle, libr_section *scn)
 {
-	unsigned int table_size, str_size;
+	unsigned int str_size, name_offset;
 	char *buffer = NULL, *tmp = NULL;
 	Elf *e = file_handle->elf_handle;
+	Elf_Scn *strscn, *tmpscn = NULL;
 	int remaining_size;
-	Elf_Scn *strscn;
-	Elf_Data *data;
+	Elf_Data *data = NULL;
 	GElf_Ehdr ehdr;
 	GElf_Shdr shdr;
 	
@@ -316,16 +466,26 @@ libr_intstatus remove_section(libr_file *file_handle, libr_section *scn)
 	strscn = elf_getscn(e, ehdr.e_shstrndx);
 	if(strscn == NULL)
 		RETURN(LIBR_ERROR_TABLE, "Failed to open string table: %s.", elf_errmsg(-1));
-	if((data = elf_getdata(strscn, NULL)) == NULL)
-		RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+	/* Names added earlier in a batch sit in their own data blocks, lay those out first */
+	if(file_handle->batch && file_handle->pending && elf_update(e, ELF_C_NULL) < 0)
+		RETURN(LIBR_ERROR_UPDATE, "Failed to perform dynamic update: %s.", elf_errmsg(-1));
 	/* Find where the section name is in the string table */
 	if(gelf_getshdr(scn, &shdr) != &shdr)
 		RETURN(LIBR_ERROR_GETSHDR, "Failed to obtain ELF section header: %s", elf_errmsg(-1));
-	table_size = data->d_size;
-	buffer = (char *) data->d_buf;
-	/* Excise the string from the table */
-	str_size = strlen(&buffer[shdr.sh_name])+1;
-	remaining_size = table_size-(shdr.sh_name+str_size);
+	name_offset = shdr.sh_name;
+	while((data = elf_getdata(strscn, data)) != NULL)
+	{
+		if(name_offset >= data->d_off && name_offset < data->d_off+data->d_size)
+			break;
+	}
+	if(data == NULL || data->d_buf == NULL)
+		RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+	buffer = &((char *) data->d_buf)[name_offset-data->d_off];
+	/* Drop the section from the name index before its name goes away */
+	nameindex_remove(&(file_handle->index), buffer, scn);
+	/* Excise the string from the block holding it */
+	str_size = strnlen(buffer, data->d_off+data->d_size-name_offset)+1;
+	remaining_size = (data->d_off+data->d_size)-(name_offset+str_size);
 	if(remaining_size < 0)
 		RETURN(LIBR_ERROR_SIZEMISMATCH, "Section's data size does not make sense");
 	if(remaining_size > 0)
@@ -334,18 +494,30 @@ libr_intstatus remove_section(libr_file *file_handle, libr_section *scn)
 		 * NOTE: Using memcpy with overlapping addresses is not allowed, use temporary buffer. 
 		 */
 		tmp = (char *) malloc(remaining_size);
-		memcpy(tmp, &buffer[shdr.sh_name+str_size], remaining_size);
-		memcpy(&buffer[shdr.sh_name], tmp, remaining_size);
+		if(tmp == NULL)
+			RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+		memcpy(tmp, &buffer[str_size], remaining_size);
+		memcpy(buffer, tmp, remaining_size);
 		free(tmp);
 	}
 	data->d_size -= str_size;
-	/* Update the internal offset information */
+	/* The names that followed the excised one have moved */
+	while((tmpscn = elf_nextscn(e, tmpscn)) != NULL)
+	{
+		if(tmpscn == scn || gelf_getshdr(tmpscn, &shdr) != &shdr || shdr.sh_name <= name_offset)
+			continue;
+		shdr.sh_name -= str_size;
+		if(gelf_update_shdr(tmpscn, &shdr) < 0)
+			RETURN(LIBR_ERROR_UPDATE, "Failed to perform dynamic update: %s.", elf_errmsg(-1));
+	}
+	file_handle->pending = true;
+	/* Update the internal offset information (the following data blocks have moved as well) */
 	if(elf_update(e, ELF_C_NULL) < 0)
 		RETURN(LIBR_ERROR_UPDATE, "Failed to perform dynamic update: %s.", elf_errmsg(-1));
 #ifdef MANUAL_LAYOUT
 {
 	GElf_Shdr strshdr;
-	
+		
 	if(gelf_getshdr(strscn, &strshdr) != &strshdr)
 		RETURN(LIBR_ERROR_GETSHDR, "Failed to obtain ELF section header: %s", elf_errmsg(-1));
 	strshdr.sh_size -= str_size;
@@ -353,7 +525,7 @@ libr_intstatus remove_section(libr_file *file_handle, libr_section *scn)
 		RETURN(LIBR_ERROR_UPDATE, "Failed to perform dynamic update: %s.", elf_errmsg(-1));
 }
 #endif /* MANUAL_LAYOUT */
-
+	
 	/* Clear the section itself and update the offsets */
 	if(elfx_remscn(e, scn) == 0)
 		RETURN(LIBR_ERROR_REMOVESECTION, "Failed to remove section: %s.", elf_errmsg(-1));
@@ -384,22 +556,52 @@ libr_section *next_section(libr_file *file_handle, libr_section *scn)
 	return elf_nextscn(file_handle->elf_handle, scn);
 }
 
+/*
+ * Return the file offset of the data in the section
+ */
+off_t section_offset(libr_file *file_handle, libr_section *scn)
+{
+	GElf_Shdr shdr;
+	
+	if(gelf_getshdr(scn, &shdr) != &shdr)
+		return ERROR;
+	if(shdr.sh_type == SHT_NOBITS)
+		return ERROR;
+	return shdr.sh_offset;
+}
+
+/*
+ * Return the size of the section as stored in the file
+ */
+size_t section_size(libr_file *file_handle, libr_section *scn)
+{
+	Elf_Data *data = NULL;
+	size_t size = 0;
+	GElf_Shdr shdr;
+	
+	if(gelf_getshdr(scn, &shdr) != &shdr)
+		return 0;
+	if(!file_handle->pending)
+		return shdr.sh_size;
+	/* The section header does not reflect staged data until the next update */
+	while((data = elf_getdata(scn, data)) != NULL)
+	{
+		if(data->d_off+data->d_size > size)
+			size = data->d_off+data->d_size;
+	}
+	return size;
+}
+
 /*
  * Retrieve the name of a section
  */
 char *section_name(libr_file *file_handle, libr_section *scn)
 {
-	char *name = NULL;
 	GElf_Shdr shdr;
-	GElf_Ehdr ehdr;
 	
-	if(gelf_getehdr(file_handle->elf_handle, &ehdr) == NULL)
-		return NULL;
 	if(gelf_getshdr(scn, &shdr) != &shdr)
 		return NULL;
-	if((name = elf_strptr(file_handle->elf_handle, ehdr.e_shstrndx, shdr.sh_name)) == NULL)
-		return NULL;
-	return strdup(name);
+	return elf_strptr(file_handle->elf_handle, file_handle->shstrndx, shdr.sh_name);
 }
 
 /*
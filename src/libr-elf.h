@@ -5,14 +5,29 @@
 #include <libelf.h>
 #include <gelf.h>
 
+/* For constant-time section lookups */
+#include "nameindex.h"
+
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 
+/* Copy of a buffer handed to libelf while a batch of changes is pending */
+typedef struct _libr_staged {
+	struct _libr_staged *next;
+} libr_staged;
+
 typedef struct _libr_file {
 	int fd_handle;
+	char *filename;
 	Elf *elf_handle;
 	size_t file_size;
 	libr_access_t access;
 	unsigned int version;
+	size_t shstrndx;
+	nameindex index;
+	libr_frontend front;
+	int batch;
+	int pending;
+	libr_staged *staged;
 } libr_file;
 
 #endif /* DOXYGEN_SHOULD_SKIP_THIS */
@@ -0,0 +1,389 @@
+/*
+ *
+ *  libr-embed - Generate linkable resource objects at build time
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+/*
+ * Usage: libr-embed [-a alignment] [-c codec] [-l level] [-s saving] [-p prefix] [-t type] -o output [manifest | directory]...
+ *
+ * Every file below a directory becomes a resource named by its path within the directory (after
+ * the prefix), a manifest lists one "name path" pair per line (paths are relative to the manifest,
+ * blank lines and lines starting with '#' are skipped).  The resources are compressed while the
+ * source is generated (on every processor) and read back with libr_open_self_mapped or
+ * libr_open_loaded once the output is linked in.  An output ending in ".o" is assembled with
+ * $CC (cc by default) and $CFLAGS, anything else is left as assembler source.  Resources stored
+ * as "auto" are compressed with zlib unless another codec is chosen with -c.
+ */
+
+#include "config.h"
+
+#include "libr.h"
+
+/* For malloc/free and getenv */
+#include <stdlib.h>
+
+/* For file reading */
+#include <stdio.h>
+
+/* For string handling */
+#include <string.h>
+
+/* For walking directories */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+/* For getopt and running the assembler */
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define MANIFEST_LINE            4096
+#define DEFAULT_SAVING           10
+#define ASSEMBLE_COMMAND         "exec ${CC:-cc} $CFLAGS -c -o \"$1\" \"$2\""
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+/* Storage types by the names accepted on the command line */
+static const struct {
+	const char *name;
+	libr_type_t type;
+} types[] = {
+	{"auto", LIBR_AUTO},
+	{"none", LIBR_UNCOMPRESSED},
+	{"zlib", LIBR_COMPRESSED},
+	{"seekable", LIBR_SEEKABLE},
+	{"zstd", LIBR_ZSTD},
+	{"lz4", LIBR_LZ4},
+};
+
+static libr_type_t type = LIBR_AUTO;
+
+/*
+ * Report how to call the program
+ */
+static void usage(const char *program)
+{
+	fprintf(stderr, "Usage: %s [-a alignment] [-c codec] [-l level] [-s saving] [-p prefix] [-t type] -o output [manifest | directory]...\n", program);
+	fprintf(stderr, "  types: auto (default), none, zlib, seekable, zstd, lz4\n");
+	fprintf(stderr, "  codecs used by auto: zlib (default), zstd, lz4\n");
+	fprintf(stderr, "  an output ending in \".o\" is assembled with $CC, anything else is written as assembler source\n");
+}
+
+/*
+ * Look up a storage type by its name on the command line (FALSE for an unknown name)
+ */
+static int parse_type(const char *program, const char *name, libr_type_t *parsed)
+{
+	size_t i;
+	
+	for(i = 0; i < sizeof(types)/sizeof(types[0]); i++)
+	{
+		if(strcmp(name, types[i].name) == 0)
+		{
+			*parsed = types[i].type;
+			return TRUE;
+		}
+	}
+	fprintf(stderr, "%s: unknown storage type \"%s\"\n", program, name);
+	return FALSE;
+}
+
+/*
+ * Add a file to the resources collected by the handle
+ */
+static int add_file(libr_file *handle, const char *name, const char *path)
+{
+	size_t size = 0, length;
+	char *buffer = NULL, *grown;
+	FILE *file;
+	int ok;
+	
+	if((file = fopen(path, "rb")) == NULL)
+	{
+		perror(path);
+		return FALSE;
+	}
+	/* Read in chunks so that pipes and special files work too */
+	do {
+		if((grown = (char *) realloc(buffer, size+BUFSIZ)) == NULL)
+		{
+			fprintf(stderr, "%s: out of memory\n", path);
+			free(buffer);
+			fclose(file);
+			return FALSE;
+		}
+		buffer = grown;
+		length = fread(&buffer[size], 1, BUFSIZ, file);
+		size += length;
+	} while(length == BUFSIZ);
+	ok = !ferror(file);
+	fclose(file);
+	if(!ok)
+		perror(path);
+	else if(!(ok = libr_write(handle, (char *) name, buffer, size, type, LIBR_NOOVERWRITE)))
+		fprintf(stderr, "%s: %s\n", name, libr_errmsg());
+	free(buffer);
+	return ok;
+}
+
+/*
+ * Join a directory and an entry within it
+ */
+static char *join_path(const char *directory, const char *entry)
+{
+	size_t length = strlen(directory);
+	char *path;
+	
+	if((path = (char *) malloc(length+strlen(entry)+2)) == NULL)
+		return NULL;
+	strcpy(path, directory);
+	if(length != 0 && directory[length-1] != '/')
+		strcat(path, "/");
+	strcat(path, entry);
+	return path;
+}
+
+/*
+ * Add every file below a directory, named by its path below the top directory
+ */
+static int add_directory(libr_file *handle, const char *name, const char *path)
+{
+	struct dirent *entry;
+	struct stat info;
+	int ok = TRUE;
+	DIR *directory;
+	
+	if((directory = opendir(path)) == NULL)
+	{
+		perror(path);
+		return FALSE;
+	}
+	while(ok && (entry = readdir(directory)) != NULL)
+	{
+		char *entry_path, *entry_name;
+		
+		if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+			continue;
+		entry_path = join_path(path, entry->d_name);
+		entry_name = (*name == '\0' ? strdup(entry->d_name) : join_path(name, entry->d_name));
+		if(entry_path == NULL || entry_name == NULL)
+		{
+			fprintf(stderr, "%s: out of memory\n", path);
+			ok = FALSE;
+		}
+		else if(stat(entry_path, &info) != 0)
+		{
+			perror(entry_path);
+			ok = FALSE;
+		}
+		else if(S_ISDIR(info.st_mode))
+			ok = add_directory(handle, entry_name, entry_path);
+		else
+			ok = add_file(handle, entry_name, entry_path);
+		free(entry_path);
+		free(entry_name);
+	}
+	closedir(directory);
+	return ok;
+}
+
+/*
+ * Add the files listed by a manifest
+ */
+static int add_manifest(libr_file *handle, const char *path)
+{
+	const char *slash = strrchr(path, '/');
+	char line[MANIFEST_LINE], *base;
+	unsigned long number = 0;
+	int ok = TRUE;
+	FILE *file;
+	
+	if((file = fopen(path, "r")) == NULL)
+	{
+		perror(path);
+		return FALSE;
+	}
+	/* Paths in the manifest are relative to the directory holding it */
+	if((base = strdup(path)) == NULL)
+	{
+		fclose(file);
+		return FALSE;
+	}
+	base[(slash == NULL ? 0 : slash-path+1)] = '\0';
+	while(ok && fgets(line, sizeof(line), file) != NULL)
+	{
+		char *name, *file_path, *full_path;
+		
+		number++;
+		line[strcspn(line, "\r\n")] = '\0';
+		name = line+strspn(line, " \t");
+		if(*name == '\0' || *name == '#')
+			continue;
+		file_path = name+strcspn(name, " \t");
+		if(*file_path != '\0')
+			*file_path++ = '\0';
+		file_path += strspn(file_path, " \t");
+		if(*file_path == '\0')
+		{
+			fprintf(stderr, "%s:%lu: expected a resource name and a path\n", path, number);
+			ok = FALSE;
+			continue;
+		}
+		if(*file_path == '/')
+			full_path = strdup(file_path);
+		else
+			full_path = join_path(base, file_path);
+		if(full_path == NULL)
+		{
+			fprintf(stderr, "%s: out of memory\n", path);
+			ok = FALSE;
+			continue;
+		}
+		ok = add_file(handle, name, full_path);
+		free(full_path);
+	}
+	free(base);
+	fclose(file);
+	return ok;
+}
+
+/*
+ * Assemble the generated source into an object
+ */
+static int assemble(const char *object, const char *source)
+{
+	int status;
+	pid_t pid;
+	
+	if((pid = fork()) < 0)
+	{
+		perror("fork");
+		return FALSE;
+	}
+	if(pid == 0)
+	{
+		/* The shell expands $CC and $CFLAGS so that they may carry options */
+		execl("/bin/sh", "sh", "-c", ASSEMBLE_COMMAND, "sh", object, source, (char *) NULL);
+		_exit(127);
+	}
+	if(waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	{
+		fprintf(stderr, "%s: failed to assemble %s\n", object, source);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+int main(int argc, char **argv)
+{
+	char *output = NULL, *source, *prefix = "";
+	unsigned long alignment = 1, saving = DEFAULT_SAVING;
+	libr_type_t codec = LIBR_COMPRESSED;
+	int level = 0, ok = TRUE;
+	size_t length;
+	libr_file *handle;
+	struct stat info;
+	int option;
+	
+	while((option = getopt(argc, argv, "a:c:l:o:p:s:t:h")) != -1)
+	{
+		switch(option)
+		{
+			case 'a':
+				alignment = strtoul(optarg, NULL, 0);
+				break;
+			case 'c':
+				if(!parse_type(argv[0], optarg, &codec))
+					return 1;
+				break;
+			case 'l':
+				level = atoi(optarg);
+				break;
+			case 'o':
+				output = optarg;
+				break;
+			case 'p':
+				prefix = optarg;
+				break;
+			case 's':
+				saving = strtoul(optarg, NULL, 0);
+				break;
+			case 't':
+				if(!parse_type(argv[0], optarg, &type))
+					return 1;
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if(output == NULL)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	/* Objects are assembled from a source of the same name */
+	length = strlen(output);
+	if((source = (char *) malloc(length+3)) == NULL)
+		return 1;
+	strcpy(source, output);
+	if(length > 2 && strcmp(&output[length-2], ".o") == 0)
+		strcpy(&source[length-2], ".S");
+	else
+		output = NULL;
+	if((handle = libr_open_embed(source)) == NULL)
+	{
+		fprintf(stderr, "%s: %s\n", source, libr_errmsg());
+		return 1;
+	}
+	if(!libr_set_alignment(handle, alignment) || !libr_set_policy(handle, saving, level) || !libr_set_codec(handle, codec))
+	{
+		fprintf(stderr, "%s: %s\n", argv[0], libr_errmsg());
+		ok = FALSE;
+	}
+	for(; ok && optind < argc; optind++)
+	{
+		if(stat(argv[optind], &info) != 0)
+		{
+			perror(argv[optind]);
+			ok = FALSE;
+		}
+		else if(S_ISDIR(info.st_mode))
+			ok = add_directory(handle, prefix, argv[optind]);
+		else
+			ok = add_manifest(handle, argv[optind]);
+	}
+	/* Compress the resources and write the source (nothing is written after a failure) */
+	if(ok && !libr_commit(handle))
+	{
+		fprintf(stderr, "%s: %s\n", source, libr_errmsg());
+		ok = FALSE;
+	}
+	if(!ok)
+		libr_discard(handle);
+	libr_close(handle);
+	if(ok && output != NULL)
+		ok = assemble(output, source);
+	free(source);
+	return (ok ? 0 : 1);
+}
@@ -283,8 +283,8 @@ EXPORT_FN int libr_gtk_load(BuilderHandle **gtk_ret, char *resource_name)
 		/* GtkBuilder was not linked with the application */
 		return false;
 	}
-	/* Obtain the handle to the executable */
-	if((handle = libr_open(NULL, LIBR_READ)) == NULL)
+	/* Obtain the handle to the executable (in-memory when the resource was linked in) */
+	if((handle = open_program_resources(resource_name)) == NULL)
 	{
 		/* "Failed to open this executable (%s) for resources", progname() */
 		return false;
@@ -319,8 +319,8 @@ EXPORT_FN int libr_gtk_autoload(BuilderHandle **gtk_ret, IconList **icons_ret, i
 		/* GtkBuilder was not linked with the application */
 		return false;
 	}
-	/* Obtain the handle to the executable */
-	if((handle = libr_open(NULL, LIBR_READ)) == NULL)
+	/* Obtain the handle to the executable (in-memory when the resource was linked in) */
+	if((handle = open_program_resources(BUILDER_SECTION)) == NULL)
 	{
 		/* "Failed to open this executable (%s) for resources", progname() */
 		return false;
@@ -389,8 +389,8 @@ EXPORT_FN int libr_glade_load(GladeHandle **glade_ret, char *resource_name)
 		/* libglade was not linked with the application */
 		return false;
 	}
-	/* Obtain the handle to the executable */
-	if((handle = libr_open(NULL, LIBR_READ)) == NULL)
+	/* Obtain the handle to the executable (in-memory when the resource was linked in) */
+	if((handle = open_program_resources(resource_name)) == NULL)
 	{
 		/* "Failed to open this executable (%s) for resources", progname() */
 		return false;
@@ -424,8 +424,8 @@ EXPORT_FN int libr_glade_autoload(GladeHandle **glade_ret, IconList **icons_ret,
 		/* libglade was not linked with the application */
 		return false;
 	}
-	/* Obtain the handle to the executable */
-	if((handle = libr_open(NULL, LIBR_READ)) == NULL)
+	/* Obtain the handle to the executable (in-memory when the resource was linked in) */
+	if((handle = open_program_resources(GLADE_SECTION)) == NULL)
 	{
 		/* "Failed to open this executable (%s) for resources", progname() */
 		return false;
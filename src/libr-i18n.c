@@ -65,8 +65,8 @@ EXPORT_FN int libr_i18n_autoload(const char *domain)
 {
 	libr_file *handle;
 	
-	/* Obtain the handle to the executable */
-	if((handle = libr_open(NULL, LIBR_READ)) == NULL)
+	/* Obtain the handle to the executable (in-memory when resources were linked in) */
+	if((handle = open_program_resources(NULL)) == NULL)
 	{
 		/* "Failed to open this executable (%s) for resources", progname() */
 		return false;
@@ -577,7 +577,7 @@ EXPORT_FN int libr_icon_write(libr_file *handle, libr_icon *icon, char *icon_nam
 		return false;
 	}
 	/* First add the icon as a new named section */
-	if(!libr_write(handle, icon_name, icon->buffer, icon->buffer_size, LIBR_COMPRESSED, overwrite))
+	if(!libr_write(handle, icon_name, icon->buffer, icon->buffer_size, LIBR_AUTO, overwrite))
 	{
 		/* Failed to add the icon as a resource */
 		goto writeicon_complete;
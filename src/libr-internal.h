@@ -9,6 +9,9 @@
 #define LIBR_TEMPFILE              "/tmp/libr-temp.XXXXXX"
 #define LIBR_TEMPFILE_LEN          22
 
+/* For indexing shared resource data by name and contents */
+#include "nameindex.h"
+
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 
 typedef struct {
@@ -17,6 +20,133 @@ typedef struct {
 	const char *function;
 } libr_intstatus;
 
+/* Read-only mapping of the ELF binary shared by all resource views of a handle */
+typedef struct {
+	char *address;
+	size_t size;
+	unsigned int views;
+} libr_filemap;
+
+/* How libr_write stores resources (set with libr_set_policy, libr_set_codec and libr_set_alignment) */
+typedef struct {
+	unsigned int min_saving; /* percentage of the size that compression must save */
+	int level;               /* compression level, 0 for the default of the codec */
+	libr_type_t codec;       /* codec that LIBR_AUTO compresses with (zlib unless set) */
+	size_t alignment;        /* boundary the stored data starts on, relative to the file */
+} libr_policy;
+
+/* Resource holding data that aliases may share (see libr_write) */
+typedef struct {
+	char *name;
+	libr_type_t type;
+	size_t size;
+	uint32_t digest;
+	size_t alignment;    /* aliases only share data stored on the same boundary */
+	unsigned int refs;   /* number of aliases sharing the data */
+} libr_blob;
+
+/* Index of the blobs of a handle, built when first needed */
+typedef struct {
+	int ready;
+	nameindex names;     /* resource name -> libr_blob */
+	nameindex contents;  /* digest and size -> libr_blob */
+} libr_blobs;
+
+/* Resource stored in the archive section (see libr_set_archive) */
+typedef struct _libr_packed {
+	char *name;
+	uint64_t offset;     /* start of the resource within the archive section */
+	uint64_t length;
+	size_t alignment;
+	char *data;          /* resource waiting to be written (NULL once it is in the section) */
+	unsigned long slot;  /* position in the list of entries */
+	int raw;             /* data holds the contents, still to be stored as "type" (see embed.c) */
+	libr_type_t type;
+} libr_packed;
+
+/* Archive section of a handle, read when first needed */
+typedef struct {
+	int loaded;
+	int enabled;         /* libr_write adds resources to the archive */
+	int changed;         /* the archive section has to be written out */
+	libr_packed **entries;
+	unsigned long count;
+	unsigned long max;
+	nameindex names;     /* resource name -> libr_packed */
+} libr_archive;
+
+/* Resource described by the table of contents section (see toc.c) */
+typedef struct _libr_tocentry {
+	const char *name;    /* points into the names read with the table */
+	uint64_t size;
+	uint64_t stored_size;
+	uint64_t length;     /* size of the section (or archive entry) holding the resource */
+	uint32_t digest;
+	uint32_t alignment;
+	libr_type_t type;
+	unsigned int version;
+	unsigned int flags;
+	int packed;          /* stored in the archive section */
+	int checked;         /* 1 once the header of the resource agreed with the entry, -1 if it did not */
+} libr_tocentry;
+
+/* Table of contents of a handle, read when first needed */
+typedef struct {
+	int loaded;
+	int valid;           /* the table matches the sections of the file */
+	int changed;         /* resources were written or cleared since the table was written */
+	libr_tocentry *entries;
+	unsigned long count;
+	char *table;         /* records and names as read from the section */
+	nameindex index;     /* resource name -> libr_tocentry */
+} libr_toc;
+
+/* Archives of an image loaded into memory (see libr_open_loaded) */
+typedef struct {
+	int loaded;          /* the handle reads the archives in memory instead of a file */
+	const char **archives;
+	size_t *sizes;
+	unsigned long count;
+} libr_image;
+
+/* Names of the resources of a handle in sorted order (see libr_glob), built when first needed */
+typedef struct {
+	int ready;
+	char **names;
+	unsigned long count;
+} libr_names;
+
+/* Assembler source written with the resources of a handle for linking (see libr_open_embed) */
+typedef struct {
+	int enabled;         /* libr_write collects resources for the source instead of a binary */
+	char *output;
+} libr_embed;
+
+/* Read-only handle shared by every libr_open of the same file (see libr_open) */
+typedef struct {
+	int interned;        /* the handle is in the list of shared handles */
+	dev_t device;
+	ino_t inode;
+	time_t mtime;
+	long mtime_nsec;     /* files written in place may keep the same second */
+	off_t size;
+	unsigned int refs;   /* number of libr_open calls not yet closed */
+	struct _libr_file *next;
+} libr_shared;
+
+/* State kept by the backend-independent code, part of the handle of every backend */
+typedef struct {
+	libr_filemap filemap;
+	libr_policy policy;
+	libr_blobs blobs;
+	libr_archive archive;
+	libr_toc toc;
+	libr_names sorted;
+	libr_image image;
+	libr_embed embed;
+	libr_shared shared;
+} libr_frontend;
+
 #endif /* DOXYGEN_SHOULD_SKIP_THIS */
 
 struct _libr_file;
@@ -24,7 +154,7 @@ struct _libr_file;
 void libr_set_error(libr_intstatus error);
 libr_intstatus make_status(const char *function, libr_status code, char *message, ...);
 /* Only called directly by cleanup routine, all other calls should be through libr_close */
-void libr_close_internal(struct _libr_file *file_handle);
+libr_intstatus libr_close_internal(struct _libr_file *file_handle);
 
 #define SET_ERROR(code,...)           make_status(__FUNCTION__, code, __VA_ARGS__)
 #define RETURN(code,...)              return SET_ERROR(code, __VA_ARGS__)
@@ -0,0 +1,94 @@
+#ifndef __LIBR_RESOURCE_H
+#define __LIBR_RESOURCE_H
+
+/* For size_t */
+#include <stddef.h>
+
+/*
+ * Layout of the header written in front of each declared resource (see libr_write in libr.c):
+ * "RES2", uint8 type (uncompressed), uint8 flags, 2 reserved, uint32 offset of the data,
+ * uint32 alignment, uint64 size, uint32 digest (none), uint32 parameter
+ */
+#define LIBR_RESOURCE_MAGIC      "RES2"
+#define LIBR_RESOURCE_HEADER     32
+#define LIBR_RESOURCE_ALIGN      16
+
+#define __LIBR_RESOURCE_STR(x)   #x
+#define __LIBR_RESOURCE_XSTR(x)  __LIBR_RESOURCE_STR(x)
+
+/**
+ * @page LIBR_RESOURCE Declare a resource in a C or C++ source file.
+ * @section SYNOPSIS
+ * 	\#include <libr-resource.h>
+ *
+ * 	<b>LIBR_RESOURCE(identifier, "path");</b>
+ * 	<b>LIBR_RESOURCE_NAMED(identifier, "name", "path");</b>
+ * 	<b>const unsigned char *LIBR_RESOURCE_DATA(identifier);</b>
+ * 	<b>size_t LIBR_RESOURCE_SIZE(identifier);</b>
+ *
+ * @section DESCRIPTION
+ * 	Stores the file at <i>path</i> as an uncompressed resource of the
+ * 	program while the source is compiled, so no libr tool has to touch the
+ * 	binary afterwards.  The resource is written to an allocated, read-only
+ * 	section named <i>identifier</i> (or <i>name</i>) with the same header
+ * 	that <b>libr_write</b>(3) writes, so <b>libr_read</b>(3),
+ * 	<b>libr_size</b>(3) and the other functions reading the program with
+ * 	<b>libr_open</b>(3) find it like any other resource.  The data is
+ * 	loaded with the program as well: <b>LIBR_RESOURCE_DATA</b>() and
+ * 	<b>LIBR_RESOURCE_SIZE</b>() give the code declaring the resource
+ * 	direct access to it (aligned to 16 bytes) without any lookup.
+ *
+ * 	The file is pulled in by the assembler with <b>.incbin</b>, so
+ * 	relative paths are searched for from the directory the compiler runs
+ * 	in and the directories passed with <b>-Wa,-I</b><i>directory</i>.
+ * 	Each name may only be declared once in a program, the sections of
+ * 	resources with the same name would be merged by the linker (a
+ * 	repeated <i>identifier</i> is reported by the linker).  Linking with
+ * 	<b>--gc-sections</b> drops resources that the code never refers to.
+ * 	Declared resources are part of the program image, they must not be
+ * 	rewritten or cleared with <b>libr_write</b>(3) or <b>libr_clear</b>(3).
+ *
+ * 	C++ code can also build a resource at compile time from a constant
+ * 	array and view it as a constexpr span, see <b>libr-resource.hpp</b>.
+ *
+ * 	@param identifier The name of the resource (when no <i>name</i> is
+ * 		given) and of the symbols marking its data.
+ * 	@param name The name of the resource.
+ * 	@param path The file holding the data of the resource.
+ *
+ * @section SA SEE ALSO
+ * 	<b>libr_read</b>(3), <b>libr_size</b>(3), <b>libr_open_embed</b>(3)
+ *
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+#define LIBR_RESOURCE_NAMED(identifier, name, path) \
+	__asm__( \
+		".pushsection \"" name "\",\"a\",%progbits\n" \
+		".balign " __LIBR_RESOURCE_XSTR(LIBR_RESOURCE_ALIGN) "\n" \
+		".ascii \"" LIBR_RESOURCE_MAGIC "\"\n" \
+		".byte 0, 0, 0, 0\n" \
+		".long " __LIBR_RESOURCE_XSTR(LIBR_RESOURCE_HEADER) ", " __LIBR_RESOURCE_XSTR(LIBR_RESOURCE_ALIGN) "\n" \
+		".quad 2f-1f\n" \
+		".long 0, 0\n" \
+		".globl libr_resource_" #identifier "\n" \
+		".hidden libr_resource_" #identifier "\n" \
+		".globl libr_resource_" #identifier "_end\n" \
+		".hidden libr_resource_" #identifier "_end\n" \
+		"libr_resource_" #identifier ":\n" \
+		"1:\n" \
+		".incbin \"" path "\"\n" \
+		"2:\n" \
+		"libr_resource_" #identifier "_end:\n" \
+		".popsection\n" \
+	); \
+	extern const unsigned char libr_resource_##identifier[] \
+		__asm__("libr_resource_" #identifier) __attribute__((visibility("hidden"))); \
+	extern const unsigned char libr_resource_##identifier##_end[] \
+		__asm__("libr_resource_" #identifier "_end") __attribute__((visibility("hidden")))
+
+#define LIBR_RESOURCE(identifier, path) LIBR_RESOURCE_NAMED(identifier, #identifier, path)
+#define LIBR_RESOURCE_DATA(identifier) ((const unsigned char *) libr_resource_##identifier)
+#define LIBR_RESOURCE_SIZE(identifier) ((size_t) (libr_resource_##identifier##_end-libr_resource_##identifier))
+
+#endif /* __LIBR_RESOURCE_H */
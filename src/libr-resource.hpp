@@ -0,0 +1,90 @@
+#ifndef __LIBR_RESOURCE_HPP
+#define __LIBR_RESOURCE_HPP
+
+/*
+ * Resources built by the C++ compiler (C++20)
+ *
+ * LIBR_RESOURCE_CONSTEXPR(identifier, "name", array) places the constant byte array "array" (a
+ * string of #embed data, a generated table, ...) behind a libr header in the section "name", so
+ * that libr_read and libr_size find it in the program, and declares "identifier" as a constexpr
+ * std::span<const std::byte> over the data for use at compile time.  Every byte is copied while
+ * compiling, large files may need a higher -fconstexpr-ops-limit (or LIBR_RESOURCE from
+ * libr-resource.h, which has the assembler include the file instead).
+ */
+
+#include "libr-resource.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace libr {
+
+/* The header in front of the data, see libr-resource.h */
+struct resource_header {
+	char magic[4];
+	std::uint8_t type;
+	std::uint8_t flags;
+	std::uint8_t reserved[2];
+	std::uint32_t data_offset;
+	std::uint32_t alignment;
+	std::uint64_t size;
+	std::uint32_t digest;
+	std::uint32_t parameter;
+};
+static_assert(sizeof(resource_header) == LIBR_RESOURCE_HEADER, "unexpected libr header layout");
+
+/* A header followed by the (uncompressed) data */
+template<std::size_t N>
+struct alignas(LIBR_RESOURCE_ALIGN) resource {
+	resource_header header;
+	std::array<std::byte, N> data;
+	
+	constexpr std::span<const std::byte, N> bytes() const { return std::span<const std::byte, N>(data); }
+};
+
+/*
+ * Build a resource from a constant array of bytes
+ */
+template<typename T, std::size_t N>
+constexpr resource<N> make_resource(const T (&bytes)[N])
+{
+	static_assert(sizeof(T) == 1, "resources are built from arrays of bytes");
+	resource<N> res{{{'R', 'E', 'S', '2'}, 0, 0, {0, 0}, LIBR_RESOURCE_HEADER, LIBR_RESOURCE_ALIGN, N, 0, 0}, {}};
+	
+	for(std::size_t i = 0; i < N; i++)
+		res.data[i] = static_cast<std::byte>(bytes[i]);
+	return res;
+}
+
+/*
+ * Build a resource from a string literal (without the terminating '\0')
+ */
+template<std::size_t N>
+constexpr resource<N-1> make_string_resource(const char (&string)[N])
+{
+	resource<N-1> res{{{'R', 'E', 'S', '2'}, 0, 0, {0, 0}, LIBR_RESOURCE_HEADER, LIBR_RESOURCE_ALIGN, N-1, 0, 0}, {}};
+	
+	for(std::size_t i = 0; i < N-1; i++)
+		res.data[i] = static_cast<std::byte>(string[i]);
+	return res;
+}
+
+} /* namespace libr */
+
+/*
+ * The span is emitted under a prefixed symbol: a symbol (or COMDAT group) named like the identifier
+ * would clash with the section of a resource that is named like its identifier
+ */
+#define LIBR_RESOURCE_CONSTEXPR(identifier, name, array) \
+	[[gnu::section(name), gnu::used]] inline constexpr auto libr_resource_##identifier = ::libr::make_resource(array); \
+	inline constexpr std::span<const std::byte, libr_resource_##identifier.data.size()> identifier \
+		__asm__("libr_span_" #identifier) = libr_resource_##identifier.bytes()
+
+#define LIBR_STRING_RESOURCE_CONSTEXPR(identifier, name, string) \
+	[[gnu::section(name), gnu::used]] inline constexpr auto libr_resource_##identifier = ::libr::make_string_resource(string); \
+	inline constexpr std::span<const std::byte, libr_resource_##identifier.data.size()> identifier \
+		__asm__("libr_span_" #identifier) = libr_resource_##identifier.bytes()
+
+#endif /* __LIBR_RESOURCE_HPP */
@@ -4,6 +4,7 @@
  *  Copyright (c) 2008-2009 Martin Rosenau
  *
  *  libr read-only Backend - Read resources from ELF binaries
+ *  (built as the native backend it can also write them, without libbfd or libelf)
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU Lesser General Public License as published by
@@ -36,10 +37,28 @@
 /* For memory byte-wise compare */
 #include <string.h>
 
+/* For printing warnings */
+#include <stdio.h>
+
 /* For endian conversion */
 #include "cvtendian.h"
 
+/* For reading (and writing) the ELF binary */
+#include <unistd.h>
+#include <fcntl.h>
+
+#ifdef __LIBR_BACKEND_native__
+#define RETURN_UNSUPPORTED RETURN(LIBR_ERROR_UNSUPPORTED, "The native backend does not support this operation");
+#else
 #define RETURN_UNSUPPORTED RETURN(LIBR_ERROR_UNSUPPORTED, "The read-only backend does not support this operation");
+#endif /* __LIBR_BACKEND_native__ */
+
+/* Section types and flags needed to tell which sections can be changed */
+#define SHT_NULL      0
+#define SHT_PROGBITS  1
+#define SHT_NOBITS    8
+#define SHF_ALLOC     0x2
+#define SHN_LORESERVE 0xff00
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 
@@ -83,23 +102,313 @@ typedef struct {
 #define SECOFF_SIZE(b)      SECOFF_OFFSET(b)+ELF_OFF(b)      /* ElfXX_XWord sh_size; */
 #define SECOFF_LINK(b)      SECOFF_SIZE(b)+ELF_XWORD(b)      /* ElfXX_Word  sh_link; */
 #define SECOFF_INFO(b)      SECOFF_LINK(b)+ELF_WORD(b)       /* ElfXX_Word  sh_info; */
-#define SECOFF_ADDRALIGN    SECOFF_INFO(b)+ELF_WORD(b)       /* ElfXX_XWord sh_addralign; */
-#define SECOFF_ENTSIZE      SECOFF_ADDRALIGN(b)+ELF_XWORD(b) /* ElfXX_XWord sh_entsize; */
+#define SECOFF_ADDRALIGN(b) SECOFF_INFO(b)+ELF_WORD(b)       /* ElfXX_XWord sh_addralign; */
+#define SECOFF_ENTSIZE(b)   SECOFF_ADDRALIGN(b)+ELF_XWORD(b) /* ElfXX_XWord sh_entsize; */
 
 /*
- * Safely read a parameter from the ELF binary
+ * Decode a parameter from a buffer holding part of the ELF binary
  */
-static int read_param(FILE *handle, void *result, size_t bytes, eClass endian)
+static uint64_t get_param(const char *buffer, size_t bytes, eEncoding endian)
 {
-	if(fread(result, 1, bytes, handle) != bytes)
-		return 0;
-	if(ferror(handle))
+	uint16_t half;
+	uint32_t word;
+	uint64_t xword;
+	
+	switch(bytes)
+	{
+		case sizeof(uint16_t):
+			memcpy(&half, buffer, bytes);
+			if(endian != HOST_ENDIAN)
+				ConvertEndian(&half, bytes);
+			return half;
+		case sizeof(uint32_t):
+			memcpy(&word, buffer, bytes);
+			if(endian != HOST_ENDIAN)
+				ConvertEndian(&word, bytes);
+			return word;
+		default:
+			memcpy(&xword, buffer, bytes);
+			if(endian != HOST_ENDIAN)
+				ConvertEndian(&xword, bytes);
+			return xword;
+	}
+}
+
+#ifdef __LIBR_BACKEND_native__
+
+/*
+ * Encode a parameter into a buffer holding part of the ELF binary
+ */
+static void put_param(char *buffer, uint64_t value, size_t bytes, eEncoding endian)
+{
+	uint16_t half = value;
+	uint32_t word = value;
+	void *param;
+	
+	switch(bytes)
+	{
+		case sizeof(uint16_t):
+			param = &half;
+			break;
+		case sizeof(uint32_t):
+			param = &word;
+			break;
+		default:
+			param = &value;
+			break;
+	}
+	if(endian != HOST_ENDIAN)
+		ConvertEndian(param, bytes);
+	memcpy(buffer, param, bytes);
+}
+
+/*
+ * Write data to the end of the ELF binary (respecting the requested alignment)
+ */
+static int append_data(int fd, off_t *end, uint64_t align, const void *buffer, size_t size, uint64_t *offset)
+{
+	if(align > 1)
+		*end = (*end+align-1) & ~((off_t) align-1);
+	if(pwrite(fd, buffer, size, *end) != size)
 		return 0;
-	if(endian != HOST_ENDIAN && !ConvertEndian(result, bytes))
+	*offset = *end;
+	*end += size;
+	return 1;
+}
+
+/*
+ * Check for a change to a section that has not been written yet
+ */
+static int section_pending(libr_section *scn)
+{
+	return (scn->buffer != NULL || scn->removed);
+}
+
+/*
+ * Check for a section added after the file was opened
+ */
+static int section_added(libr_file *file_handle, libr_section *scn)
+{
+	return (scn < file_handle->secdata || scn >= &(file_handle->secdata[file_handle->total_sections]));
+}
+
+/*
+ * Only sections that are not loaded into memory can be changed without rebuilding the binary
+ */
+static libr_intstatus section_writable(libr_file *file_handle, libr_section *scn)
+{
+	if(file_handle->access != LIBR_READ_WRITE)
+		RETURN(LIBR_ERROR_NOPERM, "Open handle with LIBR_READ_WRITE access");
+	if(scn == &(file_handle->secdata[file_handle->strings_sec]))
+		RETURN(LIBR_ERROR_UNSUPPORTED, "The section name table cannot be changed");
+	if((scn->flags & SHF_ALLOC) || scn->type == SHT_NOBITS)
+		RETURN(LIBR_ERROR_UNSUPPORTED, "Only sections that are not loaded into memory can be changed");
+	RETURN_OK;
+}
+
+/*
+ * Append a changed section to the ELF binary and point its section header at the new data
+ */
+static int write_section(libr_file *file_handle, int fd, off_t *end, libr_section *scn, char *shdr)
+{
+	eClass b = file_handle->byte_size;
+	uint64_t offset;
+	
+	/* Removed sections keep their slot (section indexes elsewhere in the file stay valid) */
+	if(scn->removed)
+	{
+		memset(shdr, 0, file_handle->shentsize);
+		return 1;
+	}
+	if(!append_data(fd, end, scn->addralign, scn->buffer, scn->size, &offset))
 		return 0;
+	put_param(&shdr[SECOFF_OFFSET(b)], offset, ELF_OFF(b), file_handle->endian);
+	put_param(&shdr[SECOFF_SIZE(b)], scn->size, ELF_XWORD(b), file_handle->endian);
 	return 1;
 }
 
+/*
+ * Write the staged changes to the end of the ELF binary, then point the ELF header at the
+ * new section header table (nothing refers to the new data until that final write)
+ */
+static libr_intstatus append_changes(libr_file *file_handle, int fd, off_t *end, char *table, char *strtab, size_t strtab_size, uint64_t *shoff)
+{
+	unsigned long shnum = file_handle->shnum, i;
+	uint16_t shentsize = file_handle->shentsize;
+	eEncoding endian = file_handle->endian;
+	eClass b = file_handle->byte_size;
+	char header[sizeof(uint64_t)];
+	libr_section *scn;
+	uint64_t offset;
+	
+	for(i=0; i<file_handle->total_sections; i++)
+	{
+		scn = &(file_handle->secdata[i]);
+		if(section_pending(scn) && !write_section(file_handle, fd, end, scn, &table[scn->index*shentsize]))
+			RETURN(LIBR_ERROR_UPDATE, "Failed to perform dynamic update: %m.");
+	}
+	for(scn = file_handle->added; scn != NULL; scn = scn->next)
+	{
+		char *shdr;
+		
+		if(!section_pending(scn) || (scn->removed && scn->index == 0))
+			continue;
+		if(scn->index == 0)
+		{
+			/* New sections get a fresh header and a name at the end of the name table */
+			shdr = &table[(shnum++)*shentsize];
+			memset(shdr, 0, shentsize);
+			put_param(&shdr[SECOFF_NAME(b)], strtab_size, ELF_WORD(b), endian);
+			put_param(&shdr[SECOFF_TYPE(b)], SHT_PROGBITS, ELF_WORD(b), endian);
+			put_param(&shdr[SECOFF_ADDRALIGN(b)], scn->addralign, ELF_XWORD(b), endian);
+			strcpy(&strtab[strtab_size], scn->name);
+			strtab_size += strlen(scn->name)+1;
+		}
+		else
+			shdr = &table[scn->index*shentsize];
+		if(!write_section(file_handle, fd, end, scn, shdr))
+			RETURN(LIBR_ERROR_UPDATE, "Failed to perform dynamic update: %m.");
+	}
+	/* Store the names of new sections in a new copy of the section name table */
+	if(shnum != file_handle->shnum)
+	{
+		char *shdr = &table[file_handle->strings_sec*shentsize];
+		
+		if(!append_data(fd, end, 1, strtab, strtab_size, &offset))
+			RETURN(LIBR_ERROR_UPDATE, "Failed to perform dynamic update: %m.");
+		put_param(&shdr[SECOFF_OFFSET(b)], offset, ELF_OFF(b), endian);
+		put_param(&shdr[SECOFF_SIZE(b)], strtab_size, ELF_XWORD(b), endian);
+	}
+	if(!append_data(fd, end, sizeof(uint64_t), table, shnum*shentsize, &offset))
+		RETURN(LIBR_ERROR_UPDATE, "Failed to perform dynamic update: %m.");
+	/* Commit the changes by updating the ELF header */
+	put_param(header, offset, ELF_OFF(b), endian);
+	if(pwrite(fd, header, ELF_OFF(b), HDROFF_SHOFF(b)) != ELF_OFF(b))
+		RETURN(LIBR_ERROR_UPDATE, "Failed to perform dynamic update: %m.");
+	put_param(header, shnum, ELF_HALF(b), endian);
+	if(pwrite(fd, header, ELF_HALF(b), HDROFF_SHNUM(b)) != ELF_HALF(b))
+		RETURN(LIBR_ERROR_UPDATE, "Failed to perform dynamic update: %m.");
+	*shoff = offset;
+	RETURN_OK;
+}
+
+/*
+ * Bring a section up-to-date with the section header table that was just written
+ */
+static void apply_section(libr_file *file_handle, libr_section *scn, char *table)
+{
+	eEncoding endian = file_handle->endian;
+	eClass b = file_handle->byte_size;
+	char *shdr;
+	
+	if(scn->index == 0)
+		scn->index = file_handle->shnum++;
+	shdr = &table[scn->index*file_handle->shentsize];
+	scn->data_offset = get_param(&shdr[SECOFF_OFFSET(b)], ELF_OFF(b), endian);
+	scn->size = get_param(&shdr[SECOFF_SIZE(b)], ELF_XWORD(b), endian);
+	scn->removed = false;
+	free(scn->buffer);
+	scn->buffer = NULL;
+}
+
+/*
+ * Bring the handle up-to-date with the section header table that was just written
+ */
+static void apply_changes(libr_file *file_handle, char *table, uint64_t shoff)
+{
+	libr_section *scn;
+	unsigned long i;
+	
+	file_handle->shoff = shoff;
+	for(i=0; i<file_handle->total_sections; i++)
+	{
+		scn = &(file_handle->secdata[i]);
+		if(section_pending(scn))
+			apply_section(file_handle, scn, table);
+	}
+	for(scn = file_handle->added; scn != NULL; scn = scn->next)
+	{
+		if(section_pending(scn) && !(scn->removed && scn->index == 0))
+			apply_section(file_handle, scn, table);
+	}
+	apply_section(file_handle, &(file_handle->secdata[file_handle->strings_sec]), table);
+}
+
+/*
+ * Write every staged change to the ELF binary, rewriting only the section tables
+ * (the space of the old data and tables is not reclaimed, so the file grows with each commit)
+ */
+static libr_intstatus write_changes(libr_file *file_handle)
+{
+	size_t table_size, strtab_size, names_size = 0;
+	unsigned long changes = 0, added = 0, i;
+	char *table = NULL, *strtab = NULL;
+	libr_section *scn, *strscn;
+	libr_intstatus ret;
+	off_t file_size;
+	uint64_t shoff = 0;
+	int fd;
+	
+	for(i=0; i<file_handle->total_sections; i++)
+		changes += section_pending(&(file_handle->secdata[i]));
+	for(scn = file_handle->added; scn != NULL; scn = scn->next)
+	{
+		if(!section_pending(scn) || (scn->removed && scn->index == 0))
+			continue;
+		changes++;
+		if(scn->index == 0)
+		{
+			added++;
+			names_size += strlen(scn->name)+1;
+		}
+	}
+	if(changes == 0)
+		RETURN_OK;
+	if(file_handle->shnum+added >= SHN_LORESERVE)
+		RETURN(LIBR_ERROR_NEWSECTION, "Failed to create new section");
+	/* Load the section header table (and the name table, if there are new names) */
+	fd = file_handle->fd_handle;
+	strscn = &(file_handle->secdata[file_handle->strings_sec]);
+	strtab_size = strscn->size;
+	table_size = file_handle->shentsize*file_handle->shnum;
+	table = (char *) malloc(table_size+file_handle->shentsize*added);
+	if(added != 0)
+		strtab = (char *) malloc(strtab_size+names_size);
+	if(table == NULL || (added != 0 && strtab == NULL))
+	{
+		ret = SET_ERROR(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+		goto done;
+	}
+	if(pread(fd, table, table_size, file_handle->shoff) != table_size
+		|| (added != 0 && read_section(file_handle, strscn, 0, strtab, strtab_size) != strtab_size))
+	{
+		ret = SET_ERROR(LIBR_ERROR_GETSHDR, "Failed to obtain ELF section header: %m");
+		goto done;
+	}
+	if((file_size = lseek(fd, 0, SEEK_END)) == ERROR)
+	{
+		ret = SET_ERROR(LIBR_ERROR_NOSIZE, "Failed to obtain file size");
+		goto done;
+	}
+	/* Discard anything partially appended */
+	{
+		off_t end = file_size;
+		
+		ret = append_changes(file_handle, fd, &end, table, strtab, strtab_size, &shoff);
+		if(ret.status != LIBR_OK && end != file_size && ftruncate(fd, file_size) == ERROR)
+			printf("failed to restore output file size.\n");
+	}
+	if(ret.status == LIBR_OK)
+		apply_changes(file_handle, table, shoff);
+	
+done:
+	free(strtab);
+	free(table);
+	return ret;
+}
+
+#endif /* __LIBR_BACKEND_native__ */
+
 /*
  * The read-only backend requires no initialization
  */
@@ -110,16 +419,91 @@ void initialize_backend(void)
 }
 
 /*
- * The read-only backend cannot write an output file
+ * Write any changes to the ELF binary (native backend only) and release the handles
+ */
+void write_output(libr_file *file_handle)
+{
+#ifdef __LIBR_BACKEND_native__
+	libr_section *scn, *next;
+	unsigned long i;
+	
+	if(file_handle->access == LIBR_READ_WRITE && write_changes(file_handle).status != LIBR_OK)
+		printf("failed to write output file.\n");
+	for(i=0; i<file_handle->total_sections; i++)
+		free(file_handle->secdata[i].buffer);
+	for(scn = file_handle->added; scn != NULL; scn = next)
+	{
+		next = scn->next;
+		free(scn->buffer);
+		free(scn);
+	}
+#endif /* __LIBR_BACKEND_native__ */
+	nameindex_free(&(file_handle->index));
+	free(file_handle->secdata);
+	free(file_handle->strtab);
+	close(file_handle->fd_handle);
+}
+
+/*
+ * Return the descriptor of the file that was parsed
  */
-void write_output(libr_file *file_handle) {}
+int input_descriptor(libr_file *file_handle)
+{
+	return file_handle->fd_handle;
+}
 
 /*
- * The read-only backend cannot add sections
+ * Add a section (the read-only backend cannot add sections)
  */
 libr_intstatus add_section(libr_file *file_handle, char *resource_name, libr_section **retscn)
 {
+#ifdef __LIBR_BACKEND_native__
+	libr_section *scn, **last;
+	
+	/* The name of a new section is stored right after it */
+	scn = (libr_section *) calloc(1, sizeof(libr_section)+strlen(resource_name)+1);
+	if(scn == NULL)
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	scn->name = strcpy((char *) &scn[1], resource_name);
+	scn->type = SHT_PROGBITS;
+	scn->addralign = 1;
+	if(!nameindex_add(&(file_handle->index), scn->name, scn))
+	{
+		free(scn);
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	}
+	/* Keep the new sections in the order they were added */
+	for(last = &(file_handle->added); *last != NULL; last = &((*last)->next)) {}
+	*last = scn;
+	*retscn = scn;
+	RETURN_OK;
+#else
+	RETURN_UNSUPPORTED;
+#endif /* __LIBR_BACKEND_native__ */
+}
+
+/*
+ * Start a batch of changes (the native backend holds every change until it is committed)
+ */
+libr_intstatus begin_update(libr_file *file_handle)
+{
+#ifdef __LIBR_BACKEND_native__
+	RETURN_OK;
+#else
+	RETURN_UNSUPPORTED;
+#endif /* __LIBR_BACKEND_native__ */
+}
+
+/*
+ * Write all of the changes made so far
+ */
+libr_intstatus commit_update(libr_file *file_handle)
+{
+#ifdef __LIBR_BACKEND_native__
+	return write_changes(file_handle);
+#else
 	RETURN_UNSUPPORTED;
+#endif /* __LIBR_BACKEND_native__ */
 }
 
 /*
@@ -129,7 +513,28 @@ char *section_name(libr_file *file_handle, libr_section *scn)
 {
 	if(scn == NULL)
 		return NULL;
-	return scn->name;
+	return (char *) scn->name;
+}
+
+/*
+ * Return the file offset of the data in the section
+ */
+off_t section_offset(libr_file *file_handle, libr_section *scn)
+{
+#ifdef __LIBR_BACKEND_native__
+	/* Data waiting to be written is not in the file yet */
+	if(section_pending(scn))
+		return ERROR;
+#endif /* __LIBR_BACKEND_native__ */
+	return scn->data_offset;
+}
+
+/*
+ * Return the size of the section as stored in the file
+ */
+size_t section_size(libr_file *file_handle, libr_section *scn)
+{
+	return scn->size;
 }
 
 /*
@@ -153,20 +558,14 @@ size_t data_size(libr_section *scn, libr_data *data)
  */
 libr_intstatus find_section(libr_file *file_handle, char *section, libr_section **retscn)
 {
-	char *test_name;
-	int i;
+	libr_section *scn;
 	
-	for(i=0; i<file_handle->total_sections; i++)
-	{
-		test_name = section_name(file_handle, &(file_handle->secdata[i]));
-		if(test_name != NULL && strcmp(test_name, section) == 0)
-			break;
-	}
-	if(i >= file_handle->total_sections)
+	scn = (libr_section *) nameindex_find(&(file_handle->index), section);
+	if(scn == NULL)
 		RETURN(LIBR_ERROR_NOSECTION, "ELF resource section not found");
 	
 	/* Found the resource, hurray! */
-	*retscn = &(file_handle->secdata[i]);
+	*retscn = scn;
 	RETURN_OK;
 }
 
@@ -175,17 +574,18 @@ libr_intstatus find_section(libr_file *file_handle, char *section, libr_section
  */
 libr_data *get_data(libr_file *file_handle, libr_section *scn)
 {
-	FILE *handle = file_handle->handle;
 	libr_data *data = NULL;
-	size_t n;
+	ssize_t n;
 	
-	fseek(handle, scn->data_offset, SEEK_SET);
+#ifdef __LIBR_BACKEND_native__
+	/* Data waiting to be written is the current content of the section */
+	if(scn->buffer != NULL)
+		return scn->buffer;
+#endif /* __LIBR_BACKEND_native__ */
 	data = (libr_data *) malloc(scn->size);
-	n = fread(data, 1, scn->size, handle);
-	if(n == 0)
+	n = pread(file_handle->fd_handle, data, scn->size, scn->data_offset);
+	if(n <= 0)
 		goto failed; /* Empty section? */
-	if(ferror(handle))
-		goto failed;
 	
 	/* Succeeded in reading the data */
 	return data;
@@ -195,11 +595,55 @@ failed:
 }
 
 /*
- * UNSUPORTED BY BACKEND: Create a new data section
+ * Release the section data obtained with get_data
+ * (data waiting to be written belongs to the section)
+ */
+void free_data(libr_file *file_handle, libr_section *scn, libr_data *data)
+{
+#ifdef __LIBR_BACKEND_native__
+	if(data == scn->buffer)
+		return;
+#endif /* __LIBR_BACKEND_native__ */
+	free(data);
+}
+
+/*
+ * Read part of a section from the ELF binary (without loading the rest)
+ */
+size_t read_section(libr_file *file_handle, libr_section *scn, off_t offset, char *buffer, size_t size)
+{
+	ssize_t n;
+	
+	if(offset >= scn->size)
+		return 0;
+	if(size > scn->size-offset)
+		size = scn->size-offset;
+#ifdef __LIBR_BACKEND_native__
+	if(scn->buffer != NULL)
+	{
+		memcpy(buffer, &scn->buffer[offset], size);
+		return size;
+	}
+#endif /* __LIBR_BACKEND_native__ */
+	n = pread(file_handle->fd_handle, buffer, size, scn->data_offset+offset);
+	return (n < 0 ? 0 : n);
+}
+
+/*
+ * Create new data for a section (UNSUPPORTED BY THE READ-ONLY BACKEND)
  */
 libr_data *new_data(libr_file *file_handle, libr_section *scn)
 {
+#ifdef __LIBR_BACKEND_native__
+	/* NOTE: expanding data is handled by set_data */
+	if(scn->buffer != NULL)
+		return scn->buffer;
+	scn->size = 0;
+	scn->buffer = (char *) malloc(1);
+	return scn->buffer;
+#else
 	return NULL;
+#endif /* __LIBR_BACKEND_native__ */
 }
 
 /*
@@ -208,144 +652,266 @@ libr_data *new_data(libr_file *file_handle, libr_section *scn)
 libr_section *next_section(libr_file *file_handle, libr_section *scn)
 {
 	int total_sections = file_handle->total_sections;
-	libr_section *test_scn = NULL;
 	int i;
 	
-	if(total_sections == 0)
-		return NULL;
-	/* Requesting the first section */
-	if(scn == NULL)
+#ifdef __LIBR_BACKEND_native__
+	/* Sections added since the file was opened follow the ones that were in it */
+	if(scn != NULL && section_added(file_handle, scn))
 	{
-		i = 0;
-		/* Do not return an empty section */
-		while(test_scn == NULL || test_scn->size == 0)
-		{
-			if(i > total_sections)
-				return NULL;
-			test_scn = &(file_handle->secdata[i++]);
-		}
-		return test_scn;
+		for(scn = scn->next; scn != NULL && scn->size == 0; scn = scn->next) {}
+		return scn;
 	}
-	/* Return the next section given a section pointer */
-	for(i=0; i<total_sections; i++)
+#endif /* __LIBR_BACKEND_native__ */
+	/* Start with the first section or the one following the given section */
+	i = (scn == NULL ? 0 : (scn-file_handle->secdata)+1);
+	for(; i<total_sections; i++)
 	{
-		test_scn = &(file_handle->secdata[i]);
-		
-		if(test_scn == scn && (i+1) < total_sections)
-		{
-			libr_section *next_scn = &(file_handle->secdata[i+1]);
-			
-			/* Returning empty sections is pointless */
-			if(next_scn->size != 0)
-				return next_scn;
-		}
+		/* Returning empty sections is pointless (but keep looking past them) */
+		if(file_handle->secdata[i].size != 0)
+			return &(file_handle->secdata[i]);
 	}
+#ifdef __LIBR_BACKEND_native__
+	for(scn = file_handle->added; scn != NULL && scn->size == 0; scn = scn->next) {}
+	return scn;
+#else
 	return NULL;
+#endif /* __LIBR_BACKEND_native__ */
 }
 
 /*
- * UNSUPORTED BY BACKEND: Remove a section
+ * Remove a section (UNSUPPORTED BY THE READ-ONLY BACKEND)
  */
 libr_intstatus remove_section(libr_file *file_handle, libr_section *scn)
 {
+#ifdef __LIBR_BACKEND_native__
+	libr_intstatus ret;
+	
+	if(!section_added(file_handle, scn) && (ret = section_writable(file_handle, scn)).status != LIBR_OK)
+		return ret;
+	nameindex_remove(&(file_handle->index), scn->name, scn);
+	free(scn->buffer);
+	scn->buffer = NULL;
+	scn->size = 0;
+	scn->removed = true;
+	RETURN_OK;
+#else
 	RETURN_UNSUPPORTED;
+#endif /* __LIBR_BACKEND_native__ */
 }
 
 /*
- * UNSUPORTED BY BACKEND: Set the data for a section
+ * Start the data of a section on a multiple of alignment bytes (UNSUPPORTED BY THE READ-ONLY BACKEND)
+ */
+libr_intstatus set_alignment(libr_file *file_handle, libr_section *scn, size_t alignment)
+{
+#ifdef __LIBR_BACKEND_native__
+	libr_intstatus ret;
+	
+	if(!section_added(file_handle, scn) && (ret = section_writable(file_handle, scn)).status != LIBR_OK)
+		return ret;
+	/* Applied when the pending data is appended to the file */
+	if(alignment > scn->addralign)
+		scn->addralign = alignment;
+	RETURN_OK;
+#else
+	RETURN_UNSUPPORTED;
+#endif /* __LIBR_BACKEND_native__ */
+}
+
+/*
+ * Set the data for a section, held in memory until written (UNSUPPORTED BY THE READ-ONLY BACKEND)
  */
 libr_intstatus set_data(libr_file *file_handle, libr_section *scn, libr_data *data, off_t offset, char *buffer, size_t size)
 {
+#ifdef __LIBR_BACKEND_native__
+	libr_intstatus ret;
+	char *intbuffer;
+	
+	if(!section_added(file_handle, scn) && (ret = section_writable(file_handle, scn)).status != LIBR_OK)
+		return ret;
+	/* special case: clear buffer (the data itself is released with free_data) */
+	if(buffer == NULL)
+	{
+		if(scn->buffer != data)
+			free(scn->buffer);
+		scn->buffer = NULL;
+		scn->size = 0;
+		RETURN_OK;
+	}
+	/* normal case: add new data to the buffer */
+	if((intbuffer = (char *) realloc(data, offset+size)) == NULL)
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	if(scn->buffer != NULL && scn->buffer != data)
+		free(scn->buffer);
+	memcpy(&intbuffer[offset], buffer, size);
+	scn->buffer = intbuffer;
+	scn->size = offset+size;
+	RETURN_OK;
+#else
 	RETURN_UNSUPPORTED;
+#endif /* __LIBR_BACKEND_native__ */
 }
 
 /*
  * Open a handle to the ELF binary (provided that read-only access is requested)
+ * NOTE: The ELF header, the section header table and the section name table are each
+ * loaded with a single read and then decoded from memory.
  */
 libr_intstatus open_handles(libr_file *file_handle, char *filename, libr_access_t access)
 {
+	char header[HDROFF_SHSTRNDX(ELFCLASS64)+sizeof(uint16_t)];
 	const char elf_magic[] = {'\x7F','E','L','F'};
 	uint16_t total_sections, sh_size, strings_sec;
+	char *table = NULL, *strtab = NULL;
+	uint64_t sh_offset, sh_name, strtab_offset, strtab_size;
+	libr_section *secdata = NULL;
 	ElfPreHeader file_info;
-	libr_section *secdata;
-	FILE *handle = NULL;
-	uint64_t sh_offset;
+	libr_intstatus ret;
+	eEncoding endian;
 	unsigned long i;
+	ssize_t n;
+	eClass b;
+	int fd;
 	
+#ifdef __LIBR_BACKEND_native__
+	fd = open(filename, (access == LIBR_READ_WRITE ? O_RDWR : O_RDONLY));
+#else
 	if(access == LIBR_READ_WRITE)
 		RETURN_UNSUPPORTED;
-	handle = fopen(filename, "rb");
-	if(!handle)
+	fd = open(filename, O_RDONLY);
+#endif /* __LIBR_BACKEND_native__ */
+	if(fd == ERROR)
 		RETURN(LIBR_ERROR_OPENFAILED, "Failed to open input file");
-	if(fread(&file_info, 1, sizeof(ElfPreHeader), handle) != sizeof(ElfPreHeader))
-		RETURN(LIBR_ERROR_WRONGFORMAT, "Failed to read pre-header bytes from input file");
+	n = pread(fd, header, sizeof(header), 0);
+	if(n < (ssize_t) sizeof(ElfPreHeader))
+	{
+		ret = SET_ERROR(LIBR_ERROR_WRONGFORMAT, "Failed to read pre-header bytes from input file");
+		goto failed;
+	}
+	memcpy(&file_info, header, sizeof(ElfPreHeader));
 	if(memcmp(file_info.magic, elf_magic, sizeof(elf_magic)) != 0)
-		RETURN(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: not an ELF binary");
-
+	{
+		ret = SET_ERROR(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: not an ELF binary");
+		goto failed;
+	}
+	
 	/* Confirm processor (byte size) and packing (endian) */
 	if(!enum_valid(file_info.byte_size, ELFCLASS))
-		RETURN(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: invalid byte size");
+	{
+		ret = SET_ERROR(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: invalid byte size");
+		goto failed;
+	}
 	if(!enum_valid(file_info.endian, ELFDATA))
-		RETURN(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: invalid endian type");
+	{
+		ret = SET_ERROR(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: invalid endian type");
+		goto failed;
+	}
+	b = file_info.byte_size;
+	endian = file_info.endian;
+	if(n < (ssize_t) (HDROFF_SHSTRNDX(b)+ELF_HALF(b)))
+	{
+		ret = SET_ERROR(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: failed to read ELF header");
+		goto failed;
+	}
 	
-	/* Get the file offset to the Section Header tables */
-	fseek(handle, HDROFF_SHOFF(file_info.byte_size), SEEK_SET);
-	if(!read_param(handle, &sh_offset, ELF_OFF(file_info.byte_size), file_info.endian))
-		RETURN(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: failed to read section header offset");
-	/* Get the size of the Section Header tables */
-	fseek(handle, HDROFF_SHENTSIZE(file_info.byte_size), SEEK_SET);
-	if(!read_param(handle, &sh_size, ELF_HALF(file_info.byte_size), file_info.endian))
-		RETURN(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: failed to read section header size");
-	/* Get the total number of sections */
-	fseek(handle, HDROFF_SHNUM(file_info.byte_size), SEEK_SET);
-	if(!read_param(handle, &total_sections, ELF_HALF(file_info.byte_size), file_info.endian))
-		RETURN(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: failed to read total number of sections");
-	/* Get the ID of the "strings" section */
-	fseek(handle, HDROFF_SHSTRNDX(file_info.byte_size), SEEK_SET);
-	if(!read_param(handle, &strings_sec, ELF_HALF(file_info.byte_size), file_info.endian))
-		RETURN(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: failed to read string section ID");
+	/* Get the location and layout of the Section Header tables */
+	sh_offset = get_param(&header[HDROFF_SHOFF(b)], ELF_OFF(b), endian);
+	sh_size = get_param(&header[HDROFF_SHENTSIZE(b)], ELF_HALF(b), endian);
+	total_sections = get_param(&header[HDROFF_SHNUM(b)], ELF_HALF(b), endian);
+	strings_sec = get_param(&header[HDROFF_SHSTRNDX(b)], ELF_HALF(b), endian);
 	if(strings_sec >= total_sections)
-		RETURN(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: invalid string section ID");
-	secdata = (libr_section *) malloc(sizeof(libr_section)*total_sections);
+	{
+		ret = SET_ERROR(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: invalid string section ID");
+		goto failed;
+	}
+	if(sh_size < SECOFF_ENTSIZE(b)+ELF_XWORD(b))
+	{
+		ret = SET_ERROR(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: invalid section header size");
+		goto failed;
+	}
+	table = (char *) malloc((size_t) sh_size*total_sections);
+	secdata = (libr_section *) calloc(total_sections, sizeof(libr_section));
+	if(table == NULL || secdata == NULL)
+	{
+		ret = SET_ERROR(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+		goto failed;
+	}
 	
 	/* Load section information */
+	if(pread(fd, table, (size_t) sh_size*total_sections, sh_offset) != (ssize_t) sh_size*total_sections)
+	{
+		ret = SET_ERROR(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: failed to read section headers");
+		goto failed;
+	}
+	/* Load the "strings" section (it is kept for the lifetime of the handle) */
+	strtab_size = get_param(&table[strings_sec*sh_size+SECOFF_SIZE(b)], ELF_XWORD(b), endian);
+	if((strtab = (char *) malloc(strtab_size+1)) == NULL)
+	{
+		ret = SET_ERROR(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+		goto failed;
+	}
+	strtab_offset = get_param(&table[strings_sec*sh_size+SECOFF_OFFSET(b)], ELF_OFF(b), endian);
+	if(pread(fd, strtab, strtab_size, strtab_offset) != (ssize_t) strtab_size)
+	{
+		ret = SET_ERROR(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: failed to read string");
+		goto failed;
+	}
+	strtab[strtab_size] = '\0';
 	for(i=0; i<total_sections; i++)
 	{
-		long sec_start = sh_offset+sh_size*i;
+		const char *shdr = &table[i*sh_size];
 		
-		/* Grab the offset in the string table to the name of the section */
-		fseek(handle, sec_start+SECOFF_NAME(file_info.byte_size), SEEK_SET);
-		if(!read_param(handle, &(secdata[i].name_offset), ELF_WORD(file_info.byte_size), file_info.endian))
-			RETURN(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: failed to read section name offset");
-		/* Grab the offset to the data for the section */
-		fseek(handle, sec_start+SECOFF_OFFSET(file_info.byte_size), SEEK_SET);
-		if(!read_param(handle, &(secdata[i].data_offset), ELF_OFF(file_info.byte_size), file_info.endian))
-			RETURN(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: failed to read section data offset");
-		/* Grab the size of the data for the section */
-		fseek(handle, sec_start+SECOFF_SIZE(file_info.byte_size), SEEK_SET);
-		if(!read_param(handle, &(secdata[i].size), ELF_XWORD(file_info.byte_size), file_info.endian))
-			RETURN(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: failed to read section size");
-	}
-	/* Locate the name offset within the "strings" section and load the string */
+		/* Names that are not in the table are left empty */
+		sh_name = get_param(&shdr[SECOFF_NAME(b)], ELF_WORD(b), endian);
+		secdata[i].name = &strtab[(sh_name < strtab_size ? sh_name : strtab_size)];
+		secdata[i].data_offset = get_param(&shdr[SECOFF_OFFSET(b)], ELF_OFF(b), endian);
+		secdata[i].size = get_param(&shdr[SECOFF_SIZE(b)], ELF_XWORD(b), endian);
+#ifdef __LIBR_BACKEND_native__
+		/* Writing needs to know which sections are safe to change */
+		secdata[i].type = get_param(&shdr[SECOFF_TYPE(b)], ELF_WORD(b), endian);
+		secdata[i].flags = get_param(&shdr[SECOFF_FLAGS(b)], ELF_XWORD(b), endian);
+		secdata[i].addralign = get_param(&shdr[SECOFF_ADDRALIGN(b)], ELF_XWORD(b), endian);
+		secdata[i].index = i;
+#endif /* __LIBR_BACKEND_native__ */
+	}
+	/* Index the section names for constant-time lookups */
+	if(!nameindex_init(&(file_handle->index), total_sections, false))
+	{
+		ret = SET_ERROR(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+		goto failed;
+	}
 	for(i=0; i<total_sections; i++)
 	{
-		long stringsec_start = secdata[strings_sec].data_offset;
-		size_t n;
-		
-		fseek(handle, stringsec_start+secdata[i].name_offset, SEEK_SET);
-		n = fread(secdata[i].name, 1, ELFSTRING_MAX-1, handle);
-		if(ferror(handle))
-			RETURN(LIBR_ERROR_WRONGFORMAT, "Invalid input file format: failed to read string");
-		secdata[i].name[n] = '\0';
+		if(!nameindex_add(&(file_handle->index), secdata[i].name, &(secdata[i])))
+		{
+			ret = SET_ERROR(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+			goto failed;
+		}
 	}
+	free(table);
 	
 	/* Hold onto the important parameters */
 	file_handle->secdata = secdata;
+	file_handle->strtab = strtab;
 	file_handle->total_sections = total_sections;
-	file_handle->endian = file_info.endian;
-	file_handle->byte_size = file_info.byte_size;
-	file_handle->handle = handle;
+	file_handle->endian = endian;
+	file_handle->byte_size = b;
+	file_handle->fd_handle = fd;
 	file_handle->filename = filename;
 	file_handle->access = access;
+#ifdef __LIBR_BACKEND_native__
+	file_handle->shoff = sh_offset;
+	file_handle->shentsize = sh_size;
+	file_handle->shnum = total_sections;
+	file_handle->strings_sec = strings_sec;
+#endif /* __LIBR_BACKEND_native__ */
 	RETURN_OK;
+	
+failed:
+	nameindex_free(&(file_handle->index));
+	free(strtab);
+	free(table);
+	free(secdata);
+	close(fd);
+	return ret;
 }
@@ -1,12 +1,12 @@
 #ifndef __LIBRRO_H
 #define __LIBRRO_H
 
-/* For file handle support */
-#include <stdio.h>
-
 /* For integer types with set bit-sizes */
 #include <stdint.h>
 
+/* For constant-time section lookups */
+#include "nameindex.h"
+
 /* 
  * NOTE: Packing the enum uses the smallest number of bytes
  * possible to represent the value.  This packing does not
@@ -34,22 +34,40 @@ typedef enum SHORT_ENUM {
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 
-#define ELFSTRING_MAX 200
+/* NOTE: Section names point into the copy of the section name table kept by the handle */
 typedef struct _libr_section {
 	uint64_t size;
 	uint64_t data_offset;
-	uint32_t name_offset;
-	char name[ELFSTRING_MAX];
+	const char *name;
+#ifdef __LIBR_BACKEND_native__
+	uint32_t type;
+	uint64_t flags;
+	uint64_t addralign;
+	unsigned long index;         /* Position in the section header table (0 until written) */
+	char *buffer;                /* Data waiting to be written */
+	int removed;
+	struct _libr_section *next;  /* Sections added after the file was opened */
+#endif /* __LIBR_BACKEND_native__ */
 } libr_section;
 
 typedef struct _libr_file {
-	FILE *handle;
+	int fd_handle;
 	char *filename;
 	eEncoding endian;
 	eClass byte_size;
 	libr_access_t access;
 	libr_section *secdata;
 	unsigned long total_sections;
+	char *strtab;
+	nameindex index;
+	libr_frontend front;
+#ifdef __LIBR_BACKEND_native__
+	uint64_t shoff;
+	uint16_t shentsize;
+	unsigned long shnum;
+	unsigned long strings_sec;
+	libr_section *added;
+#endif /* __LIBR_BACKEND_native__ */
 } libr_file;
 
 #endif /* DOXYGEN_SHOULD_SKIP_THIS */
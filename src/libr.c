@@ -23,83 +23,192 @@
  *
  */
 
+/* Find the images loaded into the process (dl_iterate_phdr and dlinfo are GNU extensions) */
+#define _GNU_SOURCE
+
 /* Include compile-time parameters */
 #include "config.h"
 
 #include "libr.h"
 #include "tempfiles.h"
+#include "parallel.h"
+#include "codecs.h"
+#include "archive.h"
+#include "embed.h"
+#include "toc.h"
 
 /* Obtain file information */
 #include <sys/stat.h>
 #include <stdlib.h>
 #include <stdio.h>
 
+/* Map files for zero-copy resource views */
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+
 /* Compress files */
 #include <zlib.h>
-#include <math.h> /* for ceil */
 
 /* Handle strings and variable arguments*/
 #include <string.h>
 #include <stdarg.h>
 
+/* Match resource names against wildcards */
+#include <fnmatch.h>
+
 /* For C99 number types */
 #include <stdint.h>
 
 /* Handle status codes for multiple threads */
 #include <pthread.h>
 
-#define SPEC_VERSION             '1'
+/* Read the resources of images loaded into memory */
+#ifdef HAVE_DL_ITERATE_PHDR
+#include <link.h>
+#endif /* HAVE_DL_ITERATE_PHDR */
+#ifdef HAVE_DLINFO
+#include <dlfcn.h>
+#endif /* HAVE_DLINFO */
+
+#define SPEC_VERSION             '2'
+#define LEGACY_VERSION           '1'
+#define OFFSET_VERSION           ((unsigned long) 3)
 #define OFFSET_TYPE              ((unsigned long) 4)
+/* Version 1 header: uncompressed data follows the storage type, zlib data its uncompressed size */
 #define OFFSET_UNCOMPRESSED      ((unsigned long) OFFSET_TYPE+sizeof(unsigned char))
 #define OFFSET_UNCOMPRESSED_SIZE ((unsigned long) OFFSET_TYPE+sizeof(unsigned char))
 #define OFFSET_COMPRESSED        ((unsigned long) OFFSET_UNCOMPRESSED_SIZE+sizeof(uint32_t))
+/* Version 2 header: fixed-size, followed by the block table of LIBR_SEEKABLE resources */
+#define OFFSET_FLAGS             ((unsigned long) OFFSET_TYPE+sizeof(unsigned char))
+#define OFFSET_DATA              ((unsigned long) 8)
+#define OFFSET_ALIGNMENT         ((unsigned long) OFFSET_DATA+sizeof(uint32_t))
+#define OFFSET_SIZE              ((unsigned long) OFFSET_ALIGNMENT+sizeof(uint32_t))
+#define OFFSET_DIGEST            ((unsigned long) OFFSET_SIZE+sizeof(uint64_t))
+#define OFFSET_PARAMETER         ((unsigned long) OFFSET_DIGEST+sizeof(uint32_t))
+#define HEADER_SIZE              ((unsigned long) OFFSET_PARAMETER+sizeof(uint32_t))
+#define HEADER_MAX               HEADER_SIZE
+#define ALIGNMENT_MAX            ((size_t) 64*1024)
+#define DIGEST_CHUNK             ((size_t) 1024*1024*1024)
+#define BLOB_KEY_LEN             64
+#define COMPARE_PIECE            65536
+#define SEEKABLE_BLOCK           ((size_t) 64*1024)
+#define DEFLATE_BLOCK            ((size_t) 128*1024)
+#define DEFLATE_WINDOW           ((size_t) 32*1024)
+#define PARALLEL_MIN             ((size_t) 1024*1024)
+#define AUTO_MIN_SIZE            ((size_t) 64)
+#define AUTO_SAMPLE              ((size_t) 16*1024)
+#define AUTO_SAMPLES             3
+#define AUTO_SAMPLE_LEVEL        1
+#define DEFAULT_MIN_SAVING       10
+#define ZLIB_LEVEL(level)        ((level) == CODEC_DEFAULT_LEVEL ? Z_DEFAULT_COMPRESSION : ((level) > Z_BEST_COMPRESSION ? Z_BEST_COMPRESSION : (level)))
+#define STREAM_CHUNK             ((size_t) 64*1024)
+#define ERROR_MESSAGE_LEN        1024
 
 #if 0
  extern const char * __progname_full;
  #define progpath() (char *) __progname_full
 #endif
 #define getself() ((char *) "/proc/self/exe")
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+	#define stat_mtime_nsec(info) ((long) (info)->st_mtim.tv_nsec)
+#else
+	#define stat_mtime_nsec(info) 0L
+#endif /* HAVE_STRUCT_STAT_ST_MTIM */
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+/* Decoded resource header */
+typedef struct {
+	libr_type_t type;
+	size_t base;        /* start of the resource within the section (archived resources) */
+	unsigned int version;
+	unsigned int flags;
+	size_t alignment;
+	uint32_t digest;
+	size_t table_offset; /* LIBR_SEEKABLE: start of the block table within the section */
+	size_t data_offset; /* start of the stored data within the section (including base) */
+	size_t stored_size; /* bytes of stored data following the header */
+	size_t size;        /* size of the data once unpacked */
+	size_t block_size;  /* LIBR_SEEKABLE: unpacked bytes per block */
+	size_t blocks;      /* LIBR_SEEKABLE: number of blocks (the table holds one more entry) */
+} libr_header;
+
+/* Blocks of a resource being compressed in parallel */
+typedef struct {
+	char *input;
+	size_t size;
+	size_t block_size;
+	size_t blocks;
+	char *output;        /* lead bytes, then one slot of slot_size bytes per block */
+	size_t lead;
+	size_t slot_size;
+	size_t *packed;      /* bytes of each slot used by the compressed block */
+	uLong *checksums;    /* adler-32 of each (uncompressed) block */
+	int level;
+} libr_packing;
 
-pthread_key_t error_key;
+/* Blocks of a seekable resource being unpacked in parallel */
+typedef struct {
+	char *stored;
+	libr_header *info;
+	char *buffer;
+} libr_unpacking;
+
+/* Position of a sequential reader within a resource */
+struct _libr_stream {
+	libr_file *handle;
+	libr_section *scn;
+	libr_header info;
+	size_t position;           /* bytes of stored data consumed so far */
+	size_t produced;           /* bytes of unpacked data returned so far */
+	int finished;
+	z_stream zstream;
+	char chunk[STREAM_CHUNK];  /* stored data waiting to be inflated */
+	char *packed;              /* LIBR_SEEKABLE: stored data of one block */
+	size_t packed_max;
+	char *block;               /* LIBR_SEEKABLE: unpacked data of the cached block */
+	size_t cached;             /* LIBR_SEEKABLE: index+1 of the cached block (0 for none) */
+};
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+/* Status of the last call made by each thread (see make_status), no allocation is ever needed */
+static __thread libr_intstatus thread_status = {NULL, LIBR_OK, NULL};
+static __thread char thread_message[ERROR_MESSAGE_LEN];
+
+/* One-time library setup run by the first libr_open (see libr_open) */
+static pthread_once_t library_once = PTHREAD_ONCE_INIT;
+static int library_ready = false;
+
+/* Read-only handles shared by every libr_open of the same file (see libr_open) */
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER;
+static libr_file *shared_handles = NULL;
 
 /*
- * Free the error status code/message structure
- * (called on thread destruction or when a new code is set) 
+ * Set the error code and message for retrieval
  */
-void free_error_key(void *_m)
+void libr_set_error(libr_intstatus error)
 {
-	libr_intstatus *error = (libr_intstatus *) _m;
-	
-	if(error != NULL)
-	{
-		/* Free the error structure */
-		if(error->message != NULL)
-			free(error->message);
-		free(error);
-	}
+	thread_status = error;
 }
 
 /*
- * Set the error code and message for retrieval
+ * Serialize the state that a handle shared between threads builds on demand (see libr_open)
  */
-void libr_set_error(libr_intstatus error)
+static void lock_shared(libr_file *file_handle)
 {
-	static int thread_key_initialized = false;
-	libr_intstatus *status = NULL;
-	
-	if(!thread_key_initialized)
-	{
-		if(pthread_key_create(&error_key, free_error_key) != 0)
-			return; /* a serious pthread-related error occurred */
-		if(pthread_setspecific(error_key, NULL) != 0)
-			return; /* a serious pthread-related error occurred */
-		thread_key_initialized = true;
-	}
-	free_error_key(pthread_getspecific(error_key));
-	status = (libr_intstatus *) malloc(sizeof(libr_intstatus));
-	memcpy(status, &error, sizeof(libr_intstatus));
-	if(pthread_setspecific(error_key, (void *) status) != 0)
-		return; /* a serious pthread-related error occurred */
+	if(file_handle->front.shared.interned)
+		pthread_mutex_lock(&shared_lock);
+}
+
+/*
+ * Let other threads sharing the handle build their state again
+ */
+static void unlock_shared(libr_file *file_handle)
+{
+	if(file_handle->front.shared.interned)
+		pthread_mutex_unlock(&shared_lock);
 }
 
 /*
@@ -108,314 +217,2672 @@ void libr_set_error(libr_intstatus error)
  */
 libr_intstatus make_status(const char *function, libr_status code, char *message, ...)
 {
-	libr_intstatus status = {NULL, code, function};
+	libr_intstatus status = {message, code, function};
 	va_list args;
 	
-	if(message != NULL)
+	/* Only messages with arguments are formatted, all others are literals that can be kept as-is */
+	if(message != NULL && strchr(message, '%') != NULL)
 	{
-		status.message = (char *) malloc(1024);
 		va_start(args, message);
-		vsnprintf(status.message, 1024, message, args);
+		vsnprintf(thread_message, sizeof(thread_message), message, args);
 		va_end(args);
+		status.message = thread_message;
 	}
-	
 	libr_set_error(status);
 	return status;
 }
 
 /*
- * Make sure that the section is libr-compatible
+ * Make sure that a buffer starts with a libr-compatible header
  */
-libr_intstatus section_ok(libr_section *scn, libr_data *data)
+libr_intstatus header_ok(char *buffer, size_t size)
 {
-	char required_header[5], test_header[4] = {'R', 'E', 'S', SPEC_VERSION};
-	void *ptr = data_pointer(scn, data);
-	size_t size = data_size(scn, data);
+	char required_header[5], test_header[3] = {'R', 'E', 'S'};
 	
-	if(ptr == NULL || size < sizeof(required_header))
+	if(buffer == NULL || size < sizeof(required_header))
 		RETURN(LIBR_ERROR_NOTRESOURCE, "Not a valid libr-resource");
-	memcpy(required_header, ptr, sizeof(required_header));
+	memcpy(required_header, buffer, sizeof(required_header));
 	if(strncmp(required_header, test_header, sizeof(test_header)) != 0)
 		RETURN(LIBR_ERROR_NOTRESOURCE, "Not a valid libr-resource");
+	/* Resources written by older versions of libr remain readable */
+	if(required_header[OFFSET_VERSION] != SPEC_VERSION && required_header[OFFSET_VERSION] != LEGACY_VERSION)
+		RETURN(LIBR_ERROR_NOTRESOURCE, "Not a valid libr-resource");
 	RETURN_OK;
 }
 
 /*
- * Remove a resourcefrom the ELF binary handle
- */ 
-EXPORT_FN int libr_clear(libr_file *file_handle, char *resource_name)
+ * Make sure that the section is libr-compatible
+ */
+libr_intstatus section_ok(libr_section *scn, libr_data *data)
 {
-	libr_data *data = NULL;
-	libr_section *scn = NULL;
+	return header_ok((char *) data_pointer(scn, data), data_size(scn, data));
+}
+
+/*
+ * Decode a version 2 resource header
+ */
+libr_intstatus parse_header_v2(char *buffer, size_t buffer_size, size_t section_size, libr_header *info)
+{
+	uint32_t data_offset, alignment, digest, parameter;
+	uint64_t size_temp;
 	
-	/* Ensure valid inputs */
-	if(file_handle == NULL || resource_name == NULL)
-		PUBLIC_RETURN(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
-	if(file_handle->access != LIBR_READ_WRITE)
-		PUBLIC_RETURN(LIBR_ERROR_NOPERM, "Open handle with LIBR_READ_WRITE access");
-	/* Find the section containing the icon */
-	if(find_section(file_handle, resource_name, &scn).status != LIBR_OK)
-		return false; /* error already set */
-	/* Get the section data (interested in header) */
-	if((data = get_data(file_handle, scn)) == NULL)
-		PUBLIC_RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
-	/* Confirm that this resource is libr-compatible */
-	if(section_ok(scn, data).status != LIBR_OK)
-		return false; /* error already set */
-	/* Clear the data resource */
-	if(set_data(file_handle, scn, data, 0, NULL, 0).status != LIBR_OK)
-		return false; /* error already set */
-	/* Remove the section */
-	if(remove_section(file_handle, scn).status != LIBR_OK)
-		return false; /* error already set */
-	return true;
+	if(buffer_size < HEADER_SIZE || section_size < HEADER_SIZE)
+		RETURN(LIBR_ERROR_SIZEMISMATCH, "Section's data size does not make sense");
+	memcpy(&data_offset, &buffer[OFFSET_DATA], sizeof(uint32_t));
+	memcpy(&alignment, &buffer[OFFSET_ALIGNMENT], sizeof(uint32_t));
+	memcpy(&size_temp, &buffer[OFFSET_SIZE], sizeof(uint64_t));
+	memcpy(&digest, &buffer[OFFSET_DIGEST], sizeof(uint32_t));
+	memcpy(&parameter, &buffer[OFFSET_PARAMETER], sizeof(uint32_t));
+	if(data_offset < HEADER_SIZE || data_offset > section_size || size_temp > (size_t) -1)
+		RETURN(LIBR_ERROR_SIZEMISMATCH, "Section's data size does not make sense");
+	info->flags = (unsigned char) buffer[OFFSET_FLAGS];
+	info->alignment = alignment;
+	info->digest = digest;
+	info->size = size_temp;
+	info->data_offset = data_offset;
+	/* Aliases store the name of the resource holding the data in place of the data */
+	if(info->flags & LIBR_FLAG_ALIAS)
+	{
+		info->stored_size = section_size-info->data_offset;
+		RETURN_OK;
+	}
+	switch(info->type)
+	{
+		case LIBR_UNCOMPRESSED:
+			if(info->size > section_size-info->data_offset)
+				RETURN(LIBR_ERROR_SIZEMISMATCH, "Section's data size does not make sense");
+			break;
+		case LIBR_SEEKABLE:
+			if(parameter == 0)
+				RETURN(LIBR_ERROR_SIZEMISMATCH, "Section's data size does not make sense");
+			info->block_size = parameter;
+			info->blocks = info->size/info->block_size + (info->size%info->block_size != 0);
+			/* The block table (one offset per block plus the end of the data) must fit before the data */
+			if(info->blocks >= (info->data_offset-HEADER_SIZE)/sizeof(uint64_t))
+				RETURN(LIBR_ERROR_SIZEMISMATCH, "Section's data size does not make sense");
+			info->table_offset = HEADER_SIZE;
+			break;
+		default:
+			if(codec_find(info->type) == NULL)
+				RETURN(LIBR_ERROR_INVALIDTYPE, "Invalid data storage type specified");
+			break;
+	}
+	info->stored_size = section_size-info->data_offset;
+	RETURN_OK;
 }
 
 /*
- * Close the specified ELF binary handle
+ * Decode the resource header at the start of a section
  */
-EXPORT_FN void libr_close(libr_file *file_handle)
+libr_intstatus parse_header(char *buffer, size_t buffer_size, size_t section_size, libr_header *info)
 {
-	unregister_handle_cleanup(file_handle);
-	libr_close_internal(file_handle);
+	libr_intstatus ret;
+	
+	ret = header_ok(buffer, buffer_size);
+	if(ret.status != LIBR_OK)
+		return ret;
+	info->type = (libr_type_t) buffer[OFFSET_TYPE];
+	info->base = 0;
+	info->table_offset = 0;
+	info->version = buffer[OFFSET_VERSION]-'0';
+	info->flags = 0;
+	info->alignment = 1;
+	info->digest = 0;
+	if(buffer[OFFSET_VERSION] == SPEC_VERSION)
+		return parse_header_v2(buffer, buffer_size, section_size, info);
+	switch(info->type)
+	{
+		case LIBR_UNCOMPRESSED:
+			info->data_offset = OFFSET_UNCOMPRESSED;
+			if(section_size < info->data_offset)
+				RETURN(LIBR_ERROR_SIZEMISMATCH, "Section's data size does not make sense");
+			info->size = section_size-info->data_offset;
+			break;
+		case LIBR_COMPRESSED:
+		{
+			uint32_t size_temp;
+			
+			info->data_offset = OFFSET_COMPRESSED;
+			if(buffer_size < info->data_offset || section_size < info->data_offset)
+				RETURN(LIBR_ERROR_SIZEMISMATCH, "Section's data size does not make sense");
+			memcpy(&size_temp, &buffer[OFFSET_UNCOMPRESSED_SIZE], sizeof(uint32_t));
+			info->size = size_temp;
+		}	break;
+		default:
+			/* Only version 2 headers hold the other storage types */
+			RETURN(LIBR_ERROR_INVALIDTYPE, "Invalid data storage type specified");
+	}
+	info->stored_size = section_size-info->data_offset;
+	RETURN_OK;
 }
-/* Only called directly by cleanup routine, all other calls should be through libr_close */
-void libr_close_internal(libr_file *file_handle)
+
+/*
+ * Find the codec for a storage type (failing if libr was built without its library)
+ */
+libr_intstatus find_codec(libr_type_t type, const libr_codec **codec)
 {
-	write_output(file_handle);
-	free(file_handle);
+	if((*codec = codec_find(type)) == NULL)
+		RETURN(LIBR_ERROR_INVALIDTYPE, "Invalid data storage type specified");
+	if((*codec)->unpack == NULL)
+		RETURN(LIBR_ERROR_NOCODEC, "Storage type is not available in this build of libr: %s", (*codec)->name);
+	RETURN_OK;
 }
 
 /*
- * Return the last error message for the active thread
+ * Read part of the section holding a resource (the archives of a loaded image are read
+ * straight from memory, the offsets of their resources are addresses)
  */
-EXPORT_FN char *libr_errmsg(void)
+size_t read_stored(libr_file *file_handle, libr_section *scn, off_t offset, char *buffer, size_t size)
 {
-	libr_intstatus *error = (libr_intstatus *) pthread_getspecific(error_key);
-	
-	if(error == NULL)
-		return NULL;
-	return error->message;
+	if(file_handle->front.image.loaded)
+	{
+		memcpy(buffer, (char *) (uintptr_t) offset, size);
+		return size;
+	}
+	return read_section(file_handle, scn, offset, buffer, size);
 }
 
 /*
- * Return the last error code for the active thread (or LIBR_OK for no error)
+ * Read just the header of a resource stored at some offset of a section and decode it
+ * (the offsets in the decoded header are relative to the start of the section)
  */
-EXPORT_FN libr_status libr_errno(void)
+libr_intstatus read_header_at(libr_file *file_handle, libr_section *scn, size_t base, size_t length, libr_header *info)
 {
-	libr_intstatus *error = (libr_intstatus *) pthread_getspecific(error_key);
+	char header[HEADER_MAX];
+	libr_intstatus ret;
+	size_t header_size;
 	
-	if(error == NULL) /* Nothing has happened yet */
-		return LIBR_OK;
-	return error->status;
+	header_size = read_stored(file_handle, scn, base, header, (length < sizeof(header) ? length : sizeof(header)));
+	ret = parse_header(header, header_size, length, info);
+	if(ret.status != LIBR_OK)
+		return ret;
+	info->base = base;
+	info->table_offset += base;
+	info->data_offset += base;
+	RETURN_OK;
 }
 
 /*
- * Return the name of a libr-compatible resource
+ * Read just the resource header of a section and decode it
  */
-EXPORT_FN char *libr_list(libr_file *file_handle, unsigned int resourceid)
+libr_intstatus read_header(libr_file *file_handle, libr_section *scn, libr_header *info)
 {
-	libr_section *scn = NULL;
-	libr_data *data = NULL;
-	int i = 0;
-	
-	while((scn = next_section(file_handle, scn)) != NULL)
-	{
-		/* Get the section data (interested in header) */
-		if((data = get_data(file_handle, scn)) == NULL)
-			return NULL;
-		if(section_ok(scn, data).status == LIBR_OK)
-		{
-			if(i == resourceid)
-				return strdup(section_name(file_handle, scn));
-			i++;
-		}
-	}
-	return NULL;
+	return read_header_at(file_handle, scn, 0, section_size(file_handle, scn), info);
 }
 
 /*
- * Allocate a buffer containing the data of a resource
+ * Find a resource packed into the archive section and decode its header
  */
-EXPORT_FN char *libr_malloc(libr_file *file_handle, char *resource_name, size_t *size)
+libr_intstatus find_packed(libr_file *file_handle, char *resource_name, libr_section **scn, libr_header *info)
 {
-	char *buffer = NULL;
-	size_t size_local;
+	libr_packed *entry;
+	libr_intstatus ret;
 	
-	if(size == NULL)
-		size = &size_local;
-	if(!libr_size(file_handle, resource_name, size))
-		return NULL; /* error already set */
-	buffer = (char *) malloc(*size);
-	if(!libr_read(file_handle, resource_name, buffer))
+	ret = archive_find(file_handle, resource_name, &entry);
+	if(ret.status != LIBR_OK)
+		return ret;
+	/* Resources waiting to be written are written out first */
+	if(entry->data != NULL && (ret = archive_flush(file_handle)).status != LIBR_OK)
+		return ret;
+	/* The archives of a loaded image are not in a section */
+	*scn = NULL;
+	if(!file_handle->front.image.loaded && (ret = archive_section(file_handle, scn)).status != LIBR_OK)
+		return ret;
+	return read_header_at(file_handle, *scn, entry->offset, entry->length, info);
+}
+
+/*
+ * Read the name of the resource holding the data of an alias
+ */
+libr_intstatus alias_target(libr_file *file_handle, libr_section *scn, libr_header *info, char **target)
+{
+	if((*target = (char *) malloc(info->stored_size+1)) == NULL)
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	if(read_section(file_handle, scn, info->data_offset, *target, info->stored_size) != info->stored_size)
 	{
-		free(buffer);
-		return NULL; /* error already set */ 
+		free(*target);
+		RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
 	}
-	return buffer;
+	(*target)[info->stored_size] = '\0';
+	RETURN_OK;
 }
 
 /*
- * Open the specified ELF binary (caller if filename is NULL)
+ * Replace the section and header of an alias with those of the resource holding the data
  */
-EXPORT_FN libr_file *libr_open(char *filename, libr_access_t access)
+libr_intstatus resolve_alias(libr_file *file_handle, libr_section **scn, libr_header *info)
 {
-	libr_file *file_handle = NULL;
-	static int initialized = false;
+	libr_intstatus ret;
+	char *target;
 	
-	if(!initialized)
-	{
-		if(strncmp(zlibVersion(), ZLIB_VERSION, 1) != 0)
-		{
-			SET_ERROR(LIBR_ERROR_ZLIBINIT, "zlib library initialization failed"); 
-			return NULL;
-		}
-		initialize_backend();
-		initialized = true;
-	}
+	ret = alias_target(file_handle, *scn, info, &target);
+	if(ret.status != LIBR_OK)
+		return ret;
+	ret = find_section(file_handle, target, scn);
+	free(target);
+	if(ret.status != LIBR_OK)
+		return ret;
+	ret = read_header(file_handle, *scn, info);
+	if(ret.status != LIBR_OK)
+		return ret;
+	/* Aliases always refer directly to the resource holding the data */
+	if(info->flags & LIBR_FLAG_ALIAS)
+		RETURN(LIBR_ERROR_NOTRESOURCE, "Not a valid libr-resource");
+	info->flags |= LIBR_FLAG_ALIAS;
+	RETURN_OK;
+}
+
+/*
+ * Find the section holding the data of a resource (following an alias) and decode its header
+ */
+libr_intstatus find_resource(libr_file *file_handle, char *resource_name, libr_section **scn, libr_header *info)
+{
+	libr_intstatus ret;
 	
-	if(filename == NULL)
-		filename = getself();
-	file_handle = (libr_file *) malloc(sizeof(libr_file));
-	memset(file_handle, 0, sizeof(libr_file));
-	if(open_handles(file_handle, filename, access).status != LIBR_OK)
-	{
-		/* failed to open file for processing, error already set */ 
-		free(file_handle);
-		file_handle = NULL;
-	}
-	/* Cleanup handles automatically when libr exits memory */
-	if(file_handle != NULL)
-		register_handle_cleanup(file_handle);
-	return file_handle;
+	/* Loaded images only hold archived resources */
+	if(file_handle->front.image.loaded)
+		return find_packed(file_handle, resource_name, scn, info);
+	/* Sources for linking are only written to */
+	if(file_handle->front.embed.enabled)
+		RETURN(LIBR_ERROR_UNSUPPORTED, "The requested operation is not supported by the backend");
+	ret = find_section(file_handle, resource_name, scn);
+	if(ret.status == LIBR_ERROR_NOSECTION)
+		return find_packed(file_handle, resource_name, scn, info);
+	if(ret.status != LIBR_OK)
+		return ret;
+	ret = read_header(file_handle, *scn, info);
+	if(ret.status != LIBR_OK || !(info->flags & LIBR_FLAG_ALIAS))
+		return ret;
+	return resolve_alias(file_handle, scn, info);
 }
 
 /*
- * Read a resource from the specified ELF binary handle
+ * Find a resource in the table of contents, the first lookup of each entry checks it against
+ * the header of the resource (NULL when the table cannot answer or does not match the file)
  */
-EXPORT_FN int libr_read(libr_file *file_handle, char *resource_name, char *buffer)
+libr_tocentry *find_listed(libr_file *file_handle, char *resource_name)
 {
-	unsigned long uncompressed_size = 0, compressed_size = 0;
-	char *data_buffer = NULL;
 	libr_section *scn = NULL;
-	libr_data *data = NULL;
-	libr_type_t type;
+	libr_tocentry *entry;
+	libr_header info;
 	
-	/* Find the section containing the icon */
-	if(find_section(file_handle, resource_name, &scn).status != LIBR_OK)
-		return false; /* error already set */
-	/* Get the section data (interested in header) */
-	if((data = get_data(file_handle, scn)) == NULL)
-		PUBLIC_RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
-	/* Confirm that this resource is libr-compatible */
-	if(section_ok(scn, data).status != LIBR_OK)
-		return false; /* error already set */
-	data_buffer = (char *) data_pointer(scn, data);
-	/* Get the size of the data resource */
-	type = (libr_type_t) data_buffer[OFFSET_TYPE];
-	switch(type)
+	if((entry = toc_find(file_handle, resource_name)) == NULL)
+		return NULL;
+	lock_shared(file_handle);
+	if(entry->checked == 0)
 	{
-		case LIBR_UNCOMPRESSED:
-		{	if(data_size(scn, data)-OFFSET_UNCOMPRESSED < 0)
-				PUBLIC_RETURN(LIBR_ERROR_SIZEMISMATCH, "Section's data size does not make sense");
-			uncompressed_size = data_size(scn, data)-OFFSET_UNCOMPRESSED;
-			memcpy(buffer, &data_buffer[OFFSET_UNCOMPRESSED], uncompressed_size);
-		}	break;
-		case LIBR_COMPRESSED:
-		{
-			uint32_t size_temp;
-			
-			memcpy(&size_temp, &data_buffer[OFFSET_UNCOMPRESSED_SIZE], sizeof(uint32_t));
-			uncompressed_size = size_temp;
-			compressed_size = data_size(scn, data)-OFFSET_COMPRESSED;
-			if(uncompress((unsigned char *)buffer, &uncompressed_size, (unsigned char *)&data_buffer[OFFSET_COMPRESSED], compressed_size) != Z_OK)
-				PUBLIC_RETURN(LIBR_ERROR_UNCOMPRESS, "Failed to uncompress resource data");
-		}	break;
-		default:
-			PUBLIC_RETURN(LIBR_ERROR_INVALIDTYPE, "Invalid data storage type specified");
+		/* The table is only matched to the file by its section names and lengths */
+		entry->checked = -1;
+		if(find_resource(file_handle, resource_name, &scn, &info).status == LIBR_OK && info.size == entry->size
+			&& info.stored_size == entry->stored_size && info.type == entry->type && info.digest == entry->digest)
+			entry->checked = 1;
 	}
-	return true;
+	if(entry->checked != 1)
+		entry = NULL;
+	unlock_shared(file_handle);
+	return entry;
 }
 
 /*
- * Retrieve the number of libr-compatible resources
+ * Number of unpacked bytes in a block of a seekable resource
  */
-EXPORT_FN unsigned int libr_resources(libr_file *file_handle)
+size_t block_length(libr_header *info, size_t block)
 {
-	libr_section *scn = NULL;
-	libr_data *data = NULL;
-	int i = 0;
+	if(block == info->blocks-1)
+		return info->size-block*info->block_size;
+	return info->block_size;
+}
+
+/*
+ * Decode the block table entries (start and end) describing where a block is stored
+ */
+libr_intstatus locate_block(libr_header *info, char *entries, size_t *offset, size_t *size)
+{
+	uint64_t start, end;
 	
-	while((scn = next_section(file_handle, scn)) != NULL)
-	{
-		if((data = get_data(file_handle, scn)) == NULL)
-			continue;
-		if(section_ok(scn, data).status == LIBR_OK)
-			i++;
-	}
-	return i;
+	memcpy(&start, &entries[0], sizeof(uint64_t));
+	memcpy(&end, &entries[sizeof(uint64_t)], sizeof(uint64_t));
+	/* Both are set on every path, so callers never see them uninitialized */
+	*offset = info->data_offset;
+	*size = 0;
+	if(start > end || end > info->stored_size)
+		RETURN(LIBR_ERROR_SIZEMISMATCH, "Section's data size does not make sense");
+	*offset += start;
+	*size = end-start;
+	RETURN_OK;
 }
 
 /*
- * Get the size of a resource from the specified ELF binary handle
+ * Inflate a single independently compressed block
  */
-EXPORT_FN int libr_size(libr_file *file_handle, char *resource_name, size_t *retsize)
+libr_intstatus inflate_block(char *packed, size_t packed_size, char *buffer, size_t size)
 {
-	char *data_buffer = NULL;
-	libr_section *scn = NULL;
-	libr_data *data = NULL;
-	unsigned long size = 0;
-	libr_type_t type;
+	unsigned long unpacked_size = size;
 	
-	/* Find the section containing the icon */
-	if(find_section(file_handle, resource_name, &scn).status != LIBR_OK)
-		return false; /* error already set */
-	/* Get the section data (interested in header) */
-	if((data = get_data(file_handle, scn)) == NULL)
-		PUBLIC_RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
-	/* Confirm that this resource is libr-compatible */
-	if(section_ok(scn, data).status != LIBR_OK)
-		return false; /* error already set */
-	data_buffer = (char *) data_pointer(scn, data);
-	/* Get the size of the data resource */
-	type = (libr_type_t) data_buffer[OFFSET_TYPE];
-	switch(type)
+	if(uncompress((unsigned char *) buffer, &unpacked_size, (unsigned char *) packed, packed_size) != Z_OK
+		|| unpacked_size != size)
+		RETURN(LIBR_ERROR_UNCOMPRESS, "Failed to uncompress resource data");
+	RETURN_OK;
+}
+
+/*
+ * Largest amount of stored data a single block of a seekable resource may need
+ */
+size_t packed_limit(libr_header *info)
+{
+	size_t limit = compressBound(info->block_size);
+	
+	return (limit < info->stored_size ? limit : info->stored_size);
+}
+
+/*
+ * Read and inflate one block of a seekable resource (packed holds up to packed_max bytes)
+ */
+libr_intstatus read_block(libr_file *file_handle, libr_section *scn, libr_header *info, size_t block,
+                          char *packed, size_t packed_max, char *buffer)
+{
+	char entries[2*sizeof(uint64_t)];
+	size_t offset, size;
+	libr_intstatus ret;
+	
+	if(read_stored(file_handle, scn, info->table_offset+block*sizeof(uint64_t), entries, sizeof(entries)) != sizeof(entries))
+		RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+	ret = locate_block(info, entries, &offset, &size);
+	if(ret.status != LIBR_OK)
+		return ret;
+	if(size > packed_max)
+		RETURN(LIBR_ERROR_SIZEMISMATCH, "Section's data size does not make sense");
+	if(read_stored(file_handle, scn, offset, packed, size) != size)
+		RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+	return inflate_block(packed, size, buffer, block_length(info, block));
+}
+
+/*
+ * Copy a range of a seekable resource, inflating only the blocks that cover it
+ */
+libr_intstatus read_range(libr_file *file_handle, libr_section *scn, libr_header *info, size_t offset, size_t length, char *buffer)
+{
+	char *packed = NULL, *unpacked = NULL;
+	size_t block, last, packed_max;
+	libr_intstatus ret;
+	
+	if(length == 0)
+		RETURN_OK;
+	packed_max = packed_limit(info);
+	if((packed = (char *) malloc(packed_max)) == NULL)
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	last = (offset+length-1)/info->block_size;
+	for(block = offset/info->block_size; block <= last; block++)
 	{
-		case LIBR_UNCOMPRESSED:
+		size_t block_start = block*info->block_size, block_size = block_length(info, block);
+		size_t start, count;
+		
+		/* Blocks that are entirely wanted are inflated straight into the caller's buffer */
+		if(block_start >= offset && block_start+block_size <= offset+length)
 		{
-			size_t full_size = data_size(scn, data);
-			 
-			if(full_size-OFFSET_UNCOMPRESSED < 0)
-				PUBLIC_RETURN(LIBR_ERROR_SIZEMISMATCH, "Section's data size does not make sense"); 
-			size = full_size - OFFSET_UNCOMPRESSED;
-		}	break;
-		case LIBR_COMPRESSED:
+			ret = read_block(file_handle, scn, info, block, packed, packed_max, &buffer[block_start-offset]);
+			if(ret.status != LIBR_OK)
+				goto done;
+			continue;
+		}
+		if(unpacked == NULL && (unpacked = (char *) malloc(info->block_size)) == NULL)
 		{
-			memcpy(&size, &data_buffer[OFFSET_UNCOMPRESSED_SIZE], sizeof(uint32_t));
-		}	break;
-		default:
-			PUBLIC_RETURN(LIBR_ERROR_INVALIDTYPE, "Invalid data storage type specified");
+			ret = SET_ERROR(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+			goto done;
+		}
+		ret = read_block(file_handle, scn, info, block, packed, packed_max, unpacked);
+		if(ret.status != LIBR_OK)
+			goto done;
+		start = (offset > block_start ? offset-block_start : 0);
+		count = block_size-start;
+		if(count > offset+length-(block_start+start))
+			count = offset+length-(block_start+start);
+		memcpy(&buffer[block_start+start-offset], &unpacked[start], count);
 	}
-	*retsize = size;
-	return true;
+	ret = SET_ERROR(LIBR_OK, NULL);
+done:
+	free(unpacked);
+	free(packed);
+	return ret;
 }
 
 /*
- * Write a resource to the specified ELF binary handle
+ * Inflate one block of a seekable resource from the (complete) stored data of the section
  */
-EXPORT_FN int libr_write(libr_file *file_handle, char *resource_name, char *buffer, size_t size, libr_type_t type, libr_overwrite_t overwrite)
+libr_intstatus unpack_block(char *stored, libr_header *info, size_t block, char *buffer)
 {
-	char header[9] = {'R', 'E', 'S', SPEC_VERSION};
-	unsigned int header_size = 4;
-	libr_section *scn = NULL;
-	libr_data *data = NULL;
+	size_t offset, size;
 	libr_intstatus ret;
 	
-	/* Ensure valid inputs */
+	ret = locate_block(info, &stored[info->table_offset+block*sizeof(uint64_t)], &offset, &size);
+	if(ret.status != LIBR_OK)
+		return ret;
+	return inflate_block(&stored[offset], size, &buffer[block*info->block_size], block_length(info, block));
+}
+
+/*
+ * Inflate one block on behalf of unpack_blocks
+ */
+int unpack_task(void *context, size_t block)
+{
+	libr_unpacking *unpacking = (libr_unpacking *) context;
+	
+	return (unpack_block(unpacking->stored, unpacking->info, block, unpacking->buffer).status == LIBR_OK);
+}
+
+/*
+ * Inflate every block of a seekable resource from the (complete) stored data of the section
+ */
+libr_intstatus unpack_blocks(char *stored, libr_header *info, char *buffer)
+{
+	libr_unpacking unpacking;
+	libr_intstatus ret;
+	size_t block;
+	
+	/* Large resources are unpacked on every processor, straight into the caller's buffer */
+	if(info->size >= PARALLEL_MIN && parallel_workers(info->blocks) > 1)
+	{
+		unpacking.stored = stored;
+		unpacking.info = info;
+		unpacking.buffer = buffer;
+		if(!parallel_run(info->blocks, unpack_task, &unpacking))
+			RETURN(LIBR_ERROR_UNCOMPRESS, "Failed to uncompress resource data");
+		RETURN_OK;
+	}
+	for(block = 0; block < info->blocks; block++)
+	{
+		ret = unpack_block(stored, info, block, buffer);
+		if(ret.status != LIBR_OK)
+			return ret;
+	}
+	RETURN_OK;
+}
+
+/*
+ * Unpacked size of a block being compressed
+ */
+size_t packing_length(libr_packing *packing, size_t block)
+{
+	if(block == packing->blocks-1)
+		return packing->size-block*packing->block_size;
+	return packing->block_size;
+}
+
+/*
+ * Compress one block as a complete zlib stream of its own
+ */
+int compress_task(void *context, size_t block)
+{
+	libr_packing *packing = (libr_packing *) context;
+	unsigned long compressed_size = packing->slot_size;
+	
+	if(compress2((unsigned char *) &packing->output[packing->lead+block*packing->slot_size], &compressed_size,
+	             (unsigned char *) &packing->input[block*packing->block_size], packing_length(packing, block),
+	             ZLIB_LEVEL(packing->level)) != Z_OK)
+		return false;
+	packing->packed[block] = compressed_size;
+	return true;
+}
+
+/*
+ * Deflate one block as a piece of a single zlib stream (raw deflate data ending on a byte boundary)
+ */
+int deflate_task(void *context, size_t block)
+{
+	libr_packing *packing = (libr_packing *) context;
+	size_t start = block*packing->block_size, length = packing_length(packing, block);
+	char *input = &packing->input[start];
+	z_stream zs;
+	int ok;
+	
+	memset(&zs, 0, sizeof(z_stream));
+	if(deflateInit2(&zs, ZLIB_LEVEL(packing->level), Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return false;
+	/* Prime with the data preceding the block so that matches may reach back into it */
+	if(start > 0)
+	{
+		size_t window = (start < DEFLATE_WINDOW ? start : DEFLATE_WINDOW);
+		
+		deflateSetDictionary(&zs, (unsigned char *) &input[-window], window);
+	}
+	zs.next_in = (unsigned char *) input;
+	zs.avail_in = length;
+	zs.next_out = (unsigned char *) &packing->output[packing->lead+block*packing->slot_size];
+	zs.avail_out = packing->slot_size;
+	/* Only the last block closes the stream, the others are flushed to a byte boundary */
+	if(block == packing->blocks-1)
+		ok = (deflate(&zs, Z_FINISH) == Z_STREAM_END);
+	else
+		ok = (deflate(&zs, Z_SYNC_FLUSH) == Z_OK && zs.avail_out != 0);
+	packing->packed[block] = packing->slot_size-zs.avail_out;
+	packing->checksums[block] = adler32(adler32(0L, Z_NULL, 0), (unsigned char *) input, length);
+	deflateEnd(&zs);
+	return ok;
+}
+
+/*
+ * Compress the blocks of a buffer on every processor, each block into its own slot of the
+ * output, and then close the gaps between the compressed blocks
+ */
+libr_intstatus pack_parallel(libr_packing *packing, parallel_task task, size_t trail)
+{
+	size_t block, position;
+	
+	packing->blocks = packing->size/packing->block_size + (packing->size%packing->block_size != 0);
+	packing->slot_size = compressBound(packing->block_size)+16;
+	packing->output = (char *) malloc(packing->lead+packing->blocks*packing->slot_size+trail);
+	packing->packed = (size_t *) malloc(packing->blocks*(sizeof(size_t)+sizeof(uLong))+1);
+	if(packing->output == NULL || packing->packed == NULL)
+	{
+		free(packing->output);
+		free(packing->packed);
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	}
+	packing->checksums = (uLong *) &packing->packed[packing->blocks];
+	if(!parallel_run(packing->blocks, task, packing))
+	{
+		free(packing->output);
+		free(packing->packed);
+		RETURN(LIBR_ERROR_COMPRESS, "Failed to compress resource data");
+	}
+	position = packing->lead;
+	for(block = 0; block < packing->blocks; block++)
+	{
+		memmove(&packing->output[position], &packing->output[packing->lead+block*packing->slot_size], packing->packed[block]);
+		position += packing->packed[block];
+	}
+	RETURN_OK;
+}
+
+/*
+ * Round an offset up to the next multiple of a (power of two) alignment
+ */
+size_t align_offset(size_t offset, size_t alignment)
+{
+	return (offset+alignment-1) & ~(alignment-1);
+}
+
+/*
+ * Compress data as independent blocks preceded by room for the resource header
+ * and a table of where each block is stored (the blocks start on an aligned offset)
+ */
+libr_intstatus pack_blocks(char *buffer, size_t size, size_t block_size, int level, size_t header_size, size_t alignment, char **packed, size_t *data_offset, size_t *packed_size)
+{
+	size_t block, table_size, position = 0;
+	libr_packing packing;
+	libr_intstatus ret;
+	uint64_t entry;
+	
+	memset(&packing, 0, sizeof(libr_packing));
+	packing.input = buffer;
+	packing.size = size;
+	packing.block_size = block_size;
+	packing.level = level;
+	table_size = (size/block_size + (size%block_size != 0) + 1)*sizeof(uint64_t);
+	packing.lead = align_offset(header_size+table_size, alignment);
+	ret = pack_parallel(&packing, compress_task, 0);
+	if(ret.status != LIBR_OK)
+		return ret;
+	/* The header is filled in by the caller, the padding is zeroed */
+	memset(packing.output, 0, packing.lead);
+	/* The final entry marks the end of the last block */
+	for(block = 0; block <= packing.blocks; block++)
+	{
+		entry = position;
+		memcpy(&packing.output[header_size+block*sizeof(uint64_t)], &entry, sizeof(uint64_t));
+		if(block < packing.blocks)
+			position += packing.packed[block];
+	}
+	free(packing.packed);
+	*packed = packing.output;
+	*data_offset = packing.lead;
+	*packed_size = packing.lead+position;
+	RETURN_OK;
+}
+
+/*
+ * Compress data into a single zlib stream by deflating its blocks in parallel
+ */
+libr_intstatus deflate_blocks(char *buffer, size_t size, int level, char **packed, size_t *packed_size)
+{
+	uLong checksum = adler32(0L, Z_NULL, 0);
+	size_t block, position;
+	libr_packing packing;
+	libr_intstatus ret;
+	
+	memset(&packing, 0, sizeof(libr_packing));
+	packing.input = buffer;
+	packing.size = size;
+	packing.block_size = DEFLATE_BLOCK;
+	packing.level = level;
+	packing.lead = 2;
+	ret = pack_parallel(&packing, deflate_task, 4);
+	if(ret.status != LIBR_OK)
+		return ret;
+	/* zlib header: deflate with a 32K window, default compression */
+	packing.output[0] = 0x78;
+	packing.output[1] = 0x9c;
+	position = packing.lead;
+	for(block = 0; block < packing.blocks; block++)
+	{
+		checksum = adler32_combine(checksum, packing.checksums[block], packing_length(&packing, block));
+		position += packing.packed[block];
+	}
+	/* zlib trailer: adler-32 of the uncompressed data (most significant byte first) */
+	packing.output[position++] = (char) (checksum >> 24);
+	packing.output[position++] = (char) (checksum >> 16);
+	packing.output[position++] = (char) (checksum >> 8);
+	packing.output[position++] = (char) checksum;
+	free(packing.packed);
+	*packed = packing.output;
+	*packed_size = position;
+	RETURN_OK;
+}
+
+/*
+ * CRC-32 of the uncompressed data of a resource (zlib takes at most 4GB per call)
+ */
+uint32_t data_digest(char *buffer, size_t size)
+{
+	uLong digest = crc32(0L, Z_NULL, 0);
+	size_t length;
+	
+	while(size > 0)
+	{
+		length = (size > DIGEST_CHUNK ? DIGEST_CHUNK : size);
+		digest = crc32(digest, (unsigned char *) buffer, length);
+		buffer += length;
+		size -= length;
+	}
+	return (uint32_t) digest;
+}
+
+/*
+ * Fill in a version 2 resource header (the rest of the header buffer is left alone)
+ */
+void write_header(char *header, libr_type_t type, unsigned int flags, size_t data_offset, size_t alignment, size_t size, uint32_t digest, uint32_t parameter)
+{
+	uint32_t offset_temp = data_offset, alignment_temp = alignment;
+	uint64_t size_temp = size;
+	
+	memset(header, 0, HEADER_SIZE);
+	memcpy(header, "RES", 3);
+	header[OFFSET_VERSION] = SPEC_VERSION;
+	header[OFFSET_TYPE] = (char) type;
+	header[OFFSET_FLAGS] = (char) flags;
+	memcpy(&header[OFFSET_DATA], &offset_temp, sizeof(uint32_t));
+	memcpy(&header[OFFSET_ALIGNMENT], &alignment_temp, sizeof(uint32_t));
+	memcpy(&header[OFFSET_SIZE], &size_temp, sizeof(uint64_t));
+	memcpy(&header[OFFSET_DIGEST], &digest, sizeof(uint32_t));
+	memcpy(&header[OFFSET_PARAMETER], &parameter, sizeof(uint32_t));
+}
+
+/*
+ * Check for the signature of a format that is already compressed
+ */
+int already_compressed(unsigned char *buffer, size_t size)
+{
+	static const struct {
+		size_t offset;
+		size_t length;
+		const char *magic;
+	} signatures[] = {
+		{0, 8, "\x89PNG\r\n\x1a\n"},       /* PNG */
+		{0, 3, "\xff\xd8\xff"},            /* JPEG */
+		{0, 4, "GIF8"},                    /* GIF */
+		{8, 4, "WEBP"},                    /* WebP (RIFF container) */
+		{0, 2, "\x1f\x8b"},                /* gzip */
+		{0, 4, "PK\x03\x04"},              /* zip (and jar, docx, ...) */
+		{0, 3, "BZh"},                     /* bzip2 */
+		{0, 6, "\xfd" "7zXZ\x00"},         /* xz */
+		{0, 6, "7z\xbc\xaf\x27\x1c"},      /* 7-zip */
+		{0, 4, "\x28\xb5\x2f\xfd"},        /* zstd */
+		{0, 4, "\x04\x22\x4d\x18"},        /* lz4 frame */
+		{0, 4, "OggS"},                    /* Ogg */
+		{0, 4, "fLaC"},                    /* FLAC */
+		{0, 3, "ID3"},                     /* MP3 */
+		{4, 4, "ftyp"},                    /* MP4 and friends */
+		{0, 4, "wOF2"},                    /* WOFF2 */
+	};
+	unsigned int i;
+	
+	for(i = 0; i < sizeof(signatures)/sizeof(signatures[0]); i++)
+	{
+		if(size >= signatures[i].offset+signatures[i].length
+			&& memcmp(&buffer[signatures[i].offset], signatures[i].magic, signatures[i].length) == 0)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Estimate the percentage of space that compression saves by compressing samples
+ * from the start, middle and end of the data with a fast setting
+ */
+unsigned int sample_saving(char *buffer, size_t size)
+{
+	unsigned char packed[AUTO_SAMPLE+AUTO_SAMPLE/8+64];
+	size_t sampled = 0, total = 0, length;
+	unsigned long packed_size;
+	unsigned int i;
+	
+	length = (size < AUTO_SAMPLE ? size : AUTO_SAMPLE);
+	for(i = 0; i < AUTO_SAMPLES; i++)
+	{
+		size_t start = (size-length)*i/(AUTO_SAMPLES-1);
+		
+		packed_size = sizeof(packed);
+		if(compress2(packed, &packed_size, (unsigned char *) &buffer[start], length, AUTO_SAMPLE_LEVEL) != Z_OK)
+			return 0;
+		sampled += length;
+		total += packed_size;
+		/* Small data is covered by a single sample */
+		if(length == size)
+			break;
+	}
+	if(total >= sampled)
+		return 0;
+	return (unsigned int) ((sampled-total)*100/sampled);
+}
+
+/*
+ * Pick the storage type for a LIBR_AUTO resource
+ */
+libr_type_t choose_type(libr_file *file_handle, char *buffer, size_t size)
+{
+	/* Data that is tiny, already compressed or barely compressible is left as-is */
+	if(size < AUTO_MIN_SIZE || already_compressed((unsigned char *) buffer, size))
+		return LIBR_UNCOMPRESSED;
+	if(sample_saving(buffer, size) < file_handle->front.policy.min_saving)
+		return LIBR_UNCOMPRESSED;
+	/* Every build of libr reads zlib, other codecs are only used when the caller asks for them */
+	if(file_handle->front.policy.codec != LIBR_COMPRESSED)
+		return file_handle->front.policy.codec;
+	/* Large data is split so that it unpacks in parallel */
+	if(size >= PARALLEL_MIN)
+		return LIBR_SEEKABLE;
+	return LIBR_COMPRESSED;
+}
+
+/*
+ * Encode data for storage as the requested type, the header is padded out to the (aligned) start
+ * of the stored data and "packed" holds the buffer allocated for the stored data (if any)
+ */
+libr_intstatus encode_data(libr_file *file_handle, char *buffer, size_t size, libr_type_t type, uint32_t digest, size_t alignment,
+	char **header, size_t *data_offset, char **payload, size_t *payload_size, char **packed)
+{
+	const libr_codec *codec = NULL;
+	uint32_t parameter = 0;
+	libr_intstatus ret;
+	
+	*header = NULL;
+	*packed = NULL;
+	*payload = buffer;
+	*payload_size = size;
+	*data_offset = align_offset(HEADER_SIZE, alignment);
+	switch(type)
+	{
+		case LIBR_UNCOMPRESSED:
+			/* Do nothing, just stick the data in */
+			break;
+		case LIBR_SEEKABLE:
+		{
+			size_t packed_size;
+			
+			/* Compress each block on its own (the header and block table lead the data) */
+			parameter = SEEKABLE_BLOCK;
+			ret = pack_blocks(buffer, size, SEEKABLE_BLOCK, file_handle->front.policy.level, HEADER_SIZE, alignment, packed, data_offset, &packed_size);
+			if(ret.status != LIBR_OK)
+				return ret;
+			*header = *packed;
+			*payload = &(*packed)[*data_offset];
+			*payload_size = packed_size-*data_offset;
+		}	break;
+		default:
+		{
+			size_t compressed_size = 0;
+			
+			if((ret = find_codec(type, &codec)).status != LIBR_OK)
+				return ret;
+			/* Compress the data for storage (large zlib resources are spread across all processors) */
+			if(type == LIBR_COMPRESSED && size >= PARALLEL_MIN && parallel_workers(size/DEFLATE_BLOCK) > 1)
+			{
+				if((ret = deflate_blocks(buffer, size, file_handle->front.policy.level, packed, &compressed_size)).status != LIBR_OK)
+					return ret;
+			}
+			else
+			{
+				/* A bound of zero means that the data is too large for the codec */
+				if((compressed_size = codec->bound(size)) == 0)
+					RETURN(LIBR_ERROR_COMPRESS, "Failed to compress resource data");
+				if((*packed = (char *) malloc(compressed_size)) == NULL)
+					RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+				if(!codec->pack(*packed, &compressed_size, buffer, size, file_handle->front.policy.level))
+				{
+					free(*packed);
+					*packed = NULL;
+					RETURN(LIBR_ERROR_COMPRESS, "Failed to compress resource data");
+				}
+			}
+			/* From here on treat the compressed buffer as the data */
+			*payload = *packed;
+			*payload_size = compressed_size;
+		}	break;
+	}
+	/* The header is padded out to the (aligned) start of the data */
+	if(*header == NULL && (*header = (char *) calloc(1, *data_offset)) == NULL)
+	{
+		free(*packed);
+		*packed = NULL;
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	}
+	write_header(*header, type, LIBR_FLAG_DIGEST, *data_offset, alignment, size, digest, parameter);
+	RETURN_OK;
+}
+
+/*
+ * Map the whole ELF binary read-only (shared by every view on the handle)
+ */
+libr_intstatus map_file(libr_file *file_handle)
+{
+	struct stat file_stat;
+	void *address;
+	int fd;
+	
+	if(file_handle->front.filemap.address != NULL)
+		RETURN_OK;
+	/* Map the file that was parsed, even if its path has been replaced since */
+	if((fd = input_descriptor(file_handle)) == ERROR)
+		RETURN(LIBR_ERROR_NOTMAPPABLE, "Resource cannot be mapped: the input file is not open");
+	if(fstat(fd, &file_stat) == ERROR)
+		RETURN(LIBR_ERROR_NOSIZE, "Failed to obtain file size");
+	address = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if(address == MAP_FAILED)
+		RETURN(LIBR_ERROR_MAPFAILED, "Failed to map input file: %m");
+	file_handle->front.filemap.address = (char *) address;
+	file_handle->front.filemap.size = file_stat.st_size;
+	file_handle->front.filemap.views = 0;
+	RETURN_OK;
+}
+
+/*
+ * Release the mapping of the ELF binary (invalidates all views)
+ */
+void unmap_file(libr_file *file_handle)
+{
+	if(file_handle->front.filemap.address == NULL)
+		return;
+	munmap(file_handle->front.filemap.address, file_handle->front.filemap.size);
+	memset(&(file_handle->front.filemap), 0, sizeof(libr_filemap));
+}
+
+/*
+ * Drop a view taken by libr_map that is not handed out
+ */
+static void release_view(libr_file *file_handle)
+{
+	lock_shared(file_handle);
+	if(--file_handle->front.filemap.views == 0)
+		unmap_file(file_handle);
+	unlock_shared(file_handle);
+}
+
+/*
+ * Key identifying the data of a blob (its digest, size, storage type and alignment)
+ */
+void blob_key(char *key, libr_type_t type, uint32_t digest, size_t size, size_t alignment)
+{
+	snprintf(key, BLOB_KEY_LEN, "%08lx:%lx:%d:%lx", (unsigned long) digest, (unsigned long) size, (int) type, (unsigned long) alignment);
+}
+
+/*
+ * Add a resource holding data that can be shared to the index of blobs
+ */
+libr_blob *blob_add(libr_file *file_handle, const char *name, libr_type_t type, size_t size, uint32_t digest, size_t alignment)
+{
+	char key[BLOB_KEY_LEN];
+	libr_blob *blob;
+	
+	if((blob = (libr_blob *) calloc(1, sizeof(libr_blob))) == NULL)
+		return NULL;
+	if((blob->name = strdup(name)) == NULL)
+	{
+		free(blob);
+		return NULL;
+	}
+	blob->type = type;
+	blob->size = size;
+	blob->digest = digest;
+	blob->alignment = alignment;
+	blob_key(key, type, digest, size, alignment);
+	/* When several blobs hold the same data the first one indexed is shared */
+	if(!nameindex_add(&file_handle->front.blobs.names, blob->name, blob)
+		|| !nameindex_add(&file_handle->front.blobs.contents, key, blob))
+	{
+		nameindex_remove(&file_handle->front.blobs.names, blob->name, blob);
+		free(blob->name);
+		free(blob);
+		return NULL;
+	}
+	return blob;
+}
+
+/*
+ * Drop a blob from the index
+ */
+void blob_remove(libr_file *file_handle, libr_blob *blob)
+{
+	char key[BLOB_KEY_LEN];
+	
+	blob_key(key, blob->type, blob->digest, blob->size, blob->alignment);
+	nameindex_remove(&file_handle->front.blobs.contents, key, blob);
+	nameindex_remove(&file_handle->front.blobs.names, blob->name, blob);
+	free(blob->name);
+	free(blob);
+}
+
+/*
+ * Release the index of blobs
+ */
+void blobs_free(libr_file *file_handle)
+{
+	nameindex *names = &file_handle->front.blobs.names;
+	libr_blob *blob;
+	unsigned long i;
+	
+	for(i=0;i<names->size;i++)
+	{
+		if(names->entries[i].name == NULL)
+			continue;
+		blob = (libr_blob *) names->entries[i].value;
+		free(blob->name);
+		free(blob);
+	}
+	nameindex_free(&file_handle->front.blobs.names);
+	nameindex_free(&file_handle->front.blobs.contents);
+	file_handle->front.blobs.ready = false;
+}
+
+/*
+ * Order resource names
+ */
+static int compare_names(const void *a, const void *b)
+{
+	return strcmp(*(char **) a, *(char **) b);
+}
+
+/*
+ * Release the sorted resource names
+ */
+void names_free(libr_file *file_handle)
+{
+	libr_names *sorted = &file_handle->front.sorted;
+	unsigned long i;
+	
+	for(i=0;i<sorted->count;i++)
+		free(sorted->names[i]);
+	free(sorted->names);
+	memset(sorted, 0, sizeof(libr_names));
+}
+
+/*
+ * Sort the names of the resources of a handle (only done once per handle, until it is modified)
+ */
+libr_intstatus names_load(libr_file *file_handle)
+{
+	libr_names *sorted = &file_handle->front.sorted;
+	unsigned long max = 0;
+	libr_iter iter;
+	char **names;
+	
+	if(sorted->ready)
+		RETURN_OK;
+	if(!libr_iter_begin(file_handle, &iter))
+		RETURN(LIBR_ERROR_UNSUPPORTED, "The requested operation is not supported by the backend");
+	while(libr_iter_next(&iter))
+	{
+		if(sorted->count == max)
+		{
+			max = (max == 0 ? 16 : max*2);
+			if((names = (char **) realloc(sorted->names, max*sizeof(char *))) == NULL)
+			{
+				names_free(file_handle);
+				RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+			}
+			sorted->names = names;
+		}
+		if((sorted->names[sorted->count] = strdup(iter.name)) == NULL)
+		{
+			names_free(file_handle);
+			RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+		}
+		sorted->count++;
+	}
+	qsort(sorted->names, sorted->count, sizeof(char *), compare_names);
+	sorted->ready = true;
+	RETURN_OK;
+}
+
+/*
+ * Find the first sorted resource name that is not less than the given prefix
+ */
+unsigned long names_lower_bound(libr_file *file_handle, const char *prefix, size_t length)
+{
+	libr_names *sorted = &file_handle->front.sorted;
+	unsigned long low = 0, high = sorted->count, middle;
+	
+	while(low < high)
+	{
+		middle = low+(high-low)/2;
+		if(strncmp(sorted->names[middle], prefix, length) < 0)
+			low = middle+1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+/*
+ * Index the blobs of a handle and count their aliases (only done once per handle)
+ */
+libr_intstatus blobs_load(libr_file *file_handle)
+{
+	libr_section *scn = NULL;
+	libr_header info;
+	libr_blob *blob;
+	char *target;
+	
+	if(file_handle->front.blobs.ready)
+		RETURN_OK;
+	if(!nameindex_init(&file_handle->front.blobs.names, 0, false) || !nameindex_init(&file_handle->front.blobs.contents, 0, true))
+	{
+		blobs_free(file_handle);
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	}
+	/* Only resources that record a digest can be matched against new data */
+	while((scn = next_section(file_handle, scn)) != NULL)
+	{
+		if(read_header(file_handle, scn, &info).status != LIBR_OK || (info.flags & (LIBR_FLAG_DIGEST|LIBR_FLAG_ALIAS)) != LIBR_FLAG_DIGEST)
+			continue;
+		if(blob_add(file_handle, section_name(file_handle, scn), info.type, info.size, info.digest, info.alignment) == NULL)
+		{
+			blobs_free(file_handle);
+			RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+		}
+	}
+	while((scn = next_section(file_handle, scn)) != NULL)
+	{
+		if(read_header(file_handle, scn, &info).status != LIBR_OK || !(info.flags & LIBR_FLAG_ALIAS))
+			continue;
+		if(alias_target(file_handle, scn, &info, &target).status != LIBR_OK)
+			continue;
+		if((blob = (libr_blob *) nameindex_find(&file_handle->front.blobs.names, target)) != NULL)
+			blob->refs++;
+		free(target);
+	}
+	file_handle->front.blobs.ready = true;
+	RETURN_OK;
+}
+
+/*
+ * Compare part of the stored data of a section with a buffer (a piece at a time)
+ */
+int stored_equal(libr_file *file_handle, libr_section *scn, size_t offset, const char *buffer, size_t size)
+{
+	char piece[COMPARE_PIECE];
+	size_t length;
+	
+	while(size > 0)
+	{
+		length = (size < sizeof(piece) ? size : sizeof(piece));
+		if(read_stored(file_handle, scn, offset, piece, length) != length || memcmp(piece, buffer, length) != 0)
+			return false;
+		offset += length;
+		buffer += length;
+		size -= length;
+	}
+	return true;
+}
+
+/*
+ * Find a blob already holding exactly the given data, stored the same way as the encoded
+ * header and payload (the stored bytes are compared, nothing is uncompressed)
+ */
+libr_blob *blob_match(libr_file *file_handle, libr_type_t type, size_t size, uint32_t digest, size_t alignment,
+	char *header, size_t data_offset, char *payload, size_t payload_size)
+{
+	char key[BLOB_KEY_LEN];
+	libr_section *scn;
+	libr_header info;
+	libr_blob *blob;
+	
+	blob_key(key, type, digest, size, alignment);
+	if((blob = (libr_blob *) nameindex_find(&file_handle->front.blobs.contents, key)) == NULL)
+		return NULL;
+	/* The digest only picks the candidate, the data itself has to match (block table and all) */
+	if(find_section(file_handle, blob->name, &scn).status != LIBR_OK || read_header(file_handle, scn, &info).status != LIBR_OK)
+		return NULL;
+	if(info.data_offset != data_offset || info.stored_size != payload_size)
+		return NULL;
+	if(!stored_equal(file_handle, scn, HEADER_SIZE, &header[HEADER_SIZE], data_offset-HEADER_SIZE)
+		|| !stored_equal(file_handle, scn, data_offset, payload, payload_size))
+		return NULL;
+	return blob;
+}
+
+/*
+ * Replace the data of a section with a resource header followed by the stored data
+ */
+libr_intstatus store_data(libr_file *file_handle, libr_section *scn, libr_data *data, char *header, size_t header_size, char *payload, size_t payload_size)
+{
+	libr_intstatus ret;
+	
+	/* Store the resource header data */
+	ret = set_data(file_handle, scn, data, 0, header, header_size);
+	if(ret.status != LIBR_OK)
+	{
+		free_data(file_handle, scn, data);
+		return ret;
+	}
+	/* Create a data segment to store the post-header data
+	 * NOTE: For existing files the data of the section is represented as a continuous stream
+	 * (so calling elf_getdata now WILL NOT return the post-header data)
+	 */
+	if((data = new_data(file_handle, scn)) == NULL)
+		RETURN(LIBR_ERROR_NEWDATA, "Failed to create data for section");
+	/* Store the actual user data to the section */
+	return set_data(file_handle, scn, data, header_size, payload, payload_size);
+}
+
+/*
+ * Add a resource header followed by the stored data to the archive
+ */
+libr_intstatus archive_store(libr_file *file_handle, char *name, char *header, size_t header_size, char *payload, size_t payload_size, size_t alignment)
+{
+	char *resource;
+	
+	if((resource = (char *) malloc(header_size+payload_size)) == NULL)
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	memcpy(resource, header, header_size);
+	memcpy(&resource[header_size], payload, payload_size);
+	return archive_put(file_handle, name, resource, header_size+payload_size, alignment);
+}
+
+/*
+ * Encode one of the resources collected for linking (see libr_open_embed)
+ */
+int embed_task(void *context, size_t index)
+{
+	libr_packed *entry = archive_entry((libr_file *) context, index);
+	char *header, *payload, *packed, *resource;
+	size_t data_offset, payload_size;
+	libr_type_t type = entry->type;
+	
+	if(!entry->raw)
+		return true;
+	if(type == LIBR_AUTO)
+		type = choose_type((libr_file *) context, entry->data, entry->length);
+	if(encode_data((libr_file *) context, entry->data, entry->length, type, data_digest(entry->data, entry->length), entry->alignment,
+		&header, &data_offset, &payload, &payload_size, &packed).status != LIBR_OK)
+		return false;
+	if((resource = (char *) malloc(data_offset+payload_size)) != NULL)
+	{
+		memcpy(resource, header, data_offset);
+		memcpy(&resource[data_offset], payload, payload_size);
+	}
+	if(header != packed)
+		free(header);
+	free(packed);
+	if(resource == NULL)
+		return false;
+	free(entry->data);
+	entry->data = resource;
+	entry->length = data_offset+payload_size;
+	entry->raw = false;
+	return true;
+}
+
+/*
+ * Encode the resources collected for linking, each resource is encoded on its own processor
+ */
+libr_intstatus embed_encode(libr_file *file_handle)
+{
+	if(!parallel_run(file_handle->front.archive.count, embed_task, file_handle))
+		RETURN(LIBR_ERROR_COMPRESS, "Failed to compress resource data");
+	RETURN_OK;
+}
+
+/*
+ * Store a resource as an alias of a blob (the name of the blob takes the place of the data)
+ */
+libr_intstatus write_alias(libr_file *file_handle, libr_section *scn, libr_data *data, libr_blob *blob)
+{
+	char header[HEADER_SIZE];
+	
+	write_header(header, blob->type, LIBR_FLAG_DIGEST|LIBR_FLAG_ALIAS, HEADER_SIZE, 1, blob->size, blob->digest, 0);
+	return store_data(file_handle, scn, data, header, HEADER_SIZE, blob->name, strlen(blob->name));
+}
+
+/*
+ * Copy the stored data of a blob (header and all) to another section
+ */
+libr_intstatus copy_blob(libr_file *file_handle, libr_section *scn, libr_header *info, libr_section *heir)
+{
+	size_t length = section_size(file_handle, scn);
+	libr_data *data = NULL;
+	libr_intstatus ret;
+	char *stored;
+	
+	if(info->alignment > 1 && (ret = set_alignment(file_handle, heir, info->alignment)).status != LIBR_OK)
+		return ret;
+	if((stored = (char *) malloc(length)) == NULL)
+		RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	if(read_section(file_handle, scn, 0, stored, length) != length)
+	{
+		free(stored);
+		RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+	}
+	if((data = get_data(file_handle, heir)) == NULL)
+	{
+		free(stored);
+		RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+	}
+	ret = store_data(file_handle, heir, data, stored, info->data_offset, &stored[info->data_offset], length-info->data_offset);
+	free(stored);
+	return ret;
+}
+
+/*
+ * Stop a resource from taking part in shared data before it is replaced or removed:
+ * an alias drops its reference, a blob still in use moves its data to the first of
+ * its aliases and the remaining aliases are pointed at that one
+ */
+libr_intstatus release_resource(libr_file *file_handle, libr_section *scn, char *resource_name)
+{
+	libr_section *alias = NULL, *heir = NULL;
+	libr_header info, alias_info;
+	libr_data *data = NULL;
+	libr_intstatus ret;
+	libr_blob *blob;
+	char *target;
+	
+	ret = blobs_load(file_handle);
+	if(ret.status != LIBR_OK)
+		return ret;
+	if(read_header(file_handle, scn, &info).status != LIBR_OK)
+		RETURN_OK; /* not a resource, nothing is shared */
+	if(info.flags & LIBR_FLAG_ALIAS)
+	{
+		ret = alias_target(file_handle, scn, &info, &target);
+		if(ret.status != LIBR_OK)
+			return ret;
+		blob = (libr_blob *) nameindex_find(&file_handle->front.blobs.names, target);
+		if(blob != NULL && blob->refs > 0)
+			blob->refs--;
+		free(target);
+		RETURN_OK;
+	}
+	if((blob = (libr_blob *) nameindex_find(&file_handle->front.blobs.names, resource_name)) == NULL)
+		RETURN_OK;
+	while(blob->refs > 0 && (alias = next_section(file_handle, alias)) != NULL)
+	{
+		if(read_header(file_handle, alias, &alias_info).status != LIBR_OK || !(alias_info.flags & LIBR_FLAG_ALIAS))
+			continue;
+		if(alias_target(file_handle, alias, &alias_info, &target).status != LIBR_OK)
+			continue;
+		if(strcmp(target, resource_name) != 0)
+		{
+			free(target);
+			continue;
+		}
+		free(target);
+		if(heir == NULL)
+		{
+			char *heir_name;
+			
+			/* The first alias inherits the data (and the place of the blob in the index) */
+			heir = alias;
+			ret = copy_blob(file_handle, scn, &info, heir);
+			if(ret.status != LIBR_OK)
+				return ret;
+			if((heir_name = strdup(section_name(file_handle, heir))) == NULL)
+				RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+			nameindex_remove(&file_handle->front.blobs.names, blob->name, blob);
+			free(blob->name);
+			blob->name = heir_name;
+			if(!nameindex_add(&file_handle->front.blobs.names, blob->name, blob))
+			{
+				blob_remove(file_handle, blob);
+				RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+			}
+		}
+		else
+		{
+			if((data = get_data(file_handle, alias)) == NULL)
+				RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+			ret = write_alias(file_handle, alias, data, blob);
+			if(ret.status != LIBR_OK)
+				return ret;
+		}
+		blob->refs--;
+	}
+	/* Without an heir nothing refers to the data any more */
+	if(heir == NULL)
+		blob_remove(file_handle, blob);
+	RETURN_OK;
+}
+
+#ifdef HAVE_DL_ITERATE_PHDR
+
+/* Loaded image being looked for with dl_iterate_phdr */
+typedef struct {
+	const char *name;    /* NULL for the main program */
+	uintptr_t base;
+	int found;
+	int failed;
+	libr_image *image;
+} image_search;
+
+/*
+ * Remember an archive that was loaded with an image
+ */
+int image_add(libr_image *image, const char *archive, size_t size)
+{
+	const char **archives;
+	size_t *sizes;
+	
+	if((archives = (const char **) realloc(image->archives, (image->count+1)*sizeof(char *))) == NULL)
+		return false;
+	image->archives = archives;
+	if((sizes = (size_t *) realloc(image->sizes, (image->count+1)*sizeof(size_t))) == NULL)
+		return false;
+	image->sizes = sizes;
+	image->archives[image->count] = archive;
+	image->sizes[image->count] = size;
+	image->count++;
+	return true;
+}
+
+/*
+ * Collect the archives pointed at by the notes of a loaded image
+ */
+int image_notes(struct dl_phdr_info *info, libr_image *image)
+{
+	size_t name_size = strlen(ARCHIVE_NOTE_NAME)+1;
+	const char *note, *end, *desc;
+	ElfW(Nhdr) header;
+	uintptr_t size;
+	intptr_t offset;
+	size_t align;
+	int i;
+	
+	for(i=0;i<info->dlpi_phnum;i++)
+	{
+		if(info->dlpi_phdr[i].p_type != PT_NOTE)
+			continue;
+		note = (const char *) (info->dlpi_addr+info->dlpi_phdr[i].p_vaddr);
+		end = note+info->dlpi_phdr[i].p_memsz;
+		align = (info->dlpi_phdr[i].p_align == 8 ? 8 : 4);
+		while((size_t) (end-note) >= sizeof(header))
+		{
+			memcpy(&header, note, sizeof(header));
+			desc = note+sizeof(header)+((header.n_namesz+align-1) & ~(align-1));
+			if(header.n_descsz > (size_t) (end-note) || desc > end-header.n_descsz)
+				break;
+			if(header.n_type == ARCHIVE_NOTE_TYPE && header.n_namesz == name_size && header.n_descsz == ARCHIVE_NOTE_SIZE
+				&& memcmp(note+sizeof(header), ARCHIVE_NOTE_NAME, name_size) == 0)
+			{
+				memcpy(&offset, desc, sizeof(intptr_t));
+				memcpy(&size, &desc[sizeof(intptr_t)], sizeof(uintptr_t));
+				if(!image_add(image, desc+offset, size))
+					return false;
+			}
+			note = desc+((header.n_descsz+align-1) & ~(align-1));
+		}
+	}
+	return true;
+}
+
+/*
+ * Check each image reported by dl_iterate_phdr until the one being looked for is found
+ */
+int image_found(struct dl_phdr_info *info, size_t info_size, void *data)
+{
+	image_search *search = (image_search *) data;
+	
+	/* The main program is reported first */
+	if(search->name != NULL && (info->dlpi_addr != search->base || strcmp(info->dlpi_name, search->name) != 0))
+		return 0;
+	search->found = true;
+	search->failed = !image_notes(info, search->image);
+	return 1;
+}
+
+/*
+ * Open a handle to the archives loaded with an image
+ */
+libr_file *open_image(const char *name, uintptr_t base)
+{
+	libr_file *file_handle;
+	image_search search;
+	
+	if((file_handle = (libr_file *) calloc(1, sizeof(libr_file))) == NULL)
+	{
+		SET_ERROR(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+		return NULL;
+	}
+	file_handle->access = LIBR_READ;
+	file_handle->front.policy.min_saving = DEFAULT_MIN_SAVING;
+	file_handle->front.policy.level = CODEC_DEFAULT_LEVEL;
+	file_handle->front.policy.codec = LIBR_COMPRESSED;
+	file_handle->front.policy.alignment = 1;
+	file_handle->front.image.loaded = true;
+	memset(&search, 0, sizeof(search));
+	search.name = name;
+	search.base = base;
+	search.image = &file_handle->front.image;
+	dl_iterate_phdr(image_found, &search);
+	if(!search.found || search.failed || file_handle->front.image.count == 0)
+	{
+		if(search.failed)
+			SET_ERROR(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+		else if(!search.found)
+			SET_ERROR(LIBR_ERROR_OPENFAILED, "Failed to open input file");
+		else
+			SET_ERROR(LIBR_ERROR_NOSECTION, "ELF resource section not found");
+		free(file_handle->front.image.archives);
+		free(file_handle->front.image.sizes);
+		free(file_handle);
+		return NULL;
+	}
+	/* Cleanup handles automatically when libr exits memory */
+	register_handle_cleanup(file_handle);
+	SET_ERROR(LIBR_OK, NULL);
+	return file_handle;
+}
+
+#endif /* HAVE_DL_ITERATE_PHDR */
+
+/*
+ * Stage the following changes to the ELF binary handle until libr_commit is called
+ */
+EXPORT_FN int libr_begin(libr_file *file_handle)
+{
+	/* Ensure valid inputs */
+	if(file_handle == NULL)
+		PUBLIC_RETURN(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
+	if(file_handle->access != LIBR_READ_WRITE)
+		PUBLIC_RETURN(LIBR_ERROR_NOPERM, "Open handle with LIBR_READ_WRITE access");
+	/* Sources for linking are only written by libr_commit and libr_close */
+	if(file_handle->front.embed.enabled)
+		PUBLIC_RETURN(LIBR_OK, NULL);
+	if(begin_update(file_handle).status != LIBR_OK)
+		return false; /* error already set */
+	return true;
+}
+
+/*
+ * Remove a resourcefrom the ELF binary handle
+ */ 
+EXPORT_FN int libr_clear(libr_file *file_handle, char *resource_name)
+{
+	libr_packed *entry = NULL;
+	libr_data *data = NULL;
+	libr_section *scn = NULL;
+	libr_intstatus ret;
+	
+	/* Ensure valid inputs */
+	if(file_handle == NULL || resource_name == NULL)
+		PUBLIC_RETURN(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
+	if(file_handle->access != LIBR_READ_WRITE)
+		PUBLIC_RETURN(LIBR_ERROR_NOPERM, "Open handle with LIBR_READ_WRITE access");
+	/* Find the section containing the icon (sources for linking only have archived resources) */
+	if(file_handle->front.embed.enabled)
+		ret = SET_ERROR(LIBR_ERROR_NOSECTION, "ELF resource section not found");
+	else
+		ret = find_section(file_handle, resource_name, &scn);
+	if(ret.status == LIBR_ERROR_NOSECTION)
+	{
+		/* Archived resources are dropped from the archive (written out with the handle) */
+		if(archive_find(file_handle, resource_name, &entry).status != LIBR_OK)
+			return false; /* error already set */
+		toc_changed(file_handle);
+		names_free(file_handle);
+		archive_remove(file_handle, entry);
+		PUBLIC_RETURN(LIBR_OK, NULL);
+	}
+	if(ret.status != LIBR_OK)
+		return false; /* error already set */
+	toc_changed(file_handle);
+	names_free(file_handle);
+	/* Aliases sharing the data of the resource keep it */
+	if(release_resource(file_handle, scn, resource_name).status != LIBR_OK)
+		return false; /* error already set */
+	/* Get the section data (interested in header) */
+	if((data = get_data(file_handle, scn)) == NULL)
+		PUBLIC_RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+	/* Confirm that this resource is libr-compatible */
+	if(section_ok(scn, data).status != LIBR_OK)
+	{
+		free_data(file_handle, scn, data);
+		return false; /* error already set */
+	}
+	/* Clear the data resource */
+	ret = set_data(file_handle, scn, data, 0, NULL, 0);
+	free_data(file_handle, scn, data);
+	if(ret.status != LIBR_OK)
+		return false; /* error already set */
+	/* Remove the section */
+	if(remove_section(file_handle, scn).status != LIBR_OK)
+		return false; /* error already set */
+	return true;
+}
+
+/*
+ * Drop a reference to a shared handle (returns true while other references remain)
+ */
+static int release_handle(libr_file *file_handle)
+{
+	libr_file **link;
+	
+	if(!file_handle->front.shared.interned)
+		return false;
+	pthread_mutex_lock(&shared_lock);
+	if(--file_handle->front.shared.refs > 0)
+	{
+		pthread_mutex_unlock(&shared_lock);
+		return true;
+	}
+	for(link = &shared_handles; *link != NULL; link = &(*link)->front.shared.next)
+	{
+		if(*link == file_handle)
+		{
+			*link = file_handle->front.shared.next;
+			break;
+		}
+	}
+	file_handle->front.shared.interned = false;
+	pthread_mutex_unlock(&shared_lock);
+	return false;
+}
+
+/*
+ * Close the specified ELF binary handle
+ */
+EXPORT_FN void libr_close(libr_file *file_handle)
+{
+	/* Handles shared by several libr_open calls are closed with the last reference */
+	if(release_handle(file_handle))
+	{
+		SET_ERROR(LIBR_OK, NULL);
+		return;
+	}
+	unregister_handle_cleanup(file_handle);
+	libr_close_internal(file_handle);
+}
+/* Only called directly by cleanup routine, all other calls should be through libr_close */
+libr_intstatus libr_close_internal(libr_file *file_handle)
+{
+	char message[ERROR_MESSAGE_LEN];
+	libr_intstatus ret;
+	
+	unmap_file(file_handle);
+	ret = SET_ERROR(LIBR_OK, NULL);
+	/* Sources for linking are written in place of a binary */
+	if(file_handle->front.embed.enabled)
+	{
+		if((ret = embed_encode(file_handle)).status == LIBR_OK)
+			ret = embed_write(file_handle);
+		free(file_handle->front.embed.output);
+	}
+	else
+	{
+		if(file_handle->access == LIBR_READ_WRITE && (ret = archive_flush(file_handle)).status == LIBR_OK)
+			ret = toc_flush(file_handle);
+		/* Loaded images have no file behind them */
+		if(file_handle->front.image.loaded)
+		{
+			free(file_handle->front.image.archives);
+			free(file_handle->front.image.sizes);
+		}
+		else
+			write_output(file_handle);
+	}
+	/* The rest of the cleanup may report success, keep the error of a failed write for the caller */
+	if(ret.status != LIBR_OK)
+		snprintf(message, sizeof(message), "%s", (ret.message != NULL ? ret.message : ""));
+	toc_free(file_handle);
+	names_free(file_handle);
+	archive_free(file_handle);
+	blobs_free(file_handle);
+	free(file_handle->filename);
+	free(file_handle);
+	if(ret.status != LIBR_OK)
+		return SET_ERROR(ret.status, "%s", message);
+	RETURN_OK;
+}
+
+/*
+ * Write all of the changes staged since libr_begin was called
+ */
+EXPORT_FN int libr_commit(libr_file *file_handle)
+{
+	/* Ensure valid inputs */
+	if(file_handle == NULL)
+		PUBLIC_RETURN(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
+	if(file_handle->access != LIBR_READ_WRITE)
+		PUBLIC_RETURN(LIBR_ERROR_NOPERM, "Open handle with LIBR_READ_WRITE access");
+	if(file_handle->front.embed.enabled)
+	{
+		/* Closing the handle must not try again and leave a partial source behind */
+		if(embed_encode(file_handle).status != LIBR_OK || embed_write(file_handle).status != LIBR_OK)
+		{
+			embed_discard(file_handle);
+			return false; /* error already set */
+		}
+		return true;
+	}
+	if(archive_flush(file_handle).status != LIBR_OK || toc_flush(file_handle).status != LIBR_OK)
+		return false; /* error already set */
+	if(commit_update(file_handle).status != LIBR_OK)
+		return false; /* error already set */
+	return true;
+}
+
+/*
+ * Drop the resources collected for linking that have not been written yet
+ */
+EXPORT_FN int libr_discard(libr_file *file_handle)
+{
+	if(file_handle == NULL)
+		PUBLIC_RETURN(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
+	/* Only sources for linking hold every change until they are written */
+	if(!file_handle->front.embed.enabled)
+		PUBLIC_RETURN(LIBR_ERROR_UNSUPPORTED, "The requested operation is not supported by the backend");
+	embed_discard(file_handle);
+	PUBLIC_RETURN(LIBR_OK, NULL);
+}
+
+/*
+ * Return the last error message for the active thread
+ */
+EXPORT_FN char *libr_errmsg(void)
+{
+	return thread_status.message;
+}
+
+/*
+ * Return the last error code for the active thread (or LIBR_OK for no error)
+ */
+EXPORT_FN libr_status libr_errno(void)
+{
+	return thread_status.status;
+}
+
+/*
+ * Call back for every resource whose name matches a wildcard pattern (in sorted order)
+ */
+EXPORT_FN int libr_glob(libr_file *file_handle, const char *pattern, libr_glob_callback callback, void *data)
+{
+	libr_intstatus ret;
+	libr_names *sorted;
+	size_t prefix;
+	unsigned long i;
+	
+	if(file_handle == NULL || pattern == NULL || callback == NULL)
+		PUBLIC_RETURN(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
+	lock_shared(file_handle);
+	ret = names_load(file_handle);
+	unlock_shared(file_handle);
+	if(ret.status != LIBR_OK)
+		return false; /* error already set */
+	sorted = &file_handle->front.sorted;
+	/* Only the names sharing the part of the pattern before the first wildcard can match */
+	prefix = strcspn(pattern, "*?[\\");
+	for(i=names_lower_bound(file_handle, pattern, prefix);i<sorted->count;i++)
+	{
+		if(strncmp(sorted->names[i], pattern, prefix) != 0)
+			break;
+		if(fnmatch(pattern, sorted->names[i], FNM_PATHNAME) == 0 && !callback(file_handle, sorted->names[i], data))
+			break;
+	}
+	PUBLIC_RETURN(LIBR_OK, NULL);
+}
+
+/*
+ * Prepare to walk the libr-compatible resources of a handle
+ */
+EXPORT_FN int libr_iter_begin(libr_file *file_handle, libr_iter *iter)
+{
+	if(file_handle == NULL || iter == NULL)
+		PUBLIC_RETURN(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
+	/* Sources for linking are only written to */
+	if(file_handle->front.embed.enabled)
+		PUBLIC_RETURN(LIBR_ERROR_UNSUPPORTED, "The requested operation is not supported by the backend");
+	memset(iter, 0, sizeof(libr_iter));
+	iter->handle = file_handle;
+	/* Listing the table of contents saves probing every section */
+	iter->indexed = toc_ready(file_handle);
+	PUBLIC_RETURN(LIBR_OK, NULL);
+}
+
+/*
+ * Advance to the next libr-compatible resource (one pass over the sections)
+ */
+EXPORT_FN int libr_iter_next(libr_iter *iter)
+{
+	libr_section *scn, *data_scn;
+	libr_tocentry *listed;
+	libr_packed *entry;
+	libr_header info;
+	
+	if(iter == NULL)
+		PUBLIC_RETURN(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
+	if(iter->handle == NULL)
+		PUBLIC_RETURN(LIBR_ERROR_NOSECTION, "No more libr resources");
+	if(iter->indexed)
+	{
+		/* The table of contents lists the resources in the order they were probed when it was written */
+		if((listed = toc_entry(iter->handle, iter->entry)) != NULL)
+		{
+			iter->entry++;
+			iter->name = listed->name;
+			iter->size = listed->size;
+			iter->stored_size = listed->stored_size;
+			iter->type = listed->type;
+			PUBLIC_RETURN(LIBR_OK, NULL);
+		}
+		memset(iter, 0, sizeof(libr_iter));
+		PUBLIC_RETURN(LIBR_ERROR_NOSECTION, "No more libr resources");
+	}
+	scn = (libr_section *) iter->section;
+	/* NOTE: Loaded images only hold archived resources */
+	while(iter->entry == 0 && !iter->handle->front.image.loaded && (scn = next_section(iter->handle, scn)) != NULL)
+	{
+		/* Only the header is needed to know whether this is a resource */
+		if(read_header(iter->handle, scn, &info).status != LIBR_OK)
+			continue;
+		/* Aliases describe the data they share */
+		data_scn = scn;
+		if((info.flags & LIBR_FLAG_ALIAS) && resolve_alias(iter->handle, &data_scn, &info).status != LIBR_OK)
+			continue;
+		iter->section = scn;
+		iter->name = section_name(iter->handle, scn);
+		iter->size = info.size;
+		iter->stored_size = info.stored_size;
+		iter->type = info.type;
+		PUBLIC_RETURN(LIBR_OK, NULL);
+	}
+	/* Then the resources of the archive (including the ones that have not been written out yet) */
+	if(iter->entry == 0)
+	{
+		iter->section = NULL;
+		iter->entry = 1;
+		if(archive_load(iter->handle).status != LIBR_OK)
+			iter->entry = (unsigned long) -1;
+	}
+	while((entry = archive_entry(iter->handle, iter->entry-1)) != NULL)
+	{
+		iter->entry++;
+		if(entry->data != NULL)
+		{
+			/* Resources waiting to be written hold their header in memory */
+			if(parse_header(entry->data, entry->length, entry->length, &info).status != LIBR_OK)
+				continue;
+		}
+		else if(find_packed(iter->handle, entry->name, &scn, &info).status != LIBR_OK)
+			continue;
+		iter->name = entry->name;
+		iter->size = info.size;
+		iter->stored_size = info.stored_size;
+		iter->type = info.type;
+		PUBLIC_RETURN(LIBR_OK, NULL);
+	}
+	/* Reached the end of the resources */
+	memset(iter, 0, sizeof(libr_iter));
+	PUBLIC_RETURN(LIBR_ERROR_NOSECTION, "No more libr resources");
+}
+
+/*
+ * Return the name of a libr-compatible resource
+ */
+EXPORT_FN char *libr_list(libr_file *file_handle, unsigned int resourceid)
+{
+	unsigned int i = 0;
+	libr_iter iter;
+	
+	if(!libr_iter_begin(file_handle, &iter))
+		return NULL; /* error already set */
+	while(libr_iter_next(&iter))
+	{
+		if(i++ == resourceid)
+			return strdup(iter.name);
+	}
+	return NULL;
+}
+
+/*
+ * Allocate a buffer containing the data of a resource
+ */
+EXPORT_FN char *libr_malloc(libr_file *file_handle, char *resource_name, size_t *size)
+{
+	char *buffer = NULL;
+	size_t size_local;
+	
+	if(size == NULL)
+		size = &size_local;
+	if(!libr_size(file_handle, resource_name, size))
+		return NULL; /* error already set */
+	buffer = (char *) malloc(*size);
+	if(!libr_read(file_handle, resource_name, buffer))
+	{
+		free(buffer);
+		return NULL; /* error already set */ 
+	}
+	return buffer;
+}
+
+/*
+ * Obtain a zero-copy view of the data of an uncompressed resource
+ */
+EXPORT_FN const char *libr_map(libr_file *file_handle, char *resource_name, size_t *size)
+{
+	libr_section *scn = NULL;
+	libr_intstatus ret;
+	libr_header info;
+	size_t length;
+	char *view;
+	off_t offset;
+	
+	/* Ensure valid inputs */
+	if(file_handle == NULL || resource_name == NULL)
+	{
+		SET_ERROR(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
+		return NULL;
+	}
+	/* Sections of a writable handle may not match the file on the disk */
+	if(file_handle->access != LIBR_READ)
+	{
+		SET_ERROR(LIBR_ERROR_NOTMAPPABLE, "Resource cannot be mapped: open handle with LIBR_READ access");
+		return NULL;
+	}
+	/* Find the section containing the resource */
+	if(find_resource(file_handle, resource_name, &scn, &info).status != LIBR_OK)
+		return NULL; /* error already set */
+	if(file_handle->front.image.loaded)
+	{
+		/* The resources of a loaded image are viewed where they were loaded */
+		length = info.data_offset+info.stored_size-info.base;
+		view = (char *) (uintptr_t) info.base;
+		if(parse_header(view, length, length, &info).status != LIBR_OK)
+			return NULL; /* error already set */
+		if(info.type != LIBR_UNCOMPRESSED)
+		{
+			SET_ERROR(LIBR_ERROR_NOTMAPPABLE, "Resource cannot be mapped: data is not stored uncompressed");
+			return NULL;
+		}
+		if(size != NULL)
+			*size = info.size;
+		SET_ERROR(LIBR_OK, NULL);
+		return &view[info.data_offset];
+	}
+	offset = section_offset(file_handle, scn);
+	length = section_size(file_handle, scn);
+	/* Archived resources are viewed on their own */
+	if(info.base != 0 && offset != ERROR)
+	{
+		offset += info.base;
+		length = info.data_offset+info.stored_size-info.base;
+	}
+	if(offset == ERROR)
+	{
+		SET_ERROR(LIBR_ERROR_NOTMAPPABLE, "Resource cannot be mapped: section has no file data");
+		return NULL;
+	}
+	/* The view is counted right away so that no other user of a shared handle unmaps the file */
+	lock_shared(file_handle);
+	if((ret = map_file(file_handle)).status == LIBR_OK)
+		file_handle->front.filemap.views++;
+	unlock_shared(file_handle);
+	if(ret.status != LIBR_OK)
+		return NULL; /* error already set */
+	if(offset+length > file_handle->front.filemap.size)
+	{
+		release_view(file_handle);
+		SET_ERROR(LIBR_ERROR_SIZEMISMATCH, "Section's data size does not make sense");
+		return NULL;
+	}
+	view = file_handle->front.filemap.address+offset;
+	/* Confirm that this resource is libr-compatible and stored as-is */
+	if(parse_header(view, length, length, &info).status != LIBR_OK)
+	{
+		release_view(file_handle);
+		return NULL; /* error already set */
+	}
+	if(info.type != LIBR_UNCOMPRESSED)
+	{
+		release_view(file_handle);
+		SET_ERROR(LIBR_ERROR_NOTMAPPABLE, "Resource cannot be mapped: data is not stored uncompressed");
+		return NULL;
+	}
+	if(size != NULL)
+		*size = info.size;
+	SET_ERROR(LIBR_OK, NULL);
+	return &view[info.data_offset];
+}
+
+/*
+ * Check the zlib version and set up the backend (once per process)
+ */
+static void initialize_library(void)
+{
+	if(strncmp(zlibVersion(), ZLIB_VERSION, 1) != 0)
+		return;
+	initialize_backend();
+	library_ready = true;
+}
+
+/*
+ * Find the read-only handle of a file (and version of it) and take a reference to it
+ */
+static libr_file *find_shared_handle(struct stat *info)
+{
+	libr_file *file_handle;
+	
+	for(file_handle = shared_handles; file_handle != NULL; file_handle = file_handle->front.shared.next)
+	{
+		if(file_handle->front.shared.device == info->st_dev && file_handle->front.shared.inode == info->st_ino
+			&& file_handle->front.shared.mtime == info->st_mtime && file_handle->front.shared.mtime_nsec == stat_mtime_nsec(info)
+			&& file_handle->front.shared.size == info->st_size)
+		{
+			file_handle->front.shared.refs++;
+			return file_handle;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Share a newly opened read-only handle with later libr_open calls on the same file
+ */
+static void intern_handle(libr_file *file_handle, struct stat *info)
+{
+	file_handle->front.shared.interned = true;
+	file_handle->front.shared.device = info->st_dev;
+	file_handle->front.shared.inode = info->st_ino;
+	file_handle->front.shared.mtime = info->st_mtime;
+	file_handle->front.shared.mtime_nsec = stat_mtime_nsec(info);
+	file_handle->front.shared.size = info->st_size;
+	file_handle->front.shared.refs = 1;
+	file_handle->front.shared.next = shared_handles;
+	shared_handles = file_handle;
+}
+
+/*
+ * Open the specified ELF binary (caller if filename is NULL)
+ */
+EXPORT_FN libr_file *libr_open(char *filename, libr_access_t access)
+{
+	libr_file *file_handle = NULL, *shared_handle;
+	struct stat info;
+	int shared, fd;
+	
+	/* Threads opening their first handles at the same time wait for a single setup */
+	if(pthread_once(&library_once, initialize_library) != 0 || !library_ready)
+	{
+		SET_ERROR(LIBR_ERROR_ZLIBINIT, "zlib library initialization failed");
+		return NULL;
+	}
+	
+	if(filename == NULL)
+		filename = getself();
+	/* Reading the same file again shares the sections, indexes and mapping already loaded */
+	shared = (access == LIBR_READ_SHARED);
+	if(shared && stat(filename, &info) == 0)
+	{
+		pthread_mutex_lock(&shared_lock);
+		shared_handle = find_shared_handle(&info);
+		pthread_mutex_unlock(&shared_lock);
+		if(shared_handle != NULL)
+		{
+			SET_ERROR(LIBR_OK, NULL);
+			return shared_handle;
+		}
+	}
+	/* The backends only know about reading and writing */
+	if(access == LIBR_READ_SHARED)
+		access = LIBR_READ;
+	file_handle = (libr_file *) malloc(sizeof(libr_file));
+	memset(file_handle, 0, sizeof(libr_file));
+	file_handle->front.policy.min_saving = DEFAULT_MIN_SAVING;
+	file_handle->front.policy.level = CODEC_DEFAULT_LEVEL;
+	file_handle->front.policy.codec = LIBR_COMPRESSED;
+	file_handle->front.policy.alignment = 1;
+	/* The handle keeps its own copy of the name, it may outlive the caller's string */
+	if((filename = strdup(filename)) == NULL)
+	{
+		free(file_handle);
+		SET_ERROR(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+		return NULL;
+	}
+	if(open_handles(file_handle, filename, access).status != LIBR_OK)
+	{
+		/* failed to open file for processing, error already set */ 
+		free(filename);
+		free(file_handle);
+		return NULL;
+	}
+	/* Cleanup handles automatically when libr exits memory */
+	register_handle_cleanup(file_handle);
+	/* The handle is keyed on the file actually opened, the name may point elsewhere by now */
+	if(shared && ((fd = input_descriptor(file_handle)) == ERROR || fstat(fd, &info) != 0))
+		shared = false;
+	if(shared)
+	{
+		/* Lookups only read the table of contents and the archive once they are loaded */
+		toc_ready(file_handle);
+		archive_load(file_handle);
+		/* Another thread may have opened the same file in the meantime */
+		pthread_mutex_lock(&shared_lock);
+		if((shared_handle = find_shared_handle(&info)) == NULL)
+			intern_handle(file_handle, &info);
+		pthread_mutex_unlock(&shared_lock);
+		if(shared_handle != NULL)
+		{
+			unregister_handle_cleanup(file_handle);
+			libr_close_internal(file_handle);
+			file_handle = shared_handle;
+		}
+		SET_ERROR(LIBR_OK, NULL);
+	}
+	return file_handle;
+}
+
+/*
+ * Open a handle that writes its resources as assembler source for linking into a program
+ */
+EXPORT_FN libr_file *libr_open_embed(char *filename)
+{
+	libr_file *file_handle;
+	
+	if(filename == NULL)
+	{
+		SET_ERROR(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
+		return NULL;
+	}
+	if((file_handle = (libr_file *) calloc(1, sizeof(libr_file))) == NULL || (file_handle->front.embed.output = strdup(filename)) == NULL)
+	{
+		free(file_handle);
+		SET_ERROR(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+		return NULL;
+	}
+	file_handle->access = LIBR_READ_WRITE;
+	file_handle->front.policy.min_saving = DEFAULT_MIN_SAVING;
+	file_handle->front.policy.level = CODEC_DEFAULT_LEVEL;
+	file_handle->front.policy.codec = LIBR_COMPRESSED;
+	file_handle->front.policy.alignment = 1;
+	file_handle->front.archive.enabled = true;
+	file_handle->front.embed.enabled = true;
+	/* The source is written even when no resources are added */
+	file_handle->front.archive.changed = true;
+	/* Cleanup handles automatically when libr exits memory */
+	register_handle_cleanup(file_handle);
+	SET_ERROR(LIBR_OK, NULL);
+	return file_handle;
+}
+
+/*
+ * Open the resources loaded into memory with a shared library (from dlopen)
+ */
+EXPORT_FN libr_file *libr_open_loaded(void *dso_handle)
+{
+#if defined(HAVE_DL_ITERATE_PHDR) && defined(HAVE_DLINFO)
+	struct link_map *map = NULL;
+	
+	if(dso_handle == NULL || dlinfo(dso_handle, RTLD_DI_LINKMAP, &map) != 0 || map == NULL)
+	{
+		SET_ERROR(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
+		return NULL;
+	}
+	return open_image(map->l_name, (uintptr_t) map->l_addr);
+#else
+	SET_ERROR(LIBR_ERROR_UNSUPPORTED, "The requested operation is not supported by the backend");
+	return NULL;
+#endif /* HAVE_DL_ITERATE_PHDR && HAVE_DLINFO */
+}
+
+/*
+ * Open the resources loaded into memory with the running program
+ */
+EXPORT_FN libr_file *libr_open_self_mapped(void)
+{
+#ifdef HAVE_DL_ITERATE_PHDR
+	return open_image(NULL, 0);
+#else
+	SET_ERROR(LIBR_ERROR_UNSUPPORTED, "The requested operation is not supported by the backend");
+	return NULL;
+#endif /* HAVE_DL_ITERATE_PHDR */
+}
+
+/*
+ * Read a resource from the specified ELF binary handle
+ */
+EXPORT_FN int libr_read(libr_file *file_handle, char *resource_name, char *buffer)
+{
+	char *data_buffer = NULL, *packed = NULL;
+	const libr_codec *codec = NULL;
+	libr_tocentry *listed;
+	libr_section *scn = NULL;
+	libr_data *data = NULL;
+	size_t data_length;
+	libr_header info;
+	
+	/* Find the section containing the icon */
+	if(find_resource(file_handle, resource_name, &scn, &info).status != LIBR_OK)
+		return false; /* error already set */
+	data_length = info.data_offset+info.stored_size-info.base;
+	if(file_handle->front.image.loaded)
+	{
+		/* The resources of a loaded image are already in memory */
+		data_buffer = (char *) (uintptr_t) info.base;
+	}
+	else if(info.base != 0)
+	{
+		/* Archived resources are read on their own, not with the whole archive section */
+		if((packed = (char *) malloc(data_length)) == NULL)
+			PUBLIC_RETURN(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+		if(read_section(file_handle, scn, info.base, packed, data_length) != data_length)
+		{
+			free(packed);
+			PUBLIC_RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+		}
+		data_buffer = packed;
+	}
+	else
+	{
+		/* Get the section data (interested in header) */
+		if((data = get_data(file_handle, scn)) == NULL)
+			PUBLIC_RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+		data_buffer = (char *) data_pointer(scn, data);
+		data_length = data_size(scn, data);
+	}
+	/* Confirm that this resource is libr-compatible */
+	if(parse_header(data_buffer, data_length, data_length, &info).status != LIBR_OK)
+		goto failed; /* error already set */
+	/* Never write more than the size libr_size reported for the buffer */
+	if((listed = find_listed(file_handle, resource_name)) != NULL && listed->size != info.size)
+	{
+		SET_ERROR(LIBR_ERROR_SIZEMISMATCH, "Section's data size does not make sense");
+		goto failed;
+	}
+	switch(info.type)
+	{
+		case LIBR_UNCOMPRESSED:
+			memcpy(buffer, &data_buffer[info.data_offset], info.size);
+			break;
+		case LIBR_SEEKABLE:
+			if(unpack_blocks(data_buffer, &info, buffer).status != LIBR_OK)
+				goto failed; /* error already set */
+			break;
+		default:
+			if(find_codec(info.type, &codec).status != LIBR_OK)
+				goto failed; /* error already set */
+			if(!codec->unpack(buffer, info.size, &data_buffer[info.data_offset], info.stored_size))
+			{
+				SET_ERROR(LIBR_ERROR_UNCOMPRESS, "Failed to uncompress resource data");
+				goto failed;
+			}
+			break;
+	}
+	if(data != NULL)
+		free_data(file_handle, scn, data);
+	free(packed);
+	return true;
+failed:
+	if(data != NULL)
+		free_data(file_handle, scn, data);
+	free(packed);
+	return false;
+}
+
+/*
+ * Read part of a resource from the specified ELF binary handle
+ */
+EXPORT_FN int libr_read_range(libr_file *file_handle, char *resource_name, size_t offset, size_t length, char *buffer)
+{
+	libr_stream *stream = NULL;
+	libr_section *scn = NULL;
+	libr_header info;
+	size_t count;
+	
+	/* Ensure valid inputs */
+	if(file_handle == NULL || resource_name == NULL || (buffer == NULL && length != 0))
+		PUBLIC_RETURN(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
+	/* Find the section containing the resource */
+	/* Confirm that this resource is libr-compatible (only the header is needed) */
+	if(find_resource(file_handle, resource_name, &scn, &info).status != LIBR_OK)
+		return false; /* error already set */
+	if(offset > info.size || length > info.size-offset)
+		PUBLIC_RETURN(LIBR_ERROR_OUTOFRANGE, "Requested range lies outside of the resource");
+	if(length == 0)
+		PUBLIC_RETURN(LIBR_OK, NULL);
+	switch(info.type)
+	{
+		case LIBR_UNCOMPRESSED:
+			if(read_stored(file_handle, scn, info.data_offset+offset, buffer, length) != length)
+				PUBLIC_RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+			break;
+		case LIBR_COMPRESSED:
+			/* A single zlib stream must be inflated from the start, the caller's buffer
+			 * doubles as scratch space for the data preceding the range */
+			if((stream = libr_stream_open(file_handle, resource_name)) == NULL)
+				return false; /* error already set */
+			while(offset > 0)
+			{
+				if((count = libr_stream_read(stream, buffer, (offset < length ? offset : length))) == 0)
+					goto failed;
+				offset -= count;
+			}
+			while(length > 0)
+			{
+				if((count = libr_stream_read(stream, buffer, length)) == 0)
+					goto failed;
+				buffer += count;
+				length -= count;
+			}
+			libr_stream_close(stream);
+			break;
+		case LIBR_SEEKABLE:
+			if(read_range(file_handle, scn, &info, offset, length, buffer).status != LIBR_OK)
+				return false; /* error already set */
+			break;
+		default:
+		{
+			char *data_buffer;
+			
+			/* Other codecs can only unpack the resource as a whole */
+			if((data_buffer = libr_malloc(file_handle, resource_name, NULL)) == NULL)
+				return false; /* error already set */
+			memcpy(buffer, &data_buffer[offset], length);
+			free(data_buffer);
+		}	break;
+	}
+	PUBLIC_RETURN(LIBR_OK, NULL);
+failed:
+	if(libr_errno() == LIBR_OK)
+		SET_ERROR(LIBR_ERROR_SIZEMISMATCH, "Section's data size does not make sense");
+	libr_stream_close(stream);
+	return false;
+}
+
+/*
+ * Retrieve the number of libr-compatible resources
+ */
+EXPORT_FN unsigned int libr_resources(libr_file *file_handle)
+{
+	unsigned int i = 0;
+	libr_iter iter;
+	
+	if(!libr_iter_begin(file_handle, &iter))
+		return 0; /* error already set */
+	/* The table of contents already counted them */
+	if(iter.indexed)
+		return file_handle->front.toc.count;
+	while(libr_iter_next(&iter))
+		i++;
+	return i;
+}
+
+/*
+ * Set the boundary that the data of newly written resources starts on
+ */
+EXPORT_FN int libr_set_alignment(libr_file *file_handle, size_t alignment)
+{
+	if(file_handle == NULL || alignment == 0 || alignment > ALIGNMENT_MAX || (alignment & (alignment-1)) != 0)
+		PUBLIC_RETURN(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
+	file_handle->front.policy.alignment = alignment;
+	PUBLIC_RETURN(LIBR_OK, NULL);
+}
+
+/*
+ * Choose whether libr_write packs resources into the archive section of the handle
+ */
+EXPORT_FN int libr_set_archive(libr_file *file_handle, int enabled)
+{
+	if(file_handle == NULL)
+		PUBLIC_RETURN(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
+	file_handle->front.archive.enabled = (enabled != 0);
+	PUBLIC_RETURN(LIBR_OK, NULL);
+}
+
+/*
+ * Set how libr_write stores resources on a handle
+ */
+EXPORT_FN int libr_set_policy(libr_file *file_handle, unsigned int min_saving, int level)
+{
+	if(file_handle == NULL || min_saving > 100 || level < 0 || level > codec_max_level())
+		PUBLIC_RETURN(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
+	file_handle->front.policy.min_saving = min_saving;
+	file_handle->front.policy.level = level;
+	PUBLIC_RETURN(LIBR_OK, NULL);
+}
+
+/*
+ * Set the codec that LIBR_AUTO compresses resources with
+ */
+EXPORT_FN int libr_set_codec(libr_file *file_handle, libr_type_t type)
+{
+	const libr_codec *codec;
+	
+	if(file_handle == NULL || (type != LIBR_COMPRESSED && type != LIBR_ZSTD && type != LIBR_LZ4))
+		PUBLIC_RETURN(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
+	if(find_codec(type, &codec).status != LIBR_OK)
+		return false; /* error already set */
+	file_handle->front.policy.codec = type;
+	PUBLIC_RETURN(LIBR_OK, NULL);
+}
+
+/*
+ * Describe a resource from its header (without reading the stored data)
+ */
+EXPORT_FN int libr_stat(libr_file *file_handle, char *resource_name, libr_resource_info *info)
+{
+	libr_tocentry *entry;
+	libr_section *scn = NULL;
+	libr_header header;
+	
+	if(file_handle == NULL || resource_name == NULL || info == NULL)
+		PUBLIC_RETURN(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
+	/* The table of contents describes the resource without touching its section */
+	if((entry = find_listed(file_handle, resource_name)) != NULL)
+	{
+		info->size = entry->size;
+		info->stored_size = entry->stored_size;
+		info->type = entry->type;
+		info->version = entry->version;
+		info->flags = entry->flags;
+		info->alignment = entry->alignment;
+		info->digest = entry->digest;
+		PUBLIC_RETURN(LIBR_OK, NULL);
+	}
+	/* Confirm that this resource is libr-compatible (only the header is needed) */
+	if(find_resource(file_handle, resource_name, &scn, &header).status != LIBR_OK)
+		return false; /* error already set */
+	info->size = header.size;
+	info->stored_size = header.stored_size;
+	info->type = header.type;
+	info->version = header.version;
+	info->flags = header.flags;
+	info->alignment = header.alignment;
+	info->digest = header.digest;
+	PUBLIC_RETURN(LIBR_OK, NULL);
+}
+
+/*
+ * Get the size of a resource from the specified ELF binary handle
+ */
+EXPORT_FN int libr_size(libr_file *file_handle, char *resource_name, size_t *retsize)
+{
+	libr_tocentry *entry;
+	libr_section *scn = NULL;
+	libr_header info;
+	
+	/* The table of contents holds the size of every resource */
+	if((entry = find_listed(file_handle, resource_name)) != NULL)
+	{
+		*retsize = entry->size;
+		PUBLIC_RETURN(LIBR_OK, NULL);
+	}
+	/* Find the section containing the icon */
+	/* Confirm that this resource is libr-compatible (only the header is needed) */
+	if(find_resource(file_handle, resource_name, &scn, &info).status != LIBR_OK)
+		return false; /* error already set */
+	*retsize = info.size;
+	return true;
+}
+
+/*
+ * Release a resource stream
+ */
+EXPORT_FN void libr_stream_close(libr_stream *stream)
+{
+	if(stream == NULL)
+		return;
+	if(stream->info.type == LIBR_COMPRESSED)
+		inflateEnd(&stream->zstream);
+	free(stream->packed);
+	free(stream->block);
+	free(stream);
+}
+
+/*
+ * Prepare to read a resource sequentially (with memory use independent of its size)
+ */
+EXPORT_FN libr_stream *libr_stream_open(libr_file *file_handle, char *resource_name)
+{
+	libr_stream *stream = NULL;
+	libr_section *scn = NULL;
+	libr_header info;
+	
+	/* Ensure valid inputs */
+	if(file_handle == NULL || resource_name == NULL)
+	{
+		SET_ERROR(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
+		return NULL;
+	}
+	/* Find the section containing the resource */
+	/* Confirm that this resource is libr-compatible (only the header is needed) */
+	if(find_resource(file_handle, resource_name, &scn, &info).status != LIBR_OK)
+		return NULL; /* error already set */
+	if(info.type != LIBR_UNCOMPRESSED && info.type != LIBR_COMPRESSED && info.type != LIBR_SEEKABLE)
+	{
+		SET_ERROR(LIBR_ERROR_INVALIDTYPE, "Invalid data storage type specified: resource cannot be streamed");
+		return NULL;
+	}
+	if((stream = (libr_stream *) malloc(sizeof(libr_stream))) == NULL)
+	{
+		SET_ERROR(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+		return NULL;
+	}
+	memset(stream, 0, sizeof(libr_stream));
+	stream->handle = file_handle;
+	stream->scn = scn;
+	stream->info = info;
+	if(info.type == LIBR_COMPRESSED && inflateInit(&stream->zstream) != Z_OK)
+	{
+		free(stream);
+		SET_ERROR(LIBR_ERROR_ZLIBINIT, "zlib library initialization failed");
+		return NULL;
+	}
+	/* Seekable resources are unpacked a block at a time */
+	if(info.type == LIBR_SEEKABLE && info.size != 0)
+	{
+		stream->packed_max = packed_limit(&info);
+		stream->packed = (char *) malloc(stream->packed_max);
+		stream->block = (char *) malloc(info.block_size < info.size ? info.block_size : info.size);
+		if(stream->packed == NULL || stream->block == NULL)
+		{
+			libr_stream_close(stream);
+			SET_ERROR(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+			return NULL;
+		}
+	}
+	SET_ERROR(LIBR_OK, NULL);
+	return stream;
+}
+
+/*
+ * Read the next piece of a resource from a stream
+ */
+EXPORT_FN size_t libr_stream_read(libr_stream *stream, char *buffer, size_t size)
+{
+	libr_header *info;
+	z_stream *zs;
+	size_t count;
+	int ret;
+	
+	if(stream == NULL || (buffer == NULL && size != 0))
+	{
+		SET_ERROR(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
+		return 0;
+	}
+	info = &stream->info;
+	if(stream->finished || size == 0)
+	{
+		SET_ERROR(LIBR_OK, NULL);
+		return 0;
+	}
+	if(info->type == LIBR_UNCOMPRESSED)
+	{
+		/* Stored data is the resource data, copy it straight to the caller */
+		if(size > info->size-stream->produced)
+			size = info->size-stream->produced;
+		count = read_stored(stream->handle, stream->scn, info->data_offset+stream->produced, buffer, size);
+		if(count != size)
+		{
+			SET_ERROR(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+			return 0;
+		}
+		stream->produced += count;
+		stream->finished = (stream->produced == info->size);
+		SET_ERROR(LIBR_OK, NULL);
+		return count;
+	}
+	if(info->type == LIBR_SEEKABLE)
+	{
+		/* Hand out the cached block, unpacking the next one when it runs out */
+		count = 0;
+		while(count < size && stream->produced < info->size)
+		{
+			size_t block = stream->produced/info->block_size, start, length;
+			
+			if(stream->cached != block+1)
+			{
+				if(read_block(stream->handle, stream->scn, info, block, stream->packed, stream->packed_max, stream->block).status != LIBR_OK)
+					return 0; /* error already set */
+				stream->cached = block+1;
+			}
+			start = stream->produced-block*info->block_size;
+			length = block_length(info, block)-start;
+			if(length > size-count)
+				length = size-count;
+			memcpy(&buffer[count], &stream->block[start], length);
+			count += length;
+			stream->produced += length;
+		}
+		stream->finished = (stream->produced == info->size);
+		SET_ERROR(LIBR_OK, NULL);
+		return count;
+	}
+	/* Inflate into the caller's buffer, refilling the input one chunk at a time */
+	zs = &stream->zstream;
+	if(size > (uInt) -1)
+		size = (uInt) -1;
+	zs->next_out = (unsigned char *) buffer;
+	zs->avail_out = size;
+	while(zs->avail_out > 0 && !stream->finished)
+	{
+		if(zs->avail_in == 0)
+		{
+			count = info->stored_size-stream->position;
+			if(count == 0)
+			{
+				SET_ERROR(LIBR_ERROR_UNCOMPRESS, "Failed to uncompress resource data");
+				return 0;
+			}
+			if(count > STREAM_CHUNK)
+				count = STREAM_CHUNK;
+			if(read_stored(stream->handle, stream->scn, info->data_offset+stream->position, stream->chunk, count) != count)
+			{
+				SET_ERROR(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+				return 0;
+			}
+			stream->position += count;
+			zs->next_in = (unsigned char *) stream->chunk;
+			zs->avail_in = count;
+		}
+		ret = inflate(zs, Z_NO_FLUSH);
+		if(ret == Z_STREAM_END)
+			stream->finished = true;
+		else if(ret != Z_OK)
+		{
+			SET_ERROR(LIBR_ERROR_UNCOMPRESS, "Failed to uncompress resource data");
+			return 0;
+		}
+	}
+	count = size-zs->avail_out;
+	stream->produced += count;
+	if(stream->produced > info->size || (stream->finished && stream->produced != info->size))
+	{
+		SET_ERROR(LIBR_ERROR_SIZEMISMATCH, "Section's data size does not make sense");
+		return 0;
+	}
+	SET_ERROR(LIBR_OK, NULL);
+	return count;
+}
+
+/*
+ * Release a view obtained with libr_map (the file is unmapped with the last view)
+ */
+EXPORT_FN int libr_unmap(libr_file *file_handle, const char *view)
+{
+	libr_filemap *filemap;
+	int valid;
+	
+	/* Ensure valid inputs */
+	if(file_handle == NULL || view == NULL)
+		PUBLIC_RETURN(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
+	/* Views of a loaded image stay valid for as long as the image is loaded */
+	if(file_handle->front.image.loaded)
+		PUBLIC_RETURN(LIBR_OK, NULL);
+	lock_shared(file_handle);
+	filemap = &(file_handle->front.filemap);
+	valid = (filemap->views != 0 && view >= filemap->address && view < filemap->address+filemap->size);
+	if(valid && --filemap->views == 0)
+		unmap_file(file_handle);
+	unlock_shared(file_handle);
+	if(!valid)
+		PUBLIC_RETURN(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
+	PUBLIC_RETURN(LIBR_OK, NULL);
+}
+
+/*
+ * Write a resource to the specified ELF binary handle
+ */
+EXPORT_FN int libr_write(libr_file *file_handle, char *resource_name, char *buffer, size_t size, libr_type_t type, libr_overwrite_t overwrite)
+{
+	char *header = NULL, *packed = NULL, *payload = NULL;
+	size_t alignment, data_offset, payload_size;
+	const libr_codec *codec = NULL;
+	libr_packed *entry = NULL;
+	libr_section *scn = NULL;
+	libr_data *data = NULL;
+	libr_blob *blob = NULL;
+	libr_intstatus ret;
+	uint32_t digest;
+	
+	/* Ensure valid inputs */
 	if(file_handle == NULL || resource_name == NULL || buffer == NULL)
 		PUBLIC_RETURN(LIBR_ERROR_INVALIDPARAMS, "Invalid parameters passed to function");
 	if(file_handle->access != LIBR_READ_WRITE)
 		PUBLIC_RETURN(LIBR_ERROR_NOPERM, "Open handle with LIBR_READ_WRITE access");
+	/* Resources collected for linking are encoded together when the source is written */
+	if(file_handle->front.embed.enabled)
+	{
+		if(type != LIBR_AUTO && type != LIBR_UNCOMPRESSED && type != LIBR_SEEKABLE && find_codec(type, &codec).status != LIBR_OK)
+			return false; /* error already set */
+		if(embed_put(file_handle, resource_name, buffer, size, type, overwrite).status != LIBR_OK)
+			return false; /* error already set */
+		return true;
+	}
+	if(type == LIBR_AUTO)
+		type = choose_type(file_handle, buffer, size);
+	/* Reject storage types that cannot be written before touching the section */
+	if(type != LIBR_UNCOMPRESSED && type != LIBR_SEEKABLE && find_codec(type, &codec).status != LIBR_OK)
+		return false; /* error already set */
+	/* The table of contents is written again with the new resource */
+	toc_changed(file_handle);
+	names_free(file_handle);
 	/* Get the section if it already exists */
 	ret = find_section(file_handle, resource_name, &scn);
 	if(ret.status == LIBR_OK)
@@ -423,67 +2890,88 @@ EXPORT_FN int libr_write(libr_file *file_handle, char *resource_name, char *buff
 		/* If the section exists (and overwrite is not specified) then fail */
 		if(!overwrite)
 			PUBLIC_RETURN(LIBR_ERROR_OVERWRITE, "Section already exists, over-write not specified"); 
-		/* Grab the existing data section for overwriting */
-		if((data = get_data(file_handle, scn)) == NULL)
-			PUBLIC_RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+		if(file_handle->front.archive.enabled)
+		{
+			/* The resource moves into the archive */
+			if(!libr_clear(file_handle, resource_name))
+				return false; /* error already set */
+			scn = NULL;
+		}
+		/* Aliases sharing the old data keep it */
+		else if(release_resource(file_handle, scn, resource_name).status != LIBR_OK)
+			return false; /* error already set */
 	}
 	else if(ret.status == LIBR_ERROR_NOSECTION)
 	{
-		/* Create a new section named "resource_name" */
-		if(add_section(file_handle, resource_name, &scn).status != LIBR_OK)
-			return false; /* error already set */
-		/* Create a data segment to store the compressed image */
-		if((data = new_data(file_handle, scn)) == NULL)
-			PUBLIC_RETURN(LIBR_ERROR_NEWDATA, "Failed to create data for section");
+		scn = NULL;
+		/* The resource may have been packed into the archive */
+		if(archive_find(file_handle, resource_name, &entry).status == LIBR_OK)
+		{
+			if(!overwrite)
+				PUBLIC_RETURN(LIBR_ERROR_OVERWRITE, "Section already exists, over-write not specified");
+			/* Archived resources are replaced in place, otherwise the resource moves out of the archive */
+			if(!file_handle->front.archive.enabled)
+				archive_remove(file_handle, entry);
+		}
 	}
 	else
 		return false; /* error already set */
-	
-	header[header_size++] = (char) type;
-	switch(type)
+	digest = data_digest(buffer, size);
+	/* Archived resources are kept whole by the handle until the archive section is written */
+	if(!file_handle->front.archive.enabled)
 	{
-		case LIBR_UNCOMPRESSED:
-			/* Do nothing, just stick the data in */
-			break;
-		case LIBR_COMPRESSED:
+		/* Data that the binary already holds is shared instead of being stored again */
+		if(blobs_load(file_handle).status != LIBR_OK)
+			return false; /* error already set */
+		if(scn != NULL)
 		{
-			char *compressed_buffer = NULL, *uncompressed_buffer = buffer;
-			unsigned long compressed_size = 0, uncompressed_size = size;
-			uint32_t size_temp;
-			 
-			/* Store the uncompressed size to the header */
-			size_temp = uncompressed_size;
-			memcpy(&header[header_size], &size_temp, sizeof(uint32_t));
-			header_size += sizeof(uint32_t);
-			/* Compress the data for storage */
-			compressed_size = ceil((uncompressed_size+12)*1.1);
-			compressed_buffer = (char *) malloc(compressed_size);
-			if(compress((unsigned char *)compressed_buffer, &compressed_size, (unsigned char *)uncompressed_buffer, uncompressed_size) != Z_OK)
-			{
-				free(compressed_buffer);
-				PUBLIC_RETURN(LIBR_ERROR_COMPRESS, "Failed to compress resource data");
-			}
-			/* From here on treat the compressed buffer as the data */
-			buffer = compressed_buffer;
-			size = compressed_size;
-		}	break;
-		default:
-			PUBLIC_RETURN(LIBR_ERROR_INVALIDTYPE, "Invalid data storage type specified");
+			/* Grab the existing data section for overwriting */
+			if((data = get_data(file_handle, scn)) == NULL)
+				PUBLIC_RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+		}
+		else
+		{
+			/* Create a new section named "resource_name" */
+			if(add_section(file_handle, resource_name, &scn).status != LIBR_OK)
+				return false; /* error already set */
+			/* Create a data segment to store the compressed image */
+			if((data = new_data(file_handle, scn)) == NULL)
+				PUBLIC_RETURN(LIBR_ERROR_NEWDATA, "Failed to create data for section");
+		}
 	}
-	/* Store the resource header data */
-	if(set_data(file_handle, scn, data, 0, &header[0], header_size).status != LIBR_OK)
+	
+	alignment = file_handle->front.policy.alignment;
+	if(encode_data(file_handle, buffer, size, type, digest, alignment, &header, &data_offset, &payload, &payload_size, &packed).status != LIBR_OK)
 		return false; /* error already set */
-	/* Create a data segment to store the post-header data
-	 * NOTE: For existing files the data of the section is represented as a continuous stream
-	 * (so calling elf_getdata now WILL NOT return the post-header data)
-	 */
-	if((data = new_data(file_handle, scn)) == NULL)
-		PUBLIC_RETURN(LIBR_ERROR_NEWDATA, "Failed to create data for section");
-	/* Store the actual user data to the section */
-	if(set_data(file_handle, scn, data, header_size, buffer, size).status != LIBR_OK)
+	/* Data that the binary already holds (stored the same way) is shared instead of being stored again */
+	if(!file_handle->front.archive.enabled && size > 0)
+		blob = blob_match(file_handle, type, size, digest, alignment, header, data_offset, payload, payload_size);
+	/* An alias is only worthwhile when it is smaller than the data */
+	if(blob != NULL && strlen(blob->name) < size)
+	{
+		if(header != packed)
+			free(header);
+		free(packed);
+		if(write_alias(file_handle, scn, data, blob).status != LIBR_OK)
+			return false; /* error already set */
+		blob->refs++;
+		PUBLIC_RETURN(LIBR_OK, NULL);
+	}
+	/* The section must start on the boundary for the stored data to be aligned within the file */
+	if(scn != NULL && alignment > 1 && (ret = set_alignment(file_handle, scn, alignment)).status != LIBR_OK)
+		; /* error already set, the encoded data is released below */
+	else if(file_handle->front.archive.enabled)
+		ret = archive_store(file_handle, resource_name, header, data_offset, payload, payload_size, alignment);
+	else
+		ret = store_data(file_handle, scn, data, header, data_offset, payload, payload_size);
+	/* Close compression resources (the header is in use until the data is stored) */
+	if(header != packed)
+		free(header);
+	free(packed);
+	if(ret.status != LIBR_OK)
 		return false; /* error already set */
-	/* Close compression resources */
-	if(type == LIBR_COMPRESSED)
-		free(buffer);
-	return true;
+	/* Later copies of the data can share it (failing to index it only loses the sharing) */
+	if(size > 0 && !file_handle->front.archive.enabled)
+		blob_add(file_handle, resource_name, type, size, digest, alignment);
+	PUBLIC_RETURN(LIBR_OK, NULL);
 }
@@ -71,19 +71,29 @@ typedef enum {
 	LIBR_ERROR_BEGINFAILED      = -29, /**< Failed to open ELF file: */
 	LIBR_ERROR_WRITEPERM        = -30, /**< No write permission for file */
 	LIBR_ERROR_UNSUPPORTED      = -31, /**< The requested operation is not supported by the backend */
+	LIBR_ERROR_MAPFAILED        = -32, /**< Failed to map input file: */
+	LIBR_ERROR_NOTMAPPABLE      = -33, /**< Resource cannot be mapped: */
+	LIBR_ERROR_OUTOFRANGE       = -34, /**< Requested range lies outside of the resource */
+	LIBR_ERROR_NOCODEC          = -35, /**< Storage type is not available in this build of libr: */
+	LIBR_ERROR_SETALIGN         = -36, /**< Failed to set alignment for section: */
 } libr_status;
 /**
  * @}
  */
 
 typedef enum {
-	LIBR_READ       = 0,
-	LIBR_READ_WRITE = 1,
+	LIBR_READ        = 0,
+	LIBR_READ_WRITE  = 1,
+	LIBR_READ_SHARED = 2, /* LIBR_READ, sharing the handle with other LIBR_READ_SHARED opens */
 } libr_access_t;
 
 typedef enum {
 	LIBR_UNCOMPRESSED = 0,
-	LIBR_COMPRESSED   = 1
+	LIBR_COMPRESSED   = 1,
+	LIBR_SEEKABLE     = 2,
+	LIBR_ZSTD         = 3,
+	LIBR_LZ4          = 4,
+	LIBR_AUTO         = -1 /* libr_write picks one of the above for the data */
 } libr_type_t;
 
 typedef enum {
@@ -97,7 +107,7 @@ typedef enum {
 		#include "libr-bfd.h"
 	#elif __LIBR_BACKEND_libelf__
 		#include "libr-elf.h"
-	#elif __LIBR_BACKEND_readonly__
+	#elif __LIBR_BACKEND_readonly__ || __LIBR_BACKEND_native__
 		#include "libr-ro.h"
 	#else /* LIBR_BACKEND */
 		#error "Unhandled backend"
@@ -108,10 +118,110 @@ typedef enum {
 	typedef struct _libr_file libr_file;
 #endif /* __LIBR_BUILD__ */
 
+/**
+ * @addtogroup libr_iter libr_iter
+ * @brief Cursor for walking the resources of an ELF binary.
+ * @{
+ * \#include <libr.h>
+ */
+/** Resource cursor filled in by libr_iter_next() */
+typedef struct {
+	const char *name;   /**< Name of the resource (owned by the handle) */
+	size_t size;        /**< Size of the resource data once uncompressed */
+	size_t stored_size; /**< Bytes the resource data occupies in the binary */
+	libr_type_t type;   /**< Method used for storing the resource data */
+	libr_file *handle;  /**< Private: handle being walked */
+	void *section;      /**< Private: current position of the cursor */
+	unsigned long entry; /**< Private: position within the archive or the table of contents */
+	int indexed;        /**< Private: walking the table of contents instead of the sections */
+} libr_iter;
+/**
+ * @}
+ */
+
+/**
+ * @addtogroup libr_resource_info libr_resource_info
+ * @brief Description of a resource read from its header alone.
+ * @{
+ * \#include <libr.h>
+ */
+/** Flags recorded in the header of a resource */
+typedef enum {
+	LIBR_FLAG_DIGEST = 1, /**< The header holds a CRC-32 of the uncompressed data */
+	LIBR_FLAG_ALIAS  = 2  /**< The data is shared with another resource holding identical data */
+} libr_flags_t;
+	
+/** Resource description filled in by libr_stat() */
+typedef struct {
+	size_t size;             /**< Size of the resource data once uncompressed */
+	size_t stored_size;      /**< Bytes the resource data occupies in the binary */
+	libr_type_t type;        /**< Method used for storing the resource data */
+	unsigned int version;    /**< Version of the resource header (1 or 2) */
+	unsigned int flags;      /**< Combination of libr_flags_t values */
+	size_t alignment;        /**< Boundary the stored data was aligned to when written */
+	unsigned long digest;    /**< CRC-32 of the uncompressed data (if LIBR_FLAG_DIGEST is set) */
+} libr_resource_info;
+/**
+ * @}
+ */
+
+/**
+ * @addtogroup libr_glob_callback libr_glob_callback
+ * @brief Function called by libr_glob() for each matching resource.
+ * @{
+ * \#include <libr.h>
+ */
+/** Receives the name of a matching resource, returns 0 to stop the query */
+typedef int (*libr_glob_callback)(libr_file *handle, const char *name, void *data);
+/**
+ * @}
+ */
+
+/**
+ * @addtogroup libr_stream libr_stream
+ * @brief Sequential reader for the data of a resource.
+ * @{
+ * \#include <libr.h>
+ */
+/** Opaque reader returned by libr_stream_open() */
+struct _libr_stream;
+typedef struct _libr_stream libr_stream;
+/**
+ * @}
+ */
+
 /*************************************************************************
  * libr Resource Management API
  *************************************************************************/
 
+/**
+ * @page libr_begin Start a batch of changes to an ELF executable.
+ * @section SYNOPSIS
+ * 	\#include <libr.h>
+ * 	
+ * 	<b>int libr_begin(libr_file *handle);</b>
+ * 
+ * @section DESCRIPTION
+ * 	Stages every following resource addition, overwrite and removal in
+ * 	memory instead of writing each one to the ELF executable as it is
+ * 	made.  The staged changes are laid out and written to the disk once,
+ * 	when <b>libr_commit</b>(3) is called or the handle is closed using
+ * 	<b>libr_close</b>(3).  The handle must be opened using
+ * 	<b>libr_open</b>(3) with <b>LIBR_READ_WRITE</b> access.
+ * 
+ * 	Backends that already hold every change until the handle is closed
+ * 	accept this call without changing their behavior.
+ * 	
+ * 	@param handle A handle returned by <b>libr_open</b>(3).
+ * 
+ * @section SA SEE ALSO
+ * 	<b>libr_commit</b>(3), <b>libr_write</b>(3), <b>libr_clear</b>(3)
+ * 
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+int libr_begin(libr_file *handle);
+
 /**
  * @page libr_clear Remove a resource from an ELF executable.
  * @section SYNOPSIS
@@ -126,6 +236,10 @@ typedef enum {
  * 
  * 	Please note that resource removal does not occur until the handle is
  * 	closed using <b>libr_close</b>(3).
+ * 
+ * 	Removing a resource whose data is shared with aliases (see
+ * 	<b>libr_write</b>(3)) moves the data to one of the aliases, the
+ * 	others keep sharing it from there.
  * 	
  * 	@param handle A handle returned by <b>libr_open</b>(3).
  * 	@param resourcename The name of the libr-compatible resource to remove. 
@@ -148,18 +262,75 @@ int libr_clear(libr_file *handle, char *resourcename);
  * @section DESCRIPTION
  * 	Handles opened with <b>libr_open</b>(3) should be closed with
  * 	<b>libr_close</b>() when they are no-longer needed by the calling
- * 	application. 
+ * 	application.  A handle shared by several <b>LIBR_READ_SHARED</b>
+ * 	opens of the same file is only released by the last
+ * 	<b>libr_close</b>().
+ * 	Changes that have not been written yet are written when the handle
+ * 	is closed, <b>libr_errno</b>(3) reports whether that succeeded.
  * 	
  * 	@param handle The handle to close. 
  * 
  * @section SA SEE ALSO
- * 	<b>libr_open</b>(3)
+ * 	<b>libr_open</b>(3), <b>libr_commit</b>(3), <b>libr_discard</b>(3)
  * 
  * @section AUTHOR
  * 	Erich Hoover <ehoover@mines.edu>
  */
 void libr_close(libr_file *handle);
 
+/**
+ * @page libr_commit Write a batch of changes to an ELF executable.
+ * @section SYNOPSIS
+ * 	\#include <libr.h>
+ * 	
+ * 	<b>int libr_commit(libr_file *handle);</b>
+ * 
+ * @section DESCRIPTION
+ * 	Lays out and writes all of the changes staged since
+ * 	<b>libr_begin</b>(3) was called in a single update of the ELF
+ * 	executable.  Changes made after the commit are once again written
+ * 	as they are made, until <b>libr_begin</b>(3) is called again.  The
+ * 	table of contents describing the resources of the binary (used to
+ * 	list and size resources without reading each one) is brought up to
+ * 	date with the commit.
+ * 	
+ * 	@param handle A handle returned by <b>libr_open</b>(3).
+ * 
+ * @section SA SEE ALSO
+ * 	<b>libr_begin</b>(3), <b>libr_close</b>(3)
+ * 
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+int libr_commit(libr_file *handle);
+
+/**
+ * @page libr_discard Drop the resources collected for linking.
+ * @section SYNOPSIS
+ * 	\#include <libr.h>
+ * 	
+ * 	<b>int libr_discard(libr_file *handle);</b>
+ * 
+ * @section DESCRIPTION
+ * 	Forgets the resources written to a handle opened with
+ * 	<b>libr_open_embed</b>(3) since its source was last written, so
+ * 	that <b>libr_close</b>(3) leaves the source and archive alone.
+ * 	Use it when collecting the resources failed part of the way
+ * 	through.  A failed <b>libr_commit</b>(3) discards the resources on
+ * 	its own.  Other handles write their changes as they are made (or
+ * 	stage them with the backend), they cannot be discarded.
+ * 	
+ * 	@param handle A handle returned by <b>libr_open_embed</b>(3).
+ * 	@return Returns 1 on success, 0 on failure. 
+ * 
+ * @section SA SEE ALSO
+ * 	<b>libr_open_embed</b>(3), <b>libr_commit</b>(3), <b>libr_close</b>(3)
+ * 
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+int libr_discard(libr_file *handle);
+
 /**
  * @page libr_errmsg Return a detailed description of the last
  * 	libr-related error.
@@ -171,7 +342,9 @@ void libr_close(libr_file *handle);
  * @section DESCRIPTION
  * 	Returns a detailed string describing the last error encountered by
  * 	the libr resource library.  The string is an internal error
- * 	description, so it should not be freed.
+ * 	description, so it should not be freed.  Every thread has its own
+ * 	last error, the string stays valid until the next libr call made by
+ * 	the same thread.
  * 	
  * 	If no errors have been encountered then NULL is returned. 
  * 
@@ -209,6 +382,93 @@ char *libr_errmsg(void);
  */
 libr_status libr_errno(void);
 
+/**
+ * @page libr_glob List the resources of an ELF binary matching a pattern.
+ * @section SYNOPSIS
+ * 	\#include <libr.h>
+ * 	
+ * 	<b>int libr_glob(libr_file *handle, const char *pattern, libr_glob_callback callback, void *data);</b>
+ *
+ * @section DESCRIPTION
+ * 	Calls <i>callback</i> with the name of every resource matching the
+ * 	shell wildcard <i>pattern</i>, in sorted order.  Resource names are
+ * 	treated as slash-separated paths: wildcards do not match a '/', so
+ * 	"locale/de/" followed by a "*" lists the resources directly inside
+ * 	"locale/de" but not those of its subdirectories.  The names are kept
+ * 	sorted by the handle, so a pattern starting with a fixed directory
+ * 	only visits the resources inside that directory.
+ * 	The callback must not add or remove resources of the handle.
+ * 	
+ * 	@param handle A handle returned by <b>libr_open</b>(3).
+ * 	@param pattern A pattern as understood by <b>fnmatch</b>(3).
+ * 	@param callback Called with the handle, the name of a matching
+ * 		resource (owned by the handle) and <i>data</i>.  Returning 0 ends
+ * 		the query early.
+ * 	@param data Passed on to <i>callback</i>.
+ * 	@return Returns 1 on success, 0 on failure. 
+ * 
+ * @section SA SEE ALSO
+ * 	<b>libr_iter_next</b>(3), <b>libr_list</b>(3)
+ * 
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+int libr_glob(libr_file *handle, const char *pattern, libr_glob_callback callback, void *data);
+
+/**
+ * @page libr_iter_begin Start walking the resources of an ELF binary.
+ * @section SYNOPSIS
+ * 	\#include <libr.h>
+ * 	
+ * 	<b>int libr_iter_begin(libr_file *handle, libr_iter *iter);</b>
+ * 
+ * @section DESCRIPTION
+ * 	Prepares a cursor for walking every libr-compatible resource stored
+ * 	in an ELF binary with <b>libr_iter_next</b>(3).  Walking the resources
+ * 	with a cursor visits each section of the binary only once, whereas
+ * 	calling <b>libr_list</b>(3) for every index restarts the search each
+ * 	time.
+ * 	
+ * 	@param handle A handle returned by <b>libr_open</b>(3).
+ * 	@param iter The cursor to prepare.
+ * 	@return Returns 1 on success, 0 on failure. 
+ * 
+ * @section SA SEE ALSO
+ * 	<b>libr_iter_next</b>(3), <b>libr_open</b>(3)
+ * 
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+int libr_iter_begin(libr_file *handle, libr_iter *iter);
+
+/**
+ * @page libr_iter_next Advance to the next resource of an ELF binary.
+ * @section SYNOPSIS
+ * 	\#include <libr.h>
+ * 	
+ * 	<b>int libr_iter_next(libr_iter *iter);</b>
+ * 
+ * @section DESCRIPTION
+ * 	Moves a cursor prepared by <b>libr_iter_begin</b>(3) to the next
+ * 	libr-compatible resource and fills in its name, uncompressed size,
+ * 	stored size and storage type.  Only the header of each resource is
+ * 	read, and binaries written by this version of libr list all of their
+ * 	resources in a table of contents section that is read instead of the
+ * 	headers.  The name is owned by the handle, it must not be freed and it
+ * 	is only valid until the handle is modified or closed.
+ * 	
+ * 	@param iter A cursor prepared by <b>libr_iter_begin</b>(3).
+ * 	@return Returns 1 when the cursor holds the next resource, 0 once all
+ * 		the resources have been visited (or on failure). 
+ * 
+ * @section SA SEE ALSO
+ * 	<b>libr_iter_begin</b>(3), <b>libr_malloc</b>(3)
+ * 
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+int libr_iter_next(libr_iter *iter);
+
 /**
  * @page libr_list Obtain the name of a libr ELF resource (by index).
  * @section SYNOPSIS
@@ -222,6 +482,9 @@ libr_status libr_errno(void);
  * 	0 to the value returned by <b>libr_resources</b>(3), which returns the
  * 	total number of libr-compatible resources stored in the ELF binary.
  * 	
+ * 	To visit every resource use <b>libr_iter_begin</b>(3) instead, each
+ * 	call to <b>libr_list</b>() searches from the first section again.
+ * 	
  * 	@param handle A handle returned by <b>libr_open</b>(3).
  * 	@param resourceid The index of the libr-compatible resource for which
  * 		the name will be returned.
@@ -268,6 +531,41 @@ char *libr_list(libr_file *file_handle, unsigned int resourceid);
  */
 char *libr_malloc(libr_file *handle, char *resourcename, size_t *size);
 
+/**
+ * @page libr_map Obtain a zero-copy view of a libr ELF resource.
+ * @section SYNOPSIS
+ * 	\#include <libr.h>
+ * 	
+ * 	<b>const char *libr_map(libr_file *handle, char *resourcename, size_t *size);</b>
+ * 
+ * @section DESCRIPTION
+ * 	Returns a pointer directly into a read-only memory mapping of the ELF
+ * 	binary for a resource stored with <b>LIBR_UNCOMPRESSED</b>, no copy of
+ * 	the data is made.  The binary is mapped once per handle and shared by
+ * 	all of the views obtained from that handle.
+ * 	
+ * 	Only handles opened with <b>LIBR_READ</b> or <b>LIBR_READ_SHARED</b>
+ * 	access may be mapped, and resources stored with <b>LIBR_COMPRESSED</b> or <b>LIBR_SEEKABLE</b>
+ * 	must be read with <b>libr_read</b>(3) or <b>libr_malloc</b>(3) instead.
+ * 	
+ * 	@param handle A handle returned by <b>libr_open</b>(3).
+ * 	@param resourcename The name of the libr-compatible resource to map.
+ * 	@param size A pointer for storing the length of the data contained in
+ * 		the resource.  May be NULL.
+ * 	
+ * 	@return Returns NULL on failure, a pointer to the (read-only) data of
+ * 		the resource on success.  The view must be released with
+ * 		<b>libr_unmap</b>(3) and is invalidated when the handle is closed
+ * 		with <b>libr_close</b>(3).
+ * 
+ * @section SA SEE ALSO
+ * 	<b>libr_open</b>(3), <b>libr_unmap</b>(3), <b>libr_malloc</b>(3)
+ * 
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+const char *libr_map(libr_file *handle, char *resourcename, size_t *size);
+
 /**
  * @page libr_open Open an ELF executable file for resource management.
  * @section SYNOPSIS
@@ -285,10 +583,20 @@ char *libr_malloc(libr_file *handle, char *resourcename, size_t *size);
  * 	reason that an actively-open application cannot edit itself, the
  * 	calling binary may only request <b>LIBR_READ</b> access.
  * 	
+ * 	Opening a file with <b>LIBR_READ_SHARED</b> access while the same
+ * 	file (same device, inode and modification time) is already open
+ * 	with <b>LIBR_READ_SHARED</b> access returns the existing handle, so
+ * 	the sections, indexes and mapped data are loaded once per process no
+ * 	matter how many callers look up resources.  Every <b>libr_open</b>()
+ * 	still needs its own <b>libr_close</b>(3).  A shared handle otherwise
+ * 	behaves like one opened with <b>LIBR_READ</b> access, which is never
+ * 	shared: callers using a handle from several threads at once have to
+ * 	serialize their calls, so only share a handle with callers that do.
+ * 	
  * 	@param filename ELF executable to manage.  Pass a NULL pointer as the
  * 		filename in order to access the calling binary (<b>LIBR_READ</b>
  * 		access only) @param access Requested access type (<b>LIBR_READ</b>,
- * 		<b>LIBR_WRITE</b>, <b>LIBR_READ_WRITE</b>), the valid operations for
+ * 		<b>LIBR_READ_SHARED</b>, <b>LIBR_READ_WRITE</b>), the valid operations for
  * 		the returned handle will be restricted based upon the requested access.
  * 	@return Returns a libr file handle on success, NULL on failure.  The
  * 		handle should be freed with <b>libr_close</b>(3) when no-longer used. 
@@ -301,6 +609,110 @@ char *libr_malloc(libr_file *handle, char *resourcename, size_t *size);
  */
 libr_file *libr_open(char *filename, libr_access_t access);
 
+/**
+ * @page libr_open_embed Collect resources into assembler source for linking.
+ * @section SYNOPSIS
+ * 	\#include <libr.h>
+ * 	
+ * 	<b>libr_file *libr_open_embed(char *filename);</b>
+ * 
+ * @section DESCRIPTION
+ * 	Opens a handle that writes its resources as assembler source instead
+ * 	of into an existing binary.  Resources added with <b>libr_write</b>(3)
+ * 	are compressed together (each on its own processor) and packed into
+ * 	an archive when the handle is committed or closed.  The archive is
+ * 	written next to the source, <i>filename</i> with its extension
+ * 	replaced by ".pack", and the source places it into an allocated,
+ * 	read-only section with <b>.incbin</b> along with the "libr" note that
+ * 	<b>libr_open_self_mapped</b>(3) and <b>libr_open_loaded</b>(3) look
+ * 	for.  Assemble the source from the directory it was written for (the
+ * 	archive is included by the path it was written to) and link the
+ * 	object into the program or library.  The same resources always
+ * 	produce the same source and archive.
+ * 	
+ * 	The alignment set with <b>libr_set_alignment</b>(3) applies to each
+ * 	resource as it is written, the policy set with <b>libr_set_policy</b>(3)
+ * 	when the resources are compressed.  The handle can only be written
+ * 	to, reading resources from it fails with <b>LIBR_ERROR_UNSUPPORTED</b>.
+ * 	Call <b>libr_commit</b>(3) to find out whether the source was written
+ * 	(or check <b>libr_errno</b>(3) after <b>libr_close</b>(3), which
+ * 	writes it as well), and <b>libr_discard</b>(3) to close the handle
+ * 	without writing anything after a failure.
+ * 	
+ * 	@param filename The assembler source to write.
+ * 	@return Returns a libr file handle on success, NULL on failure.  The
+ * 		handle should be freed with <b>libr_close</b>(3) when no-longer used.
+ * 
+ * @section SA SEE ALSO
+ * 	<b>libr_open_self_mapped</b>(3), <b>libr_open_loaded</b>(3), <b>libr_write</b>(3), <b>libr_commit</b>(3)
+ * 
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+libr_file *libr_open_embed(char *filename);
+
+/**
+ * @page libr_open_loaded Open the resources loaded with a shared library.
+ * @section SYNOPSIS
+ * 	\#include <libr.h>
+ * 	
+ * 	<b>libr_file *libr_open_loaded(void *dso_handle);</b>
+ * 
+ * @section DESCRIPTION
+ * 	Opens the resources that were linked into a shared library as a
+ * 	loadable archive, see <b>libr_open_self_mapped</b>(3).  The archive
+ * 	is found through the program headers of the loaded library, so the
+ * 	resources are read straight from memory without opening the file.
+ * 	Resources written into the library after it was linked are not
+ * 	part of the loadable archive, open the library with
+ * 	<b>libr_open</b>(3) to read those.
+ * 	
+ * 	@param dso_handle A handle returned by <b>dlopen</b>(3) for the
+ * 		library.
+ * 	@return Returns a libr file handle on success, NULL on failure.  The
+ * 		handle should be freed with <b>libr_close</b>(3) when no-longer used,
+ * 		and before the library is unloaded.
+ * 
+ * @section SA SEE ALSO
+ * 	<b>libr_open_self_mapped</b>(3), <b>libr_open</b>(3), <b>libr_close</b>(3)
+ * 
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+libr_file *libr_open_loaded(void *dso_handle);
+
+/**
+ * @page libr_open_self_mapped Open the resources loaded with the running program.
+ * @section SYNOPSIS
+ * 	\#include <libr.h>
+ * 	
+ * 	<b>libr_file *libr_open_self_mapped(void);</b>
+ * 
+ * @section DESCRIPTION
+ * 	Opens the resources that were linked into the running program as a
+ * 	loadable archive: an archive of resources placed in an allocated,
+ * 	read-only section and pointed at by a "libr" note (see
+ * 	<b>libr_open_embed</b>(3)).  Such an archive is mapped into memory by
+ * 	the program loader along with the code, so reading its resources
+ * 	does not open or read any file.  Uncompressed resources can be viewed
+ * 	in place with <b>libr_map</b>(3).
+ * 	
+ * 	The handle has <b>LIBR_READ</b> access.  It only holds the resources
+ * 	of the loadable archive, the function fails with
+ * 	<b>LIBR_ERROR_NOSECTION</b> for programs that do not have one (open
+ * 	those with <b>libr_open</b>(3) instead).
+ * 	
+ * 	@return Returns a libr file handle on success, NULL on failure.  The
+ * 		handle should be freed with <b>libr_close</b>(3) when no-longer used. 
+ * 
+ * @section SA SEE ALSO
+ * 	<b>libr_open_loaded</b>(3), <b>libr_open</b>(3), <b>libr_map</b>(3)
+ * 
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+libr_file *libr_open_self_mapped(void);
+
 /**
  * @page libr_read Read out the contents of a libr ELF resource.
  * @section SYNOPSIS
@@ -328,6 +740,37 @@ libr_file *libr_open(char *filename, libr_access_t access);
  */
 int libr_read(libr_file *handle, char *resourcename, char *buffer);
 
+/**
+ * @page libr_read_range Read part of the contents of a libr ELF resource.
+ * @section SYNOPSIS
+ * 	\#include <libr.h>
+ * 	
+ * 	<b>int libr_read_range(libr_file *handle, char *resourcename, size_t offset, size_t length, char *buffer);</b>
+ *
+ * @section DESCRIPTION
+ * 	Reads <i>length</i> bytes of the (uncompressed) contents of a resource
+ * 	starting at <i>offset</i>.  For resources stored with
+ * 	<b>LIBR_SEEKABLE</b> only the blocks covering the requested range are
+ * 	read and uncompressed, resources stored with <b>LIBR_COMPRESSED</b>
+ * 	must be uncompressed from the start of the data up to the end of the
+ * 	range.
+ * 	
+ * 	@param handle A handle returned by <b>libr_open</b>(3).
+ * 	@param resourcename The name of the resource to read.
+ * 	@param offset The position of the first byte to read.
+ * 	@param length The number of bytes to read.
+ * 	@param buffer A buffer of at least <i>length</i> bytes for storing
+ * 		the data.
+ * 	@return Returns 1 on success, 0 on failure. 
+ * 
+ * @section SA SEE ALSO
+ * 	<b>libr_read</b>(3), <b>libr_size</b>(3), <b>libr_write</b>(3)
+ * 
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+int libr_read_range(libr_file *handle, char *resourcename, size_t offset, size_t length, char *buffer);
+
 /**
  * @page libr_resources Returns the number of resources contained in
  * 	the ELF binary.
@@ -352,6 +795,134 @@ int libr_read(libr_file *handle, char *resourcename, char *buffer);
  */
 unsigned int libr_resources(libr_file *handle);
 
+/**
+ * @page libr_set_alignment Align the data of resources in an ELF binary.
+ * @section SYNOPSIS
+ * 	\#include <libr.h>
+ * 	
+ * 	<b>int libr_set_alignment(libr_file *handle, size_t alignment);</b>
+ *
+ * @section DESCRIPTION
+ * 	Sets the boundary, relative to the start of the file, that the data
+ * 	of the resources written with this handle begins on.  Aligned
+ * 	uncompressed resources can be handed directly from
+ * 	<b>libr_map</b>(3) to code that requires aligned input (such as
+ * 	SIMD parsers or GPU uploads).  The header of each resource records
+ * 	the alignment it was written with, see <b>libr_stat</b>(3).
+ * 	
+ * 	@param handle A handle returned by <b>libr_open</b>(3).
+ * 	@param alignment A power of two from 1 (the default) to 65536.
+ * 	@return Returns 1 on success, 0 on failure. 
+ * 
+ * @section SA SEE ALSO
+ * 	<b>libr_write</b>(3), <b>libr_map</b>(3), <b>libr_stat</b>(3)
+ * 
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+int libr_set_alignment(libr_file *handle, size_t alignment);
+
+/**
+ * @page libr_set_archive Pack the resources of an ELF binary into one section.
+ * @section SYNOPSIS
+ * 	\#include <libr.h>
+ * 	
+ * 	<b>int libr_set_archive(libr_file *handle, int enabled);</b>
+ *
+ * @section DESCRIPTION
+ * 	Chooses whether <b>libr_write</b>(3) stores resources in sections of
+ * 	their own (the default) or packs them into a single archive section.
+ * 	Binaries with thousands of small resources stay small and fast to
+ * 	open in archive mode, since the archive only costs one section header
+ * 	and looks resources up through a sorted directory.  The archive is
+ * 	written when the handle is committed or closed.  Archived resources
+ * 	are read, listed and removed exactly like any other resource, whether
+ * 	or not archive mode is enabled on the handle reading them.
+ * 	
+ * 	@param handle A handle returned by <b>libr_open</b>(3).
+ * 	@param enabled Non-zero to pack resources written with this handle
+ * 		into the archive, zero to give each one a section.
+ * 	@return Returns 1 on success, 0 on failure. 
+ * 
+ * @section SA SEE ALSO
+ * 	<b>libr_write</b>(3), <b>libr_commit</b>(3), <b>libr_close</b>(3)
+ * 
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+int libr_set_archive(libr_file *handle, int enabled);
+
+/**
+ * @page libr_set_policy Control how libr chooses the storage of a resource.
+ * @section SYNOPSIS
+ * 	\#include <libr.h>
+ * 	
+ * 	<b>int libr_set_policy(libr_file *handle, unsigned int min_saving, int level);</b>
+ *
+ * @section DESCRIPTION
+ * 	Sets how <b>libr_write</b>(3) stores resources on this handle.  A
+ * 	resource written with <b>LIBR_AUTO</b> is stored uncompressed when it
+ * 	starts with the signature of an already compressed format (such as PNG,
+ * 	JPEG or gzip) or when compressing samples of the data saves less than
+ * 	<i>min_saving</i> percent of their size.  Otherwise it is compressed
+ * 	with zlib, which every build of libr can read, or with the codec
+ * 	chosen with <b>libr_set_codec</b>(3).  Uncompressed resources can be
+ * 	read without a copy using <b>libr_map</b>(3).
+ * 
+ * 	The defaults are a saving of 10 percent and the default level of each
+ * 	codec.  Each codec has its own range of levels: zlib goes up to 9,
+ * 	zstd up to 22 and lz4 has a single level.  A level above the highest
+ * 	level of the codec a resource is compressed with uses that highest
+ * 	level instead.
+ * 	
+ * 	@param handle A handle returned by <b>libr_open</b>(3).
+ * 	@param min_saving The smallest saving (0 to 100 percent) for which
+ * 		<b>LIBR_AUTO</b> compresses a resource.
+ * 	@param level The compression level used for every compressed
+ * 		resource written with the handle, from 1 (fastest) to the
+ * 		highest level of the codecs in this build of libr (smallest),
+ * 		or 0 for the default of the codec.
+ * 	@return Returns 1 on success, 0 on failure. 
+ * 
+ * @section SA SEE ALSO
+ * 	<b>libr_write</b>(3), <b>libr_set_codec</b>(3), <b>libr_map</b>(3)
+ * 
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+int libr_set_policy(libr_file *handle, unsigned int min_saving, int level);
+
+/**
+ * @page libr_set_codec Choose the codec used for automatically compressed resources.
+ * @section SYNOPSIS
+ * 	\#include <libr.h>
+ * 	
+ * 	<b>int libr_set_codec(libr_file *handle, libr_type_t type);</b>
+ *
+ * @section DESCRIPTION
+ * 	Sets the codec that resources written to the handle with
+ * 	<b>LIBR_AUTO</b> are compressed with when compressing them pays off
+ * 	(see <b>libr_set_policy</b>(3)).  By default they are compressed with
+ * 	zlib, large resources as <b>LIBR_SEEKABLE</b> blocks.  <b>LIBR_ZSTD</b>
+ * 	and <b>LIBR_LZ4</b> uncompress faster, but builds of libr without the
+ * 	matching library cannot read the resources, so only choose them when
+ * 	every reader of the file is built with it.
+ * 	
+ * 	@param handle A handle returned by <b>libr_open</b>(3).
+ * 	@param type The codec: <b>LIBR_COMPRESSED</b> (zlib, the default),
+ * 		<b>LIBR_ZSTD</b> or <b>LIBR_LZ4</b>.
+ * 	@return Returns 1 on success, 0 on failure (the codec is not
+ * 		available in this build of libr when the error is
+ * 		<b>LIBR_ERROR_NOCODEC</b>).
+ * 
+ * @section SA SEE ALSO
+ * 	<b>libr_set_policy</b>(3), <b>libr_write</b>(3)
+ * 
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+int libr_set_codec(libr_file *handle, libr_type_t type);
+
 /**
  * @page libr_size Returns the uncompressed size of a libr resource.
  * @section SYNOPSIS
@@ -380,6 +951,138 @@ unsigned int libr_resources(libr_file *handle);
  */
 int libr_size(libr_file *handle, char *resourcename, size_t *size);
 
+/**
+ * @page libr_stat Describe a libr resource without reading its data.
+ * @section SYNOPSIS
+ * 	\#include <libr.h>
+ * 	
+ * 	<b>int libr_stat(libr_file *handle, char *resourcename, libr_resource_info *info);</b>
+ *
+ * @section DESCRIPTION
+ * 	Obtain the sizes, storage type, header version, alignment and
+ * 	content digest of a libr-resource.  Only the header of the
+ * 	resource is read, so the cost does not depend on the size of the
+ * 	resource.  Resources written by older versions of libr report
+ * 	version 1, an alignment of 1 and no flags.
+ * 	
+ * 	@param handle A handle returned by <b>libr_open</b>(3).
+ * 	@param resourcename The name of the resource to describe.
+ * 	@param info A pointer for storing the description of the
+ * 		resource.  This pointer cannot be NULL.
+ * 	@return Returns 1 on success, 0 on failure. 
+ * 
+ * @section SA SEE ALSO
+ * 	<b>libr_size</b>(3), <b>libr_set_alignment</b>(3)
+ * 
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+int libr_stat(libr_file *handle, char *resourcename, libr_resource_info *info);
+
+/**
+ * @page libr_stream_close Finish reading a libr resource as a stream.
+ * @section SYNOPSIS
+ * 	\#include <libr.h>
+ * 	
+ * 	<b>void libr_stream_close(libr_stream *stream);</b>
+ *
+ * @section DESCRIPTION
+ * 	Releases a stream opened with <b>libr_stream_open</b>(3), the stream
+ * 	may be closed before all of the resource data has been read.
+ * 	
+ * 	@param stream A stream returned by <b>libr_stream_open</b>(3).
+ * 
+ * @section SA SEE ALSO
+ * 	<b>libr_stream_open</b>(3), <b>libr_stream_read</b>(3)
+ * 
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+void libr_stream_close(libr_stream *stream);
+
+/**
+ * @page libr_stream_open Start reading a libr resource as a stream.
+ * @section SYNOPSIS
+ * 	\#include <libr.h>
+ * 	
+ * 	<b>libr_stream *libr_stream_open(libr_file *handle, char *resourcename);</b>
+ *
+ * @section DESCRIPTION
+ * 	Prepares to read the data of a libr-compatible resource in pieces
+ * 	with <b>libr_stream_read</b>(3).  The stored data is read from the
+ * 	ELF binary (and uncompressed) a small chunk at a time, so the memory
+ * 	used by a stream does not depend on the size of the resource.
+ * 
+ * 	The handle must remain open, and the resource must not be changed,
+ * 	until the stream is closed with <b>libr_stream_close</b>(3).
+ * 	Resources stored with <b>LIBR_ZSTD</b> or <b>LIBR_LZ4</b> cannot be
+ * 	streamed.
+ * 	
+ * 	@param handle A handle returned by <b>libr_open</b>(3).
+ * 	@param resourcename The name of the resource to read.
+ * 	@return Returns a stream on success, NULL on failure. 
+ * 
+ * @section SA SEE ALSO
+ * 	<b>libr_stream_read</b>(3), <b>libr_stream_close</b>(3),
+ * 	<b>libr_read</b>(3)
+ * 
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+libr_stream *libr_stream_open(libr_file *handle, char *resourcename);
+
+/**
+ * @page libr_stream_read Read the next piece of a libr resource stream.
+ * @section SYNOPSIS
+ * 	\#include <libr.h>
+ * 	
+ * 	<b>size_t libr_stream_read(libr_stream *stream, char *buffer, size_t size);</b>
+ *
+ * @section DESCRIPTION
+ * 	Reads up to <i>size</i> bytes of uncompressed resource data from a
+ * 	stream opened with <b>libr_stream_open</b>(3), continuing from where
+ * 	the previous call stopped.  Fewer bytes than requested are only
+ * 	returned once the end of the resource is reached.
+ * 	
+ * 	@param stream A stream returned by <b>libr_stream_open</b>(3).
+ * 	@param buffer A buffer for storing the data.
+ * 	@param size The number of bytes available in the buffer.
+ * 	@return Returns the number of bytes stored in the buffer.  Returns 0
+ * 		at the end of the resource or on failure, use <b>libr_errno</b>(3)
+ * 		to tell the two apart. 
+ * 
+ * @section SA SEE ALSO
+ * 	<b>libr_stream_open</b>(3), <b>libr_stream_close</b>(3)
+ * 
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+size_t libr_stream_read(libr_stream *stream, char *buffer, size_t size);
+
+/**
+ * @page libr_unmap Release a zero-copy view of a libr ELF resource.
+ * @section SYNOPSIS
+ * 	\#include <libr.h>
+ * 	
+ * 	<b>int libr_unmap(libr_file *handle, const char *view);</b>
+ *
+ * @section DESCRIPTION
+ * 	Releases a view obtained with <b>libr_map</b>(3).  The memory mapping
+ * 	of the ELF binary is reference-counted, so it is removed when the last
+ * 	view of the handle is released (or when the handle is closed).
+ * 	
+ * 	@param handle The handle used to obtain the view.
+ * 	@param view The pointer returned by <b>libr_map</b>(3).
+ * 	@return Returns 1 on success, 0 on failure. 
+ * 
+ * @section SA SEE ALSO
+ * 	<b>libr_map</b>(3), <b>libr_close</b>(3)
+ * 
+ * @section AUTHOR
+ * 	Erich Hoover <ehoover@mines.edu>
+ */
+int libr_unmap(libr_file *handle, const char *view);
+
 /**
  * @page libr_write Adds a libr resource to an ELF binary.
  * @section SYNOPSIS
@@ -391,14 +1094,33 @@ int libr_size(libr_file *handle, char *resourcename, size_t *size);
  * 	Adds a libr-compatible resource into the ELF binary.  The handle
  * 	must be opened using <b>libr_open</b>(3) with either <b>LIBR_WRITE</b>
  * 	or <b>LIBR_READ_WRITE</b> access in order to add a resource.
+ * 
+ * 	When the binary already holds a resource with identical data stored
+ * 	with the same method, the new resource is written as an alias that
+ * 	shares the existing data instead of a second copy of it.  Aliases
+ * 	read exactly like any other resource, <b>libr_stat</b>(3) reports
+ * 	them with the <b>LIBR_FLAG_ALIAS</b> flag.  Resources written to a
+ * 	handle in archive mode, see <b>libr_set_archive</b>(3), are packed
+ * 	into the archive section instead and never share their data.
  * 	
  * 	@param handle A handle returned by <b>libr_open</b>(3).
  * 	@param resourcename The name of the resource to create.
  * 	@param buffer A string containing the data of the resource.
  * 	@param size The total size of the buffer.
  * 	@param type The method which should be used for storing the 
- * 		data (either <b>LIBR_UNCOMPRESSED</b> or
- * 		<b>LIBR_COMPRESSED</b>).
+ * 		data (<b>LIBR_UNCOMPRESSED</b>, <b>LIBR_COMPRESSED</b>,
+ * 		<b>LIBR_SEEKABLE</b>, <b>LIBR_ZSTD</b>, <b>LIBR_LZ4</b> or
+ * 		<b>LIBR_AUTO</b>).  <b>LIBR_AUTO</b> stores data that is
+ * 		already compressed (or that compresses poorly) uncompressed and
+ * 		compresses everything else with zlib, see
+ * 		<b>libr_set_policy</b>(3) and <b>libr_set_codec</b>(3).
+ * 		<b>LIBR_ZSTD</b> and <b>LIBR_LZ4</b> uncompress faster than
+ * 		zlib, but are only available when libr is built with the
+ * 		matching library.  <b>LIBR_SEEKABLE</b> compresses the
+ * 		data in independent blocks so that parts of it can be read
+ * 		with <b>libr_read_range</b>(3) without uncompressing the rest,
+ * 		and so that <b>libr_read</b>(3) can uncompress large resources
+ * 		on all of the available processors.
  * 	@param overwrite Whether overwriting an existing resource
  * 		should be permitted (either <b>LIBR_NOOVERWRITE</b> or
  * 		<b>LIBR_OVERWRITE</b>). 
@@ -0,0 +1,207 @@
+/*
+ *
+ *  libr name index - Hash index of section names for constant-time lookups
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "nameindex.h"
+
+/* For malloc/free */
+#include <stdlib.h>
+
+/* For string handling */
+#include <string.h>
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#define NAMEINDEX_MINSIZE 16
+
+/* Marks a slot whose entry was removed (the probe sequence continues past it) */
+static char removed_slot;
+#define REMOVED_SLOT ((void *) &removed_slot)
+
+/*
+ * Hash a section name (32-bit FNV-1a)
+ */
+uint32_t nameindex_hash(const char *name)
+{
+	uint32_t hash = 2166136261U;
+	
+	while(*name != '\0')
+	{
+		hash ^= (unsigned char) *name++;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+/*
+ * Prepare an empty index large enough for the expected number of names
+ */
+int nameindex_init(nameindex *index, unsigned long expected, int own_names)
+{
+	unsigned long size = NAMEINDEX_MINSIZE;
+	
+	/* Keep the table at most 3/4 full (the same limit that triggers growing it) */
+	while(size*3 < expected*4)
+		size *= 2;
+	index->entries = (nameindex_entry *) calloc(size, sizeof(nameindex_entry));
+	if(index->entries == NULL)
+		return FALSE;
+	index->size = size;
+	index->used = 0;
+	index->removed = 0;
+	index->own_names = own_names;
+	return TRUE;
+}
+
+/*
+ * Store an entry into the first open slot of its probe sequence
+ */
+static void nameindex_place(nameindex *index, nameindex_entry *entry)
+{
+	unsigned long mask = index->size-1, i;
+	
+	for(i = entry->hash & mask; index->entries[i].name != NULL; i = (i+1) & mask) {}
+	if(index->entries[i].value == REMOVED_SLOT)
+		index->removed--;
+	index->entries[i] = *entry;
+}
+
+/*
+ * Grow the index (also discards the slots of removed entries)
+ */
+static int nameindex_grow(nameindex *index)
+{
+	nameindex_entry *old_entries = index->entries;
+	unsigned long old_size = index->size, i;
+	
+	if(!nameindex_init(index, index->used+1, index->own_names))
+	{
+		index->entries = old_entries;
+		return FALSE;
+	}
+	for(i=0;i<old_size;i++)
+	{
+		if(old_entries[i].name == NULL)
+			continue;
+		nameindex_place(index, &old_entries[i]);
+		index->used++;
+	}
+	free(old_entries);
+	return TRUE;
+}
+
+/*
+ * Add a name to the index (the first entry added for a duplicate name wins)
+ */
+int nameindex_add(nameindex *index, const char *name, void *value)
+{
+	nameindex_entry entry;
+	
+	if(name == NULL)
+		return FALSE;
+	if(nameindex_find(index, name) != NULL)
+		return TRUE;
+	if((index->used+index->removed+1)*4 > index->size*3 && !nameindex_grow(index))
+		return FALSE;
+	entry.hash = nameindex_hash(name);
+	entry.value = value;
+	entry.name = (index->own_names ? strdup(name) : name);
+	if(entry.name == NULL)
+		return FALSE;
+	nameindex_place(index, &entry);
+	index->used++;
+	return TRUE;
+}
+
+/*
+ * Locate the slot holding a name (NULL if the name is not indexed)
+ */
+static nameindex_entry *nameindex_slot(nameindex *index, const char *name)
+{
+	unsigned long mask = index->size-1, i;
+	uint32_t hash = nameindex_hash(name);
+	
+	if(index->entries == NULL)
+		return NULL;
+	for(i = hash & mask; ; i = (i+1) & mask)
+	{
+		nameindex_entry *entry = &(index->entries[i]);
+		
+		if(entry->name == NULL)
+		{
+			if(entry->value == REMOVED_SLOT)
+				continue;
+			return NULL;
+		}
+		if(entry->hash == hash && strcmp(entry->name, name) == 0)
+			return entry;
+	}
+}
+
+/*
+ * Look up the value stored for a name
+ */
+void *nameindex_find(nameindex *index, const char *name)
+{
+	nameindex_entry *entry = nameindex_slot(index, name);
+	
+	if(entry == NULL)
+		return NULL;
+	return entry->value;
+}
+
+/*
+ * Remove a name from the index (only if it refers to the given value)
+ */
+void nameindex_remove(nameindex *index, const char *name, void *value)
+{
+	nameindex_entry *entry = nameindex_slot(index, name);
+	
+	if(entry == NULL || entry->value != value)
+		return;
+	if(index->own_names)
+		free((char *) entry->name);
+	entry->name = NULL;
+	entry->value = REMOVED_SLOT;
+	index->used--;
+	index->removed++;
+}
+
+/*
+ * Release the memory used by the index
+ */
+void nameindex_free(nameindex *index)
+{
+	unsigned long i;
+	
+	if(index->entries == NULL)
+		return;
+	if(index->own_names)
+	{
+		for(i=0;i<index->size;i++)
+			free((char *) index->entries[i].name);
+	}
+	free(index->entries);
+	memset(index, 0, sizeof(nameindex));
+}
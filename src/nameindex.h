@@ -0,0 +1,32 @@
+#ifndef __NAMEINDEX_H
+#define __NAMEINDEX_H
+
+/* For integer types with set bit-sizes */
+#include <stdint.h>
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+typedef struct {
+	const char *name;
+	uint32_t hash;
+	void *value;
+} nameindex_entry;
+
+typedef struct {
+	nameindex_entry *entries;
+	unsigned long size;
+	unsigned long used;
+	unsigned long removed;
+	int own_names;
+} nameindex;
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+uint32_t nameindex_hash(const char *name);
+int nameindex_init(nameindex *index, unsigned long expected, int own_names);
+int nameindex_add(nameindex *index, const char *name, void *value);
+void *nameindex_find(nameindex *index, const char *name);
+void nameindex_remove(nameindex *index, const char *name, void *value);
+void nameindex_free(nameindex *index);
+
+#endif /* __NAMEINDEX_H */
@@ -0,0 +1,135 @@
+/*
+ *
+ *  libr parallel - Spread independent tasks across the available processors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "parallel.h"
+
+/* For malloc/free */
+#include <stdlib.h>
+
+/* For the processor count */
+#include <unistd.h>
+
+/* For the worker threads */
+#include <pthread.h>
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+/* Queue of tasks shared by the worker threads */
+typedef struct {
+	pthread_mutex_t lock;
+	size_t next;
+	size_t tasks;
+	int failed;
+	parallel_task task;
+	void *context;
+} parallel_queue;
+
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+/* Set while the thread runs tasks of a queue, the processors are already busy with that queue */
+static __thread int in_queue = FALSE;
+
+/*
+ * Number of threads worth using for a set of tasks (one per processor, only the calling
+ * thread when the tasks are started by a task that is already running in parallel)
+ */
+unsigned int parallel_workers(size_t tasks)
+{
+	long processors = sysconf(_SC_NPROCESSORS_ONLN);
+	
+	if(in_queue)
+		return 1;
+	if(processors < 1)
+		processors = 1;
+	if((size_t) processors > tasks)
+		processors = (tasks == 0 ? 1 : tasks);
+	return (unsigned int) processors;
+}
+
+/*
+ * Take tasks from the queue until it is empty (or a task has failed)
+ */
+static void *parallel_worker(void *_queue)
+{
+	parallel_queue *queue = (parallel_queue *) _queue;
+	int nested = in_queue;
+	size_t task;
+	
+	in_queue = TRUE;
+	while(TRUE)
+	{
+		pthread_mutex_lock(&queue->lock);
+		if(queue->failed || queue->next == queue->tasks)
+		{
+			pthread_mutex_unlock(&queue->lock);
+			break;
+		}
+		task = queue->next++;
+		pthread_mutex_unlock(&queue->lock);
+		if(!queue->task(queue->context, task))
+		{
+			pthread_mutex_lock(&queue->lock);
+			queue->failed = TRUE;
+			pthread_mutex_unlock(&queue->lock);
+		}
+	}
+	in_queue = nested;
+	return NULL;
+}
+
+/*
+ * Run tasks 0 to tasks-1 on a pool of threads (the calling thread is one of them),
+ * returns TRUE only if every task succeeded
+ */
+int parallel_run(size_t tasks, parallel_task task, void *context)
+{
+	unsigned int workers = parallel_workers(tasks), started = 0, i;
+	pthread_t *threads = NULL;
+	parallel_queue queue;
+	
+	queue.next = 0;
+	queue.tasks = tasks;
+	queue.failed = FALSE;
+	queue.task = task;
+	queue.context = context;
+	pthread_mutex_init(&queue.lock, NULL);
+	if(workers > 1 && (threads = (pthread_t *) malloc((workers-1)*sizeof(pthread_t))) != NULL)
+	{
+		/* If a thread cannot be started then the remaining threads simply take more tasks */
+		for(i = 0; i < workers-1; i++)
+		{
+			if(pthread_create(&threads[started], NULL, parallel_worker, &queue) == 0)
+				started++;
+		}
+	}
+	parallel_worker(&queue);
+	for(i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+	pthread_mutex_destroy(&queue.lock);
+	return !queue.failed;
+}
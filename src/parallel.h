@@ -0,0 +1,13 @@
+#ifndef __PARALLEL_H
+#define __PARALLEL_H
+
+/* For size_t */
+#include <stddef.h>
+
+/* Runs one task (returns false to abandon the remaining tasks) */
+typedef int (*parallel_task)(void *context, size_t task);
+
+unsigned int parallel_workers(size_t tasks);
+int parallel_run(size_t tasks, parallel_task task, void *context);
+
+#endif /* __PARALLEL_H */
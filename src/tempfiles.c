@@ -42,6 +42,9 @@
 #include <sys/types.h>
 #include <errno.h>
 
+/* For guarding the cleanup lists */
+#include <pthread.h>
+
 #ifndef FALSE
 #define FALSE 0
 #endif
@@ -66,6 +69,9 @@ typedef struct CLEANUPHANDLE {
 } CleanupHandle;
 CleanupHandle *handles_to_remove = NULL;
 
+/* Handles and folders may be registered by several threads at once */
+static pthread_mutex_t cleanup_lock = PTHREAD_MUTEX_INITIALIZER;
+
 #endif /* DOXYGEN_SHOULD_SKIP_THIS */
 
 /*
@@ -77,6 +83,7 @@ void register_folder_cleanup(char *temp_folder)
 	
 	folder->folder = strdup(temp_folder);
 	folder->next = NULL;
+	pthread_mutex_lock(&cleanup_lock);
 	if(folders_to_remove != NULL)
 	{
 		CleanupFolder *f;
@@ -86,6 +93,7 @@ void register_folder_cleanup(char *temp_folder)
 	}
 	else
 		folders_to_remove = folder;
+	pthread_mutex_unlock(&cleanup_lock);
 }
 
 /*
@@ -98,6 +106,7 @@ void register_handle_cleanup(libr_file *handle)
 	h->handle = handle;
 	h->internal = FALSE;
 	h->next = NULL;
+	pthread_mutex_lock(&cleanup_lock);
 	if(handles_to_remove != NULL)
 	{
 		CleanupHandle *i;
@@ -107,6 +116,7 @@ void register_handle_cleanup(libr_file *handle)
 	}
 	else
 		handles_to_remove = h;
+	pthread_mutex_unlock(&cleanup_lock);
 }
 
 /*
@@ -116,9 +126,11 @@ void unregister_handle_cleanup(libr_file *handle)
 {
 	CleanupHandle *i, *last = NULL;
 	int found = FALSE;
-
+	
+	pthread_mutex_lock(&cleanup_lock);
 	if(handles_to_remove == NULL)
 	{
+		pthread_mutex_unlock(&cleanup_lock);
 		printf("Unregistering handle with no list of cleanup handles!\n");
 		return;
 	}
@@ -135,6 +147,7 @@ void unregister_handle_cleanup(libr_file *handle)
 			break;
 		}
 	}
+	pthread_mutex_unlock(&cleanup_lock);
 	if(!found)
 		printf("Could not find handle to remove from cleanup list!\n");
 }
@@ -146,9 +159,11 @@ void register_internal_handle(libr_file *handle)
 {
 	int found = FALSE;
 	CleanupHandle *i;
-
+	
+	pthread_mutex_lock(&cleanup_lock);
 	if(handles_to_remove == NULL)
 	{
+		pthread_mutex_unlock(&cleanup_lock);
 		printf("No cleanup list!\n");
 		return;
 	}
@@ -161,6 +176,7 @@ void register_internal_handle(libr_file *handle)
 			break;
 		}
 	}
+	pthread_mutex_unlock(&cleanup_lock);
 	if(!found)
 		printf("Could not find handle in cleanup list!\n");
 }
@@ -258,6 +274,24 @@ int make_valid_path(char *out_path, size_t maxpath, char *start_folder, char *re
 	return true;
 }
 
+/*
+ * Open the resources of the calling program, in memory when they were linked in and from its
+ * file otherwise (or when the linked resources lack "resource_name", NULL asks for any resource)
+ */
+libr_file *open_program_resources(char *resource_name)
+{
+	libr_file *handle;
+	size_t size;
+	
+	if((handle = libr_open_self_mapped()) != NULL)
+	{
+		if(resource_name == NULL ? libr_resources(handle) != 0 : libr_size(handle, resource_name, &size))
+			return handle;
+		libr_close(handle);
+	}
+	return libr_open(NULL, LIBR_READ);
+}
+
 /*
  * Extract all the resources from the ELF file for use by the resource loader
  */
@@ -265,7 +299,7 @@ char *libr_extract_resources(libr_file *handle)
 {
 	char *temp_mask = strdup(LIBR_TEMPFILE);
 	char *temp_folder;
-	int i = 0;
+	libr_iter iter;
 	
 	temp_folder = mkdtemp(temp_mask);
 	if(temp_folder == NULL)
@@ -274,9 +308,15 @@ char *libr_extract_resources(libr_file *handle)
 		goto failed;
 	}
 	/* If this library cannot dynamically load resources then pull out all the resources to a temporary directory */
-	for(i=0;i<libr_resources(handle);i++)
+	if(!libr_iter_begin(handle, &iter))
+	{
+		cleanup_folder(temp_folder);
+		temp_folder = NULL;
+		goto failed;
+	}
+	while(libr_iter_next(&iter))
 	{
-		char *resource_name = libr_list(handle, i);
+		char *resource_name = (char *) iter.name;
 		char *file_path[PATH_MAX];
 		size_t resource_size;
 		FILE *file_handle;
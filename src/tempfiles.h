@@ -9,5 +9,6 @@ void unregister_handle_cleanup(libr_file *handle);
 void register_internal_handle(libr_file *handle);
 void register_folder_cleanup(char *temp_folder);
 char *libr_extract_resources(libr_file *handle);
+libr_file *open_program_resources(char *resource_name);
 
 #endif /* __TEMPFILES_H */
@@ -0,0 +1,104 @@
+/*
+ *
+ *  libr alias test - Share the data of identical resources
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "test-common.h"
+
+/* For malloc/free */
+#include <stdlib.h>
+
+/* For checking the alignment of mapped data */
+#include <stdint.h>
+
+#define TEST_COPY                "test-alias.elf"
+#define DATA_SIZE                ((size_t) 100*1024)
+#define ALIGNMENT                ((size_t) 4096)
+
+/*
+ * Check whether a resource shares the data of another one
+ */
+static int is_alias(libr_file *handle, const char *name)
+{
+	libr_resource_info info;
+	
+	return (libr_stat(handle, (char *) name, &info) && (info.flags & LIBR_FLAG_ALIAS) != 0);
+}
+
+int main(void)
+{
+	char *data, *other;
+	libr_file *handle;
+	const char *view;
+	
+	handle = open_copy(TEST_COPY);
+	if((data = (char *) malloc(DATA_SIZE)) == NULL || (other = (char *) malloc(DATA_SIZE)) == NULL)
+		return 1;
+	fill_data(data, DATA_SIZE, 0);
+	fill_data(other, DATA_SIZE, 1);
+	check(libr_write(handle, "plain", data, DATA_SIZE, LIBR_UNCOMPRESSED, LIBR_NOOVERWRITE), "write", "plain");
+	check(libr_write(handle, "plain-copy", data, DATA_SIZE, LIBR_UNCOMPRESSED, LIBR_NOOVERWRITE), "write", "plain-copy");
+	check(libr_write(handle, "zlib", other, DATA_SIZE, LIBR_COMPRESSED, LIBR_NOOVERWRITE), "write", "zlib");
+	check(libr_write(handle, "zlib-copy", other, DATA_SIZE, LIBR_COMPRESSED, LIBR_NOOVERWRITE), "write", "zlib-copy");
+	/* The same data stored another way is not shared */
+	check(libr_write(handle, "zlib-plain", other, DATA_SIZE, LIBR_UNCOMPRESSED, LIBR_NOOVERWRITE), "write", "zlib-plain");
+	/* Nor is data that would not be aligned to the boundary asked for */
+	check(libr_set_alignment(handle, ALIGNMENT), "alignment", TEST_COPY);
+	check(libr_write(handle, "aligned", data, DATA_SIZE, LIBR_UNCOMPRESSED, LIBR_NOOVERWRITE), "write", "aligned");
+	check(libr_write(handle, "aligned-copy", data, DATA_SIZE, LIBR_UNCOMPRESSED, LIBR_NOOVERWRITE), "write", "aligned-copy");
+	check(libr_set_alignment(handle, 1), "alignment", TEST_COPY);
+	/* Data shorter than the name it would point at is stored again */
+	check(libr_write(handle, "tiny", "abc", 3, LIBR_UNCOMPRESSED, LIBR_NOOVERWRITE), "write", "tiny");
+	check(libr_write(handle, "tiny-copy", "abc", 3, LIBR_UNCOMPRESSED, LIBR_NOOVERWRITE), "write", "tiny-copy");
+	check(libr_errno() == LIBR_OK, "status", "tiny-copy");
+	libr_close(handle);
+	
+	handle = reopen_copy(TEST_COPY);
+	check(!is_alias(handle, "plain") && is_alias(handle, "plain-copy"), "alias", "plain-copy");
+	check(!is_alias(handle, "zlib") && is_alias(handle, "zlib-copy"), "alias", "zlib-copy");
+	check(!is_alias(handle, "zlib-plain"), "no alias", "zlib-plain");
+	check(!is_alias(handle, "aligned") && is_alias(handle, "aligned-copy"), "alias", "aligned-copy");
+	check(!is_alias(handle, "tiny-copy"), "no alias", "tiny-copy");
+	check_data(handle, "plain-copy", data, DATA_SIZE);
+	check_data(handle, "zlib-copy", other, DATA_SIZE);
+	check_data(handle, "tiny-copy", "abc", 3);
+	/* An alias maps to the shared data, on the boundary it was written with */
+	view = libr_map(handle, "aligned-copy", NULL);
+	check(view != NULL && ((uintptr_t) view % ALIGNMENT) == 0, "aligned map", "aligned-copy");
+	if(view != NULL)
+		libr_unmap(handle, view);
+	libr_close(handle);
+	
+	/* Removing the resource holding the data hands it to an alias */
+	if((handle = libr_open(TEST_COPY, LIBR_READ_WRITE)) == NULL)
+		check(0, "open", TEST_COPY);
+	else
+	{
+		check(libr_clear(handle, "plain"), "clear", "plain");
+		check(libr_write(handle, "zlib", data, DATA_SIZE, LIBR_COMPRESSED, LIBR_OVERWRITE), "over-write", "zlib");
+		libr_close(handle);
+	}
+	handle = reopen_copy(TEST_COPY);
+	check_data(handle, "plain-copy", data, DATA_SIZE);
+	check_data(handle, "zlib-copy", other, DATA_SIZE);
+	check_data(handle, "zlib", data, DATA_SIZE);
+	libr_close(handle);
+	free(other);
+	free(data);
+	return finish(TEST_COPY);
+}
@@ -0,0 +1,109 @@
+/*
+ *
+ *  libr archive test - Pack many small resources into one section
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "test-common.h"
+
+/* For free */
+#include <stdlib.h>
+
+/* For printing the resource names */
+#include <stdio.h>
+
+/* For string handling */
+#include <string.h>
+
+#define TEST_COPY                "test-archive.elf"
+#define ASSETS                   2000
+#define ASSET_SIZE(i)            ((size_t) 16+(i)%300)
+#define NAME_SIZE                32
+
+/*
+ * Name and contents of one of the archived assets
+ */
+static void make_asset(unsigned int i, char *name, char *data)
+{
+	snprintf(name, NAME_SIZE, "assets/%04u", i);
+	fill_data(data, ASSET_SIZE(i), i);
+}
+
+int main(void)
+{
+	char name[NAME_SIZE], data[ASSET_SIZE(299)], other[ASSET_SIZE(299)];
+	unsigned int i, listed;
+	libr_file *handle;
+	char *listname;
+	
+	handle = open_copy(TEST_COPY);
+	check(libr_set_archive(handle, 1), "archive", TEST_COPY);
+	for(i = 0; i < ASSETS; i++)
+	{
+		make_asset(i, name, data);
+		check(libr_write(handle, name, data, ASSET_SIZE(i), (i % 2 ? LIBR_COMPRESSED : LIBR_UNCOMPRESSED), LIBR_NOOVERWRITE), "write", name);
+	}
+	check(!libr_write(handle, "assets/0000", data, 16, LIBR_UNCOMPRESSED, LIBR_NOOVERWRITE)
+		&& libr_errno() == LIBR_ERROR_OVERWRITE, "over-write", "assets/0000");
+	/* Resources outside the archive live alongside it */
+	check(libr_set_archive(handle, 0), "archive", TEST_COPY);
+	fill_data(other, sizeof(other), 7);
+	check(libr_write(handle, "outside", other, sizeof(other), LIBR_UNCOMPRESSED, LIBR_NOOVERWRITE), "write", "outside");
+	libr_close(handle);
+	check(libr_errno() == LIBR_OK, "close", TEST_COPY);
+	
+	handle = reopen_copy(TEST_COPY);
+	check(libr_resources(handle) == ASSETS+1, "resource count", TEST_COPY);
+	for(i = 0; i < ASSETS; i++)
+	{
+		make_asset(i, name, data);
+		check_data(handle, name, data, ASSET_SIZE(i));
+	}
+	check_data(handle, "outside", other, sizeof(other));
+	listed = 0;
+	for(i = 0; i < libr_resources(handle); i++)
+	{
+		if((listname = libr_list(handle, i)) == NULL)
+			continue;
+		listed += (strncmp(listname, "assets/", 7) == 0);
+		free(listname);
+	}
+	check(listed == ASSETS, "list", TEST_COPY);
+	libr_close(handle);
+	
+	/* Archived resources are replaced and removed by handles not in archive mode */
+	if((handle = libr_open(TEST_COPY, LIBR_READ_WRITE)) == NULL)
+		check(0, "open", TEST_COPY);
+	else
+	{
+		check(libr_write(handle, "assets/0001", other, sizeof(other), LIBR_COMPRESSED, LIBR_OVERWRITE), "over-write", "assets/0001");
+		check(libr_clear(handle, "assets/0002"), "clear", "assets/0002");
+		check(libr_set_archive(handle, 1), "archive", TEST_COPY);
+		check(libr_write(handle, "assets/new", other, sizeof(other), LIBR_UNCOMPRESSED, LIBR_NOOVERWRITE), "write", "assets/new");
+		libr_close(handle);
+		check(libr_errno() == LIBR_OK, "close", TEST_COPY);
+	}
+	handle = reopen_copy(TEST_COPY);
+	check(libr_resources(handle) == ASSETS+1, "resource count", TEST_COPY);
+	check_data(handle, "assets/0001", other, sizeof(other));
+	check(!libr_size(handle, "assets/0002", NULL) && libr_errno() == LIBR_ERROR_NOSECTION, "cleared", "assets/0002");
+	check_data(handle, "assets/new", other, sizeof(other));
+	make_asset(ASSETS-1, name, data);
+	check_data(handle, name, data, ASSET_SIZE(ASSETS-1));
+	libr_close(handle);
+	return finish(TEST_COPY);
+}
@@ -0,0 +1,81 @@
+/*
+ *
+ *  libr batch test - Stage changes with libr_begin and write them with libr_commit
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "test-common.h"
+
+/* For malloc/free */
+#include <stdlib.h>
+
+/* For checking that discarded sources are not written */
+#include <unistd.h>
+
+#define TEST_COPY                "test-batch.elf"
+#define TEST_SOURCE              "test-batch.S"
+#define DATA_SIZE                ((size_t) 64*1024)
+
+int main(void)
+{
+	char *data, *other;
+	libr_file *handle;
+	size_t size;
+	
+	handle = open_copy(TEST_COPY);
+	if((data = (char *) malloc(DATA_SIZE)) == NULL || (other = (char *) malloc(DATA_SIZE)) == NULL)
+		return 1;
+	fill_data(data, DATA_SIZE, 0);
+	fill_data(other, DATA_SIZE, 1);
+	/* Additions, an over-write and a removal are written out in one go */
+	check(libr_begin(handle), "begin", TEST_COPY);
+	check(libr_write(handle, "first", data, DATA_SIZE, LIBR_COMPRESSED, LIBR_NOOVERWRITE), "write", "first");
+	check(libr_write(handle, "second", data, DATA_SIZE, LIBR_UNCOMPRESSED, LIBR_NOOVERWRITE), "write", "second");
+	check(libr_write(handle, "third", other, DATA_SIZE, LIBR_COMPRESSED, LIBR_NOOVERWRITE), "write", "third");
+	check(libr_write(handle, "first", other, DATA_SIZE, LIBR_COMPRESSED, LIBR_OVERWRITE), "over-write", "first");
+	check(libr_clear(handle, "second"), "clear", "second");
+	check(libr_commit(handle), "commit", TEST_COPY);
+	/* Changes after the commit are written as they are made */
+	check(libr_write(handle, "fourth", data, DATA_SIZE, LIBR_COMPRESSED, LIBR_NOOVERWRITE), "write", "fourth");
+	/* Only the resources collected for linking can be discarded */
+	check(!libr_discard(handle), "discard", TEST_COPY);
+	libr_close(handle);
+	check(libr_errno() == LIBR_OK, "close", TEST_COPY);
+	
+	handle = reopen_copy(TEST_COPY);
+	check_data(handle, "first", other, DATA_SIZE);
+	check(!libr_size(handle, "second", &size) && libr_errno() == LIBR_ERROR_NOSECTION, "removal", "second");
+	check_data(handle, "third", other, DATA_SIZE);
+	check_data(handle, "fourth", data, DATA_SIZE);
+	check(libr_resources(handle) == 3, "resource count", TEST_COPY);
+	libr_close(handle);
+	
+	/* Discarded resources for linking leave no source behind */
+	unlink(TEST_SOURCE);
+	if((handle = libr_open_embed(TEST_SOURCE)) == NULL)
+		check(0, "open", TEST_SOURCE);
+	else
+	{
+		check(libr_write(handle, "first", data, DATA_SIZE, LIBR_COMPRESSED, LIBR_NOOVERWRITE), "write", TEST_SOURCE);
+		check(libr_discard(handle), "discard", TEST_SOURCE);
+		libr_close(handle);
+		check(access(TEST_SOURCE, F_OK) != 0, "discarded source", TEST_SOURCE);
+	}
+	free(other);
+	free(data);
+	return finish(TEST_COPY);
+}
@@ -0,0 +1,144 @@
+/*
+ *
+ *  libr codec test - Write and read back resources with every codec of the build
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+/*
+ * Builds of libr without zstd or lz4 refuse those codecs with LIBR_ERROR_NOCODEC, which the test
+ * accepts in place of the resource.  Resources written with LIBR_AUTO are told apart by whether
+ * they can be mapped (only uncompressed resources can).
+ */
+
+#include "test-common.h"
+
+/* For malloc/free */
+#include <stdlib.h>
+
+/* For string handling */
+#include <string.h>
+
+#define TEST_COPY                "test-codecs.elf"
+#define DATA_SIZE                ((size_t) 300*1024)
+#define RANGE_OFFSET             ((size_t) 150*1024-7)
+#define RANGE_SIZE               ((size_t) 5000)
+
+static const struct {
+	const char *name;
+	libr_type_t type;
+} stored[] = {
+	{"zstd", LIBR_ZSTD},
+	{"lz4", LIBR_LZ4},
+};
+
+/*
+ * Fill a buffer with data that does not compress
+ */
+static void fill_random(char *data, size_t size)
+{
+	unsigned long state = 12345;
+	size_t i;
+	
+	for(i = 0; i < size; i++)
+	{
+		state = state*1103515245+12345;
+		data[i] = (char) (state >> 16);
+	}
+}
+
+/*
+ * Check whether a resource was stored uncompressed (and reads back correctly)
+ */
+static int stored_plain(libr_file *handle, const char *name, const char *data, size_t size)
+{
+	const char *view;
+	
+	check_data(handle, name, data, size);
+	if((view = libr_map(handle, (char *) name, NULL)) == NULL)
+		return 0;
+	libr_unmap(handle, view);
+	return 1;
+}
+
+int main(void)
+{
+	int written[sizeof(stored)/sizeof(stored[0])];
+	const char png[] = "\x89PNG\r\n\x1a\n";
+	char *data, *other, *buffer, *noise;
+	libr_stream *stream;
+	libr_file *handle;
+	int zstd_auto;
+	size_t i, size;
+	
+	handle = open_copy(TEST_COPY);
+	if((data = (char *) malloc(DATA_SIZE)) == NULL || (buffer = (char *) malloc(RANGE_SIZE)) == NULL
+		|| (other = (char *) malloc(DATA_SIZE)) == NULL || (noise = (char *) malloc(DATA_SIZE)) == NULL)
+		return 1;
+	fill_data(data, DATA_SIZE, 0);
+	fill_data(other, DATA_SIZE, 1);
+	fill_random(noise, DATA_SIZE);
+	for(i = 0; i < sizeof(stored)/sizeof(stored[0]); i++)
+	{
+		written[i] = libr_write(handle, (char *) stored[i].name, data, DATA_SIZE, stored[i].type, LIBR_NOOVERWRITE);
+		check(written[i] || libr_errno() == LIBR_ERROR_NOCODEC, "write", stored[i].name);
+	}
+	check(!libr_write(handle, "unknown", data, DATA_SIZE, (libr_type_t) 99, LIBR_NOOVERWRITE), "write", "unknown");
+	/* LIBR_AUTO compresses what pays off and leaves compressed formats and noise alone */
+	check(libr_write(handle, "auto/text", data, DATA_SIZE, LIBR_AUTO, LIBR_NOOVERWRITE), "write", "auto/text");
+	check(libr_write(handle, "auto/noise", noise, DATA_SIZE, LIBR_AUTO, LIBR_NOOVERWRITE), "write", "auto/noise");
+	memcpy(noise, png, sizeof(png)-1);
+	check(libr_write(handle, "auto/png", noise, DATA_SIZE, LIBR_AUTO, LIBR_NOOVERWRITE), "write", "auto/png");
+	check(!libr_set_policy(handle, 101, 0), "policy", TEST_COPY);
+	check(libr_set_policy(handle, 10, 0), "policy", TEST_COPY);
+	/* The automatic codec can be changed, as long as the build has it */
+	zstd_auto = libr_set_codec(handle, LIBR_ZSTD);
+	check(zstd_auto || libr_errno() == LIBR_ERROR_NOCODEC, "codec", "zstd");
+	check(!libr_set_codec(handle, LIBR_UNCOMPRESSED), "codec", "uncompressed");
+	check(libr_write(handle, "auto/codec", other, DATA_SIZE, LIBR_AUTO, LIBR_NOOVERWRITE), "write", "auto/codec");
+	libr_close(handle);
+	
+	handle = reopen_copy(TEST_COPY);
+	for(i = 0; i < sizeof(stored)/sizeof(stored[0]); i++)
+	{
+		if(!written[i])
+		{
+			check(!libr_size(handle, (char *) stored[i].name, &size) && libr_errno() == LIBR_ERROR_NOSECTION, "missing", stored[i].name);
+			continue;
+		}
+		check_data(handle, stored[i].name, data, DATA_SIZE);
+		check(libr_read_range(handle, (char *) stored[i].name, RANGE_OFFSET, RANGE_SIZE, buffer)
+			&& memcmp(buffer, &data[RANGE_OFFSET], RANGE_SIZE) == 0, "range", stored[i].name);
+		/* These codecs have no streaming reader */
+		check(libr_stream_open(handle, (char *) stored[i].name) == NULL, "stream open", stored[i].name);
+	}
+	check(!stored_plain(handle, "auto/codec", other, DATA_SIZE), "compression", "auto/codec");
+	/* Resources compressed with zstd cannot be streamed, the ones compressed with zlib can */
+	stream = libr_stream_open(handle, "auto/codec");
+	check((stream == NULL) == zstd_auto, "stream open", "auto/codec");
+	if(stream != NULL)
+		libr_stream_close(stream);
+	check(!stored_plain(handle, "auto/text", data, DATA_SIZE), "compression", "auto/text");
+	check(stored_plain(handle, "auto/png", noise, DATA_SIZE), "no compression", "auto/png");
+	fill_random(noise, DATA_SIZE);
+	check(stored_plain(handle, "auto/noise", noise, DATA_SIZE), "no compression", "auto/noise");
+	libr_close(handle);
+	free(noise);
+	free(other);
+	free(buffer);
+	free(data);
+	return finish(TEST_COPY);
+}
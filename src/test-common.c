@@ -0,0 +1,174 @@
+/*
+ *
+ *  libr test helpers - Checks shared by the tests run by "make check"
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+/*
+ * The tests write their resources to a copy of the test program itself (every backend can open
+ * it) and read them back through a new handle.  Backends that cannot write skip those tests.
+ */
+
+#include "test-common.h"
+
+/* For malloc/free and exit */
+#include <stdlib.h>
+
+/* For printing failures */
+#include <stdio.h>
+
+/* For string handling */
+#include <string.h>
+
+/* For copying the program */
+#include <fcntl.h>
+#include <unistd.h>
+
+int failures = 0;
+
+/*
+ * Report a failed check along with the last libr error
+ */
+void check(int passed, const char *what, const char *name)
+{
+	if(passed)
+		return;
+	fprintf(stderr, "FAIL: %s of \"%s\" (%s)\n", what, name, libr_errmsg());
+	failures++;
+}
+
+/*
+ * Fill a buffer with data that compresses well without being a single repeated byte
+ */
+void fill_data(char *data, size_t size, unsigned int seed)
+{
+	const char text[] = "libr resources survive a round trip through the binary. ";
+	size_t i;
+	
+	for(i = 0; i < size; i++)
+		data[i] = text[(i+seed) % (sizeof(text)-1)] ^ (char) ((i/4096) & 7);
+}
+
+/*
+ * Copy the running program, the resources are written to the copy
+ */
+static int copy_self(const char *output)
+{
+	int input_fd, output_fd, ok = 1;
+	char buffer[4096];
+	ssize_t n;
+	
+	if((input_fd = open("/proc/self/exe", O_RDONLY)) < 0)
+		return 0;
+	if((output_fd = open(output, O_WRONLY|O_CREAT|O_TRUNC, 0755)) < 0)
+	{
+		close(input_fd);
+		return 0;
+	}
+	while(ok && (n = read(input_fd, buffer, sizeof(buffer))) > 0)
+		ok = (write(output_fd, buffer, n) == n);
+	close(input_fd);
+	ok &= (close(output_fd) == 0);
+	return ok;
+}
+
+/*
+ * Open a new copy of the test program for writing (the test is skipped when the backend cannot write)
+ */
+libr_file *open_copy(const char *copy)
+{
+	libr_file *handle;
+	
+	if(!copy_self(copy))
+	{
+		perror(copy);
+		exit(1);
+	}
+	if((handle = libr_open((char *) copy, LIBR_READ_WRITE)) != NULL)
+		return handle;
+	unlink(copy);
+	if(libr_errno() == LIBR_ERROR_UNSUPPORTED)
+	{
+		printf("SKIP: the backend cannot write resources\n");
+		exit(TEST_SKIP);
+	}
+	check(0, "open", copy);
+	exit(1);
+}
+
+/*
+ * Open the copy again for reading the resources written to it
+ */
+libr_file *reopen_copy(const char *copy)
+{
+	libr_file *handle;
+	
+	if((handle = libr_open((char *) copy, LIBR_READ)) != NULL)
+		return handle;
+	check(0, "open", copy);
+	unlink(copy);
+	exit(1);
+}
+
+/*
+ * Check a resource against the data it was written with
+ */
+void check_data(libr_file *handle, const char *name, const char *data, size_t size)
+{
+	size_t length = 0;
+	char *buffer;
+	
+	check(libr_size(handle, (char *) name, &length) && length == size, "size", name);
+	buffer = libr_malloc(handle, (char *) name, &length);
+	check(buffer != NULL && length == size && memcmp(buffer, data, size) == 0, "read", name);
+	free(buffer);
+}
+
+/*
+ * Read a file from the source directory
+ */
+char *load_file(const char *name, size_t *size)
+{
+	char path[4096], *buffer;
+	FILE *file;
+	long length;
+	
+	snprintf(path, sizeof(path), "%s/%s", TEST_SRCDIR, name);
+	if((file = fopen(path, "rb")) == NULL)
+		return NULL;
+	if(fseek(file, 0, SEEK_END) != 0 || (length = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0
+		|| (buffer = (char *) malloc(length+1)) == NULL)
+	{
+		fclose(file);
+		return NULL;
+	}
+	*size = fread(buffer, 1, length, file);
+	fclose(file);
+	return buffer;
+}
+
+/*
+ * Remove the copy (if any) and report the result of the test
+ */
+int finish(const char *copy)
+{
+	if(copy != NULL)
+		unlink(copy);
+	if(failures != 0)
+		fprintf(stderr, "%d checks failed\n", failures);
+	return (failures == 0 ? 0 : 1);
+}
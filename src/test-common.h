@@ -0,0 +1,22 @@
+#ifndef __TEST_COMMON_H
+#define __TEST_COMMON_H
+
+#include "libr.h"
+
+/* For size_t */
+#include <stddef.h>
+
+/* Exit status telling "make check" that a test was skipped */
+#define TEST_SKIP                77
+
+extern int failures;
+
+void check(int passed, const char *what, const char *name);
+void fill_data(char *data, size_t size, unsigned int seed);
+libr_file *open_copy(const char *copy);
+libr_file *reopen_copy(const char *copy);
+void check_data(libr_file *handle, const char *name, const char *data, size_t size);
+char *load_file(const char *name, size_t *size);
+int finish(const char *copy);
+
+#endif /* __TEST_COMMON_H */
@@ -0,0 +1,104 @@
+/*
+ *
+ *  libr embed test - Read back the resources linked in by libr-embed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+/*
+ * Run by "make check": the files listed in test-embed.list are compressed by libr-embed into an
+ * object linked into the test program, which reads them back from memory with
+ * libr_open_self_mapped and from its own file with libr_open and compares them with the files.
+ * Systems that cannot find the loaded resources skip the test.
+ */
+
+#include "test-common.h"
+
+/* For free */
+#include <stdlib.h>
+
+/* For printing the skip message */
+#include <stdio.h>
+
+/* For string handling */
+#include <string.h>
+
+/* The resources of test-embed.list and the files they were made from */
+static const struct {
+	const char *name;
+	const char *path;
+} embedded[] = {
+	{"docs/api", "libr.h"},
+	{"header", "libr-resource.h"},
+};
+
+/*
+ * Compare the resources of a handle with the files they were made from
+ */
+static void check_handle(libr_file *handle, const char *label)
+{
+	size_t i, size, length;
+	char *buffer, *data;
+	libr_iter iter;
+	
+	for(i = 0; i < sizeof(embedded)/sizeof(embedded[0]); i++)
+	{
+		size = length = 0;
+		data = load_file(embedded[i].path, &size);
+		check(data != NULL, "load", embedded[i].path);
+		check(libr_size(handle, (char *) embedded[i].name, &length) && length == size, "size", embedded[i].name);
+		buffer = libr_malloc(handle, (char *) embedded[i].name, &length);
+		check(buffer != NULL && data != NULL && length == size && memcmp(buffer, data, size) == 0, "read", embedded[i].name);
+		free(buffer);
+		free(data);
+	}
+	/* The archive is sorted by name */
+	i = 0;
+	check(libr_iter_begin(handle, &iter), "iterate", label);
+	while(libr_iter_next(&iter))
+	{
+		check(i < sizeof(embedded)/sizeof(embedded[0]) && strcmp(iter.name, embedded[i].name) == 0, "listing", iter.name);
+		i++;
+	}
+	check(i == sizeof(embedded)/sizeof(embedded[0]), "resource count", label);
+}
+
+int main(void)
+{
+	libr_file *handle;
+	
+	if((handle = libr_open_self_mapped()) == NULL)
+	{
+		if(libr_errno() == LIBR_ERROR_UNSUPPORTED)
+		{
+			printf("SKIP: the resources loaded with a program cannot be found on this system\n");
+			return TEST_SKIP;
+		}
+		check(0, "open", "self");
+		return 1;
+	}
+	check_handle(handle, "self");
+	libr_close(handle);
+	/* The same archive is found in the section of the program's file */
+	if((handle = libr_open(NULL, LIBR_READ)) == NULL)
+		check(0, "open", "file");
+	else
+	{
+		check_handle(handle, "file");
+		libr_close(handle);
+	}
+	return finish(NULL);
+}
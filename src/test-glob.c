@@ -0,0 +1,109 @@
+/*
+ *
+ *  libr glob test - List the resources matching a pattern
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "test-common.h"
+
+/* For string handling */
+#include <string.h>
+
+#define TEST_COPY                "test-glob.elf"
+
+static const char *names[] = {
+	"locale/de/app.mo", "locale/de/LC_MESSAGES/app.mo", "locale/en/app.mo",
+	"locale/fr/app.mo", "locale/fr/extra.mo", "theme/dark.css", "theme/light.css",
+	"localeless", "icon.png",
+};
+
+/* Matches expected from a query, with the last name seen to check the order */
+typedef struct {
+	int count;
+	int limit;
+	int sorted;
+	char last[64];
+} glob_result;
+
+/*
+ * Count the matching resources, stopping once the limit (if any) is reached
+ */
+static int count_match(libr_file *handle, const char *name, void *data)
+{
+	glob_result *result = (glob_result *) data;
+	
+	if(result->count != 0 && strcmp(result->last, name) >= 0)
+		result->sorted = 0;
+	strncpy(result->last, name, sizeof(result->last)-1);
+	result->count++;
+	return (result->limit == 0 || result->count < result->limit);
+}
+
+/*
+ * Check the number of resources matching a pattern and the order they were listed in
+ */
+static void check_glob(libr_file *handle, const char *pattern, int expected, int limit)
+{
+	glob_result result;
+	
+	memset(&result, 0, sizeof(result));
+	result.limit = limit;
+	result.sorted = 1;
+	check(libr_glob(handle, pattern, count_match, &result), "glob", pattern);
+	check(result.count == expected, "match count", pattern);
+	check(result.sorted, "match order", pattern);
+}
+
+/*
+ * Run every query against a handle, from the names it wrote or read back
+ */
+static void check_queries(libr_file *handle)
+{
+	check_glob(handle, "locale/de/*", 1, 0);
+	check_glob(handle, "locale/*/app.mo", 3, 0);
+	check_glob(handle, "locale/*/*.mo", 4, 0);
+	check_glob(handle, "locale*", 1, 0);
+	check_glob(handle, "theme/*.css", 2, 0);
+	check_glob(handle, "*", 2, 0);
+	check_glob(handle, "*/*", 2, 0);
+	check_glob(handle, "locale/?e/app.mo", 1, 0);
+	check_glob(handle, "locale/[de]*/app.mo", 2, 0);
+	check_glob(handle, "icon.png", 1, 0);
+	check_glob(handle, "nothing/*", 0, 0);
+	check_glob(handle, "locale/*/*", 2, 2);
+}
+
+int main(void)
+{
+	libr_file *handle;
+	size_t i;
+	
+	handle = open_copy(TEST_COPY);
+	for(i = 0; i < sizeof(names)/sizeof(names[0]); i++)
+	{
+		check(libr_set_archive(handle, (i % 2)), "archive", names[i]);
+		check(libr_write(handle, (char *) names[i], (char *) names[i], strlen(names[i]), LIBR_UNCOMPRESSED, LIBR_NOOVERWRITE), "write", names[i]);
+	}
+	check_queries(handle);
+	check(!libr_glob(handle, "*", NULL, NULL), "no callback", TEST_COPY);
+	libr_close(handle);
+	
+	handle = reopen_copy(TEST_COPY);
+	check_queries(handle);
+	libr_close(handle);
+	return finish(TEST_COPY);
+}
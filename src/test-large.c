@@ -0,0 +1,85 @@
+/*
+ *
+ *  libr large resource test - Compress and read back resources larger than PARALLEL_MIN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+/*
+ * Resources of at least a megabyte are compressed (and seekable ones uncompressed) on every
+ * processor, the data of this test is large enough for that (and not a multiple of the block
+ * size) so that systems with more than one processor take the parallel paths.
+ */
+
+#include "test-common.h"
+
+/* For malloc/free */
+#include <stdlib.h>
+
+/* For string handling */
+#include <string.h>
+
+#define TEST_COPY                "test-large.elf"
+#define DATA_SIZE                ((size_t) 3*1024*1024+12345)
+#define RANGE_OFFSET             ((size_t) 2*1024*1024-7)
+#define RANGE_SIZE               ((size_t) 300*1024)
+
+static const struct {
+	const char *name;
+	libr_type_t type;
+} stored[] = {
+	{"zlib", LIBR_COMPRESSED},
+	{"seekable", LIBR_SEEKABLE},
+};
+
+int main(void)
+{
+	char *data, *buffer;
+	libr_stream *stream;
+	libr_file *handle;
+	size_t i, total, n;
+	
+	handle = open_copy(TEST_COPY);
+	if((data = (char *) malloc(DATA_SIZE)) == NULL || (buffer = (char *) malloc(DATA_SIZE)) == NULL)
+		return 1;
+	fill_data(data, DATA_SIZE, 0);
+	for(i = 0; i < sizeof(stored)/sizeof(stored[0]); i++)
+		check(libr_write(handle, (char *) stored[i].name, data, DATA_SIZE, stored[i].type, LIBR_NOOVERWRITE), "write", stored[i].name);
+	libr_close(handle);
+	
+	handle = reopen_copy(TEST_COPY);
+	for(i = 0; i < sizeof(stored)/sizeof(stored[0]); i++)
+	{
+		check_data(handle, stored[i].name, data, DATA_SIZE);
+		check(libr_read_range(handle, (char *) stored[i].name, RANGE_OFFSET, RANGE_SIZE, buffer)
+			&& memcmp(buffer, &data[RANGE_OFFSET], RANGE_SIZE) == 0, "range", stored[i].name);
+		/* The data compressed in pieces still reads back as one stream */
+		total = 0;
+		if((stream = libr_stream_open(handle, (char *) stored[i].name)) == NULL)
+			check(0, "stream open", stored[i].name);
+		else
+		{
+			while((n = libr_stream_read(stream, &buffer[total], DATA_SIZE-total < 65536 ? DATA_SIZE-total : 65536)) > 0)
+				total += n;
+			check(total == DATA_SIZE && memcmp(buffer, data, DATA_SIZE) == 0, "stream read", stored[i].name);
+			libr_stream_close(stream);
+		}
+	}
+	libr_close(handle);
+	free(buffer);
+	free(data);
+	return finish(TEST_COPY);
+}
@@ -0,0 +1,64 @@
+/*
+ *
+ *  libr map test - Map uncompressed resources straight from the binary
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "test-common.h"
+
+/* For malloc/free */
+#include <stdlib.h>
+
+/* For string handling */
+#include <string.h>
+
+#define TEST_COPY                "test-map.elf"
+#define DATA_SIZE                ((size_t) 300*1024)
+
+int main(void)
+{
+	const char *view, *again;
+	libr_file *handle;
+	size_t size;
+	char *data;
+	
+	handle = open_copy(TEST_COPY);
+	if((data = (char *) malloc(DATA_SIZE)) == NULL)
+		return 1;
+	fill_data(data, DATA_SIZE, 0);
+	check(libr_write(handle, "plain", data, DATA_SIZE, LIBR_UNCOMPRESSED, LIBR_NOOVERWRITE), "write", "plain");
+	check(libr_write(handle, "zlib", data, DATA_SIZE, LIBR_COMPRESSED, LIBR_NOOVERWRITE), "write", "zlib");
+	/* Only handles that read the file can be mapped */
+	check(libr_map(handle, "plain", &size) == NULL, "map for writing", "plain");
+	libr_close(handle);
+	
+	handle = reopen_copy(TEST_COPY);
+	view = libr_map(handle, "plain", &size);
+	check(view != NULL && size == DATA_SIZE && memcmp(view, data, DATA_SIZE) == 0, "map", "plain");
+	/* Every view shares the one mapping of the file */
+	again = libr_map(handle, "plain", NULL);
+	check(again == view, "second map", "plain");
+	check(again != NULL && libr_unmap(handle, again), "unmap", "plain");
+	check(view != NULL && libr_unmap(handle, view), "unmap", "plain");
+	/* Compressed data has to be read instead */
+	check(libr_map(handle, "zlib", &size) == NULL, "map", "zlib");
+	check_data(handle, "zlib", data, DATA_SIZE);
+	check(libr_map(handle, "missing", &size) == NULL && libr_errno() == LIBR_ERROR_NOSECTION, "map", "missing");
+	libr_close(handle);
+	free(data);
+	return finish(TEST_COPY);
+}
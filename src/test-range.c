@@ -0,0 +1,85 @@
+/*
+ *
+ *  libr range test - Read parts of resources with libr_read_range
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "test-common.h"
+
+/* For malloc/free */
+#include <stdlib.h>
+
+/* For string handling */
+#include <string.h>
+
+#define TEST_COPY                "test-range.elf"
+#define DATA_SIZE                ((size_t) 300*1024)
+#define BLOCK                    ((size_t) 64*1024)
+
+/* Ranges read from every resource: within a block, across blocks, the ends and nothing at all */
+static const struct {
+	size_t offset;
+	size_t length;
+} ranges[] = {
+	{0, 100},
+	{BLOCK-7, 5000},
+	{BLOCK/2, 3*BLOCK},
+	{DATA_SIZE-1000, 1000},
+	{0, DATA_SIZE},
+	{BLOCK, 0},
+};
+
+static const struct {
+	const char *name;
+	libr_type_t type;
+} stored[] = {
+	{"plain", LIBR_UNCOMPRESSED},
+	{"zlib", LIBR_COMPRESSED},
+	{"seekable", LIBR_SEEKABLE},
+};
+
+int main(void)
+{
+	char *data, *buffer;
+	libr_file *handle;
+	size_t i, j;
+	
+	handle = open_copy(TEST_COPY);
+	if((data = (char *) malloc(DATA_SIZE)) == NULL || (buffer = (char *) malloc(DATA_SIZE)) == NULL)
+		return 1;
+	fill_data(data, DATA_SIZE, 0);
+	for(i = 0; i < sizeof(stored)/sizeof(stored[0]); i++)
+		check(libr_write(handle, (char *) stored[i].name, data, DATA_SIZE, stored[i].type, LIBR_NOOVERWRITE), "write", stored[i].name);
+	libr_close(handle);
+	
+	handle = reopen_copy(TEST_COPY);
+	for(i = 0; i < sizeof(stored)/sizeof(stored[0]); i++)
+	{
+		check_data(handle, stored[i].name, data, DATA_SIZE);
+		for(j = 0; j < sizeof(ranges)/sizeof(ranges[0]); j++)
+		{
+			check(libr_read_range(handle, (char *) stored[i].name, ranges[j].offset, ranges[j].length, buffer)
+				&& memcmp(buffer, &data[ranges[j].offset], ranges[j].length) == 0, "range", stored[i].name);
+		}
+		/* Ranges past the end of the data are refused */
+		check(!libr_read_range(handle, (char *) stored[i].name, DATA_SIZE-10, 11, buffer), "range past the end", stored[i].name);
+	}
+	libr_close(handle);
+	free(buffer);
+	free(data);
+	return finish(TEST_COPY);
+}
@@ -0,0 +1,75 @@
+/*
+ *
+ *  libr C++ resource test - Read back the resources declared by the C++ compiler
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+/*
+ * Run by "make check" when the C++ compiler knows C++20: the resources built at compile time with
+ * libr-resource.hpp (named like their identifiers, as with LIBR_RESOURCE) and one declared with
+ * LIBR_RESOURCE from C++ are read back from the program's own binary.
+ */
+
+#include "libr-resource.hpp"
+extern "C" {
+#include "test-common.h"
+}
+
+/* For free */
+#include <cstdlib>
+
+/* For string handling */
+#include <cstring>
+
+static constexpr unsigned char table[] = {0x00, 0x01, 0x7F, 0x80, 0xFE, 0xFF, 'l', 'i', 'b', 'r'};
+
+LIBR_RESOURCE_CONSTEXPR(table_data, "table_data", table);
+LIBR_STRING_RESOURCE_CONSTEXPR(greeting, "greeting", "Hello from the C++ compiler");
+LIBR_RESOURCE(header, "libr-resource.h");
+
+/* The data is usable at compile time */
+static_assert(table_data.size() == sizeof(table) && table_data[3] == std::byte{0x80});
+static_assert(greeting.size() == 27 && greeting[0] == std::byte{'H'});
+
+/*
+ * Compare a resource read by libr with the data linked into the program
+ */
+static void check_resource(libr_file *handle, const char *name, const void *data, std::size_t size)
+{
+	std::size_t length = 0;
+	char *buffer;
+	
+	buffer = libr_malloc(handle, const_cast<char *>(name), &length);
+	check(buffer != NULL && length == size && std::memcmp(buffer, data, size) == 0, "read", name);
+	std::free(buffer);
+}
+
+int main()
+{
+	libr_file *handle;
+	
+	if((handle = libr_open(NULL, LIBR_READ)) == NULL)
+	{
+		check(0, "open", "/proc/self/exe");
+		return 1;
+	}
+	check_resource(handle, "table_data", table_data.data(), table_data.size());
+	check_resource(handle, "greeting", greeting.data(), greeting.size());
+	check_resource(handle, "header", LIBR_RESOURCE_DATA(header), LIBR_RESOURCE_SIZE(header));
+	libr_close(handle);
+	return finish(NULL);
+}
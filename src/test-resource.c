@@ -0,0 +1,74 @@
+/*
+ *
+ *  libr resource test - Read back the resources declared with LIBR_RESOURCE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+/*
+ * Run by "make check": the test program declares two of the headers in the source directory as
+ * resources (the assembler finds them through -Wa,-I$(srcdir)) and reads them back from its own
+ * binary with every backend, comparing them with the files.
+ */
+
+#include "libr-resource.h"
+#include "test-common.h"
+
+/* For free */
+#include <stdlib.h>
+
+/* For string handling */
+#include <string.h>
+
+LIBR_RESOURCE(header, "libr-resource.h");
+LIBR_RESOURCE_NAMED(api, "libr/api", "libr.h");
+
+/*
+ * Compare a declared resource with its file, with the data linked into the program and with libr
+ */
+static void check_resource(libr_file *handle, const char *name, const char *path, const unsigned char *data, size_t size)
+{
+	libr_resource_info info;
+	size_t length = 0;
+	const char *view;
+	char *buffer;
+	
+	buffer = load_file(path, &length);
+	check(buffer != NULL && length == size && memcmp(buffer, data, size) == 0, "linked data", name);
+	free(buffer);
+	buffer = libr_malloc(handle, (char *) name, &length);
+	check(buffer != NULL && length == size && memcmp(buffer, data, size) == 0, "read", name);
+	free(buffer);
+	check(libr_stat(handle, (char *) name, &info) && info.type == LIBR_UNCOMPRESSED && info.version == 2, "stat", name);
+	view = libr_map(handle, (char *) name, &length);
+	check(view != NULL && length == size && memcmp(view, data, size) == 0, "map", name);
+	check(view != NULL && libr_unmap(handle, view), "unmap", name);
+}
+
+int main(void)
+{
+	libr_file *handle;
+	
+	if((handle = libr_open(NULL, LIBR_READ)) == NULL)
+	{
+		check(0, "open", "/proc/self/exe");
+		return 1;
+	}
+	check_resource(handle, "header", "libr-resource.h", LIBR_RESOURCE_DATA(header), LIBR_RESOURCE_SIZE(header));
+	check_resource(handle, "libr/api", "libr.h", LIBR_RESOURCE_DATA(api), LIBR_RESOURCE_SIZE(api));
+	libr_close(handle);
+	return finish(NULL);
+}
@@ -0,0 +1,78 @@
+/*
+ *
+ *  libr shared handle test - Share one read-only handle between opens of a file
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "test-common.h"
+
+#define TEST_COPY                "test-shared.elf"
+#define DATA_SIZE                ((size_t) 10*1024)
+
+int main(void)
+{
+	libr_file *handle, *first, *second, *plain;
+	char data[DATA_SIZE], other[DATA_SIZE];
+	
+	fill_data(data, DATA_SIZE, 0);
+	fill_data(other, DATA_SIZE, 5);
+	handle = open_copy(TEST_COPY);
+	check(libr_write(handle, "shared", data, DATA_SIZE, LIBR_COMPRESSED, LIBR_NOOVERWRITE), "write", "shared");
+	libr_close(handle);
+	
+	/* Shared opens of the same file return the same handle, other opens get their own */
+	first = libr_open(TEST_COPY, LIBR_READ_SHARED);
+	second = libr_open(TEST_COPY, LIBR_READ_SHARED);
+	plain = libr_open(TEST_COPY, LIBR_READ);
+	check(first != NULL && second == first, "shared open", TEST_COPY);
+	check(plain != NULL && plain != first, "open", TEST_COPY);
+	if(first == NULL || plain == NULL)
+		return finish(TEST_COPY);
+	check_data(first, "shared", data, DATA_SIZE);
+	check_data(plain, "shared", data, DATA_SIZE);
+	libr_close(plain);
+	/* The handle lasts until every open has been closed */
+	libr_close(first);
+	check_data(second, "shared", data, DATA_SIZE);
+	
+	/* Once the file changes a shared open loads it again */
+	if((handle = libr_open(TEST_COPY, LIBR_READ_WRITE)) == NULL)
+		check(0, "open", TEST_COPY);
+	else
+	{
+		check(libr_write(handle, "shared", other, DATA_SIZE, LIBR_UNCOMPRESSED, LIBR_OVERWRITE), "over-write", "shared");
+		libr_close(handle);
+	}
+	first = libr_open(TEST_COPY, LIBR_READ_SHARED);
+	check(first != NULL && first != second, "shared open", "changed file");
+	if(first != NULL)
+	{
+		check_data(first, "shared", other, DATA_SIZE);
+		libr_close(first);
+	}
+	libr_close(second);
+	
+	/* After the last close the next shared open starts over */
+	first = libr_open(TEST_COPY, LIBR_READ_SHARED);
+	check(first != NULL, "shared open", TEST_COPY);
+	if(first != NULL)
+	{
+		check_data(first, "shared", other, DATA_SIZE);
+		libr_close(first);
+	}
+	return finish(TEST_COPY);
+}
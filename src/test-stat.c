@@ -0,0 +1,103 @@
+/*
+ *
+ *  libr stat test - Describe resources from their headers with libr_stat
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "test-common.h"
+
+/* For malloc/free */
+#include <stdlib.h>
+
+/* For checking the alignment of mapped data */
+#include <stdint.h>
+
+#define TEST_COPY                "test-stat.elf"
+#define DATA_SIZE                ((size_t) 100*1024)
+#define ALIGNMENT                ((size_t) 4096)
+
+static const struct {
+	const char *name;
+	libr_type_t type;
+} stored[] = {
+	{"plain", LIBR_UNCOMPRESSED},
+	{"zlib", LIBR_COMPRESSED},
+	{"seekable", LIBR_SEEKABLE},
+};
+
+/*
+ * CRC-32 (as computed by zlib) of a buffer
+ */
+static unsigned long crc32_of(const char *data, size_t size)
+{
+	unsigned long crc = 0xFFFFFFFFUL;
+	size_t i;
+	int bit;
+	
+	for(i = 0; i < size; i++)
+	{
+		crc ^= (unsigned char) data[i];
+		for(bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ (0xEDB88320UL & (0UL-(crc & 1)));
+	}
+	return crc ^ 0xFFFFFFFFUL;
+}
+
+int main(void)
+{
+	libr_resource_info info;
+	libr_file *handle;
+	const char *view;
+	char *data;
+	size_t i;
+	
+	handle = open_copy(TEST_COPY);
+	if((data = (char *) malloc(DATA_SIZE)) == NULL)
+		return 1;
+	fill_data(data, DATA_SIZE, 0);
+	for(i = 0; i < sizeof(stored)/sizeof(stored[0]); i++)
+		check(libr_write(handle, (char *) stored[i].name, data, DATA_SIZE, stored[i].type, LIBR_NOOVERWRITE), "write", stored[i].name);
+	/* Only powers of two up to 64 KiB are boundaries */
+	check(!libr_set_alignment(handle, 3) && !libr_set_alignment(handle, 128*1024), "alignment", TEST_COPY);
+	check(libr_set_alignment(handle, ALIGNMENT), "alignment", TEST_COPY);
+	fill_data(data, DATA_SIZE, 1);
+	check(libr_write(handle, "aligned", data, DATA_SIZE, LIBR_UNCOMPRESSED, LIBR_NOOVERWRITE), "write", "aligned");
+	libr_close(handle);
+	
+	handle = reopen_copy(TEST_COPY);
+	fill_data(data, DATA_SIZE, 0);
+	for(i = 0; i < sizeof(stored)/sizeof(stored[0]); i++)
+	{
+		check(libr_stat(handle, (char *) stored[i].name, &info), "stat", stored[i].name);
+		check(info.version == 2 && info.type == stored[i].type && info.size == DATA_SIZE && info.alignment == 1,
+			"description", stored[i].name);
+		check((info.flags & LIBR_FLAG_DIGEST) && info.digest == crc32_of(data, DATA_SIZE), "digest", stored[i].name);
+		check(info.type != LIBR_UNCOMPRESSED || info.stored_size == DATA_SIZE, "stored size", stored[i].name);
+		check(info.type == LIBR_UNCOMPRESSED || info.stored_size < DATA_SIZE, "stored size", stored[i].name);
+	}
+	fill_data(data, DATA_SIZE, 1);
+	check(libr_stat(handle, "aligned", &info) && info.alignment == ALIGNMENT, "stat", "aligned");
+	view = libr_map(handle, "aligned", NULL);
+	check(view != NULL && ((uintptr_t) view % ALIGNMENT) == 0, "aligned map", "aligned");
+	if(view != NULL)
+		libr_unmap(handle, view);
+	check_data(handle, "aligned", data, DATA_SIZE);
+	check(!libr_stat(handle, "missing", &info) && libr_errno() == LIBR_ERROR_NOSECTION, "stat", "missing");
+	libr_close(handle);
+	free(data);
+	return finish(TEST_COPY);
+}
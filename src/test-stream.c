@@ -0,0 +1,90 @@
+/*
+ *
+ *  libr stream test - Read resources a piece at a time
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "test-common.h"
+
+/* For malloc/free */
+#include <stdlib.h>
+
+/* For string handling */
+#include <string.h>
+
+#define TEST_COPY                "test-stream.elf"
+#define DATA_SIZE                ((size_t) 300*1024)
+#define PIECE_SIZE               ((size_t) 1000)
+
+/*
+ * Read a resource through a stream in uneven pieces and compare it with the data it was written with
+ */
+static void check_stream(libr_file *handle, const char *name, const char *data, size_t size)
+{
+	char buffer[PIECE_SIZE];
+	libr_stream *stream;
+	size_t total = 0, piece, n;
+	int same = 1;
+	
+	if((stream = libr_stream_open(handle, (char *) name)) == NULL)
+	{
+		check(0, "stream open", name);
+		return;
+	}
+	/* Every piece is full until the end of the resource */
+	for(piece = 1; (n = libr_stream_read(stream, buffer, piece)) > 0; piece = (piece+37) % PIECE_SIZE+1)
+	{
+		same &= (n == piece || total+n == size);
+		same &= (total+n <= size && memcmp(buffer, &data[total], n) == 0);
+		total += n;
+	}
+	check(libr_errno() == LIBR_OK, "stream end", name);
+	check(same && total == size, "stream read", name);
+	libr_stream_close(stream);
+}
+
+int main(void)
+{
+	libr_file *handle;
+	libr_stream *stream;
+	char buffer[16];
+	char *data;
+	
+	handle = open_copy(TEST_COPY);
+	if((data = (char *) malloc(DATA_SIZE)) == NULL)
+		return 1;
+	fill_data(data, DATA_SIZE, 0);
+	check(libr_write(handle, "plain", data, DATA_SIZE, LIBR_UNCOMPRESSED, LIBR_NOOVERWRITE), "write", "plain");
+	check(libr_write(handle, "zlib", data, DATA_SIZE, LIBR_COMPRESSED, LIBR_NOOVERWRITE), "write", "zlib");
+	check(libr_write(handle, "empty", "", 0, LIBR_COMPRESSED, LIBR_NOOVERWRITE), "write", "empty");
+	libr_close(handle);
+	
+	handle = reopen_copy(TEST_COPY);
+	check_stream(handle, "plain", data, DATA_SIZE);
+	check_stream(handle, "zlib", data, DATA_SIZE);
+	check_stream(handle, "empty", "", 0);
+	/* A stream can be closed part of the way through */
+	stream = libr_stream_open(handle, "zlib");
+	check(stream != NULL && libr_stream_read(stream, buffer, sizeof(buffer)) == sizeof(buffer)
+		&& memcmp(buffer, data, sizeof(buffer)) == 0, "partial read", "zlib");
+	if(stream != NULL)
+		libr_stream_close(stream);
+	check(libr_stream_open(handle, "missing") == NULL && libr_errno() == LIBR_ERROR_NOSECTION, "stream open", "missing");
+	libr_close(handle);
+	free(data);
+	return finish(TEST_COPY);
+}
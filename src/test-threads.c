@@ -0,0 +1,161 @@
+/*
+ *
+ *  libr thread test - Open handles and report errors from several threads at once
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+/*
+ * Every thread opens the program itself as its first call into libr, all of them released at the
+ * same moment, then makes calls that end with a different status in each thread.  The status and
+ * message each thread reads back must be the ones of its own last call.
+ */
+
+#include "test-common.h"
+
+/* For the threads */
+#include <pthread.h>
+
+/* For printing the thread numbers */
+#include <stdio.h>
+
+/* For string handling */
+#include <string.h>
+
+#define THREADS                  8
+#define ROUNDS                   200
+#define MESSAGE_SIZE             256
+
+typedef struct {
+	int index;
+	libr_file *handle;
+	libr_status opened;
+	int wrong_status;
+	int wrong_message;
+	char message[MESSAGE_SIZE];
+} worker;
+
+static pthread_barrier_t barrier;
+
+/*
+ * Accept every resource matched by libr_glob
+ */
+static int count_match(libr_file *handle, const char *name, void *data)
+{
+	return 1;
+}
+
+/*
+ * Make a call that leaves the status chosen for the thread
+ */
+static libr_status make_status(worker *thread)
+{
+	char name[32];
+	size_t size;
+	
+	switch(thread->index % 3)
+	{
+		case 0:
+			libr_glob(thread->handle, "*", count_match, NULL);
+			return LIBR_OK;
+		case 1:
+			snprintf(name, sizeof(name), "missing-%d", thread->index);
+			libr_size(thread->handle, name, &size);
+			return LIBR_ERROR_NOSECTION;
+		default:
+			libr_set_alignment(thread->handle, 3);
+			return LIBR_ERROR_INVALIDPARAMS;
+	}
+}
+
+/*
+ * Open the program at the same time as the other threads, then check the status of every call
+ */
+static void *run_worker(void *data)
+{
+	worker *thread = (worker *) data;
+	libr_status expected;
+	const char *message;
+	int round;
+	
+	pthread_barrier_wait(&barrier);
+	thread->handle = libr_open(NULL, (thread->index % 2 ? LIBR_READ_SHARED : LIBR_READ));
+	thread->opened = libr_errno();
+	pthread_barrier_wait(&barrier);
+	for(round = 0; round < ROUNDS; round++)
+	{
+		expected = (thread->handle != NULL ? make_status(thread) : LIBR_OK);
+		/* Every other thread has made its own call by now */
+		pthread_barrier_wait(&barrier);
+		thread->wrong_status += (libr_errno() != expected && thread->handle != NULL);
+		if(thread->handle != NULL && expected != LIBR_OK)
+		{
+			/* The message must not have been replaced by the call of another thread */
+			if((message = libr_errmsg()) == NULL)
+				thread->wrong_message++;
+			else if(round == 0)
+				strncpy(thread->message, message, MESSAGE_SIZE-1);
+			else
+				thread->wrong_message += (strcmp(thread->message, message) != 0);
+		}
+		pthread_barrier_wait(&barrier);
+	}
+	return NULL;
+}
+
+int main(void)
+{
+	pthread_t threads[THREADS];
+	worker workers[THREADS];
+	libr_file *shared = NULL;
+	char name[32];
+	int i;
+	
+	memset(workers, 0, sizeof(workers));
+	if(pthread_barrier_init(&barrier, NULL, THREADS) != 0)
+		return 1;
+	for(i = 0; i < THREADS; i++)
+	{
+		workers[i].index = i;
+		if(pthread_create(&threads[i], NULL, run_worker, &workers[i]) != 0)
+			return 1;
+	}
+	for(i = 0; i < THREADS; i++)
+		pthread_join(threads[i], NULL);
+	pthread_barrier_destroy(&barrier);
+	
+	for(i = 0; i < THREADS; i++)
+	{
+		snprintf(name, sizeof(name), "thread %d", i);
+		check(workers[i].handle != NULL && workers[i].opened == LIBR_OK, "first open", name);
+		check(workers[i].wrong_status == 0, "status", name);
+		check(workers[i].wrong_message == 0, "message", name);
+		if(i % 2 == 0 || workers[i].handle == NULL)
+			continue;
+		/* The shared opens all returned the handle of whichever thread opened the file first */
+		if(shared == NULL)
+			shared = workers[i].handle;
+		check(workers[i].handle == shared, "shared open", name);
+	}
+	/* The threads reporting different errors read different messages */
+	check(strcmp(workers[1].message, workers[2].message) != 0, "message", "thread 1");
+	for(i = 0; i < THREADS; i++)
+	{
+		if(workers[i].handle != NULL)
+			libr_close(workers[i].handle);
+	}
+	return finish(NULL);
+}
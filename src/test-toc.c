@@ -0,0 +1,107 @@
+/*
+ *
+ *  libr table of contents test - Look resources up without scanning the sections
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "test-common.h"
+
+/* For string handling */
+#include <string.h>
+
+#define TEST_COPY                "test-toc.elf"
+#define DATA_SIZE                ((size_t) 20*1024)
+
+/* Resources written to the copy, in sections of their own or in the archive */
+static const struct {
+	const char *name;
+	libr_type_t type;
+	int archived;
+	size_t size;
+} written[] = {
+	{"plain", LIBR_UNCOMPRESSED, 0, DATA_SIZE},
+	{"zlib", LIBR_COMPRESSED, 0, DATA_SIZE/2},
+	{"empty", LIBR_UNCOMPRESSED, 0, 0},
+	{"packed/one", LIBR_UNCOMPRESSED, 1, 100},
+	{"packed/two", LIBR_COMPRESSED, 1, DATA_SIZE},
+};
+
+#define WRITTEN                  (sizeof(written)/sizeof(written[0]))
+
+/*
+ * Walk the resources through the table of contents, checking each against the list written
+ */
+static void check_toc(libr_file *handle, size_t expected, const char *skip)
+{
+	size_t count = 0, i;
+	libr_iter iter;
+	
+	check(libr_iter_begin(handle, &iter), "iterate", TEST_COPY);
+	check(iter.indexed, "table of contents", TEST_COPY);
+	while(libr_iter_next(&iter))
+	{
+		count++;
+		for(i = 0; i < WRITTEN && strcmp(written[i].name, iter.name) != 0; i++);
+		check(i < WRITTEN && (skip == NULL || strcmp(iter.name, skip) != 0), "listed", iter.name);
+		if(i < WRITTEN)
+			check(iter.size == written[i].size && iter.type == written[i].type, "entry", iter.name);
+	}
+	check(count == expected && libr_resources(handle) == expected, "resource count", TEST_COPY);
+}
+
+int main(void)
+{
+	char data[DATA_SIZE];
+	libr_file *handle;
+	size_t i, size;
+	
+	handle = open_copy(TEST_COPY);
+	fill_data(data, DATA_SIZE, 3);
+	for(i = 0; i < WRITTEN; i++)
+	{
+		check(libr_set_archive(handle, written[i].archived), "archive", written[i].name);
+		check(libr_write(handle, (char *) written[i].name, data, written[i].size, written[i].type, LIBR_NOOVERWRITE), "write", written[i].name);
+	}
+	libr_close(handle);
+	check(libr_errno() == LIBR_OK, "close", TEST_COPY);
+	
+	/* A new handle answers lookups from the table of contents written on close */
+	handle = reopen_copy(TEST_COPY);
+	check_toc(handle, WRITTEN, NULL);
+	for(i = 0; i < WRITTEN; i++)
+		check(libr_size(handle, (char *) written[i].name, &size) && size == written[i].size, "size", written[i].name);
+	check(!libr_size(handle, "missing", &size) && libr_errno() == LIBR_ERROR_NOSECTION, "lookup", "missing");
+	check_data(handle, "zlib", data, DATA_SIZE/2);
+	check_data(handle, "packed/two", data, DATA_SIZE);
+	libr_close(handle);
+	
+	/* Changing the resources rewrites the table of contents */
+	if((handle = libr_open(TEST_COPY, LIBR_READ_WRITE)) == NULL)
+		check(0, "open", TEST_COPY);
+	else
+	{
+		check(libr_clear(handle, "zlib"), "clear", "zlib");
+		libr_close(handle);
+		check(libr_errno() == LIBR_OK, "close", TEST_COPY);
+	}
+	handle = reopen_copy(TEST_COPY);
+	check_toc(handle, WRITTEN-1, "zlib");
+	check(!libr_size(handle, "zlib", &size) && libr_errno() == LIBR_ERROR_NOSECTION, "cleared", "zlib");
+	check_data(handle, "plain", data, DATA_SIZE);
+	libr_close(handle);
+	return finish(TEST_COPY);
+}
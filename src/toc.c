@@ -0,0 +1,407 @@
+/*
+ *
+ *  libr table of contents - Describe every resource from a single section
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+/*
+ * Layout of the table of contents section (host byte order, like the resource headers):
+ *   "TOC1", uint32 number of entries, uint32 bytes of names, uint32 stamp of the section names,
+ *   uint32 number of sections, uint32 reserved, uint64 size of the archive section
+ *   entries, in the order the resources were listed when the table was written:
+ *     uint64 size, uint64 stored size, uint64 length of the section (or archive entry),
+ *     uint32 name offset, uint32 digest, uint32 alignment, uint8 type, uint8 version,
+ *     uint8 flags, uint8 stored in the archive
+ *   names, each followed by a NUL
+ *
+ * The table is only trusted while the sections of the file still match it: the names of the
+ * sections must hash to the stamp and every resource must be the recorded length.  Anything
+ * else (such as a resource written by a tool that does not know about the table) makes libr
+ * ignore the table and probe the sections instead.
+ */
+
+#include "toc.h"
+#include "archive.h"
+
+/* For malloc/free */
+#include <stdlib.h>
+
+/* For string handling */
+#include <string.h>
+
+#define TOC_MAGIC                "TOC1"
+#define TOC_HEADER               ((size_t) 32)
+#define TOC_ENTRY                ((size_t) 40)
+#define TOC_MINSIZE              16
+#define OFFSET_COUNT             4
+#define OFFSET_NAMES             8
+#define OFFSET_STAMP             12
+#define OFFSET_SECTIONS          16
+#define OFFSET_PACKSIZE          24
+#define ENTRY_SIZE               0
+#define ENTRY_STORED             8
+#define ENTRY_LENGTH             16
+#define ENTRY_NAME               24
+#define ENTRY_DIGEST             28
+#define ENTRY_ALIGNMENT          32
+#define ENTRY_TYPE               36
+#define ENTRY_VERSION            37
+#define ENTRY_FLAGS              38
+#define ENTRY_PACKED             39
+
+/*
+ * Summarize the names of the sections of the file (in any order, leaving out the table itself)
+ */
+static void section_stamp(libr_file *file_handle, uint32_t *stamp, uint32_t *sections)
+{
+	libr_section *scn = NULL;
+	char *name;
+	
+	*stamp = 0;
+	*sections = 0;
+	while((scn = next_section(file_handle, scn)) != NULL)
+	{
+		name = section_name(file_handle, scn);
+		if(name == NULL || section_size(file_handle, scn) == 0 || strcmp(name, TOC_SECTION) == 0)
+			continue;
+		*stamp += nameindex_hash(name);
+		(*sections)++;
+	}
+}
+
+/*
+ * Size of the section holding a resource (0 when it does not exist)
+ */
+static uint64_t stored_length(libr_file *file_handle, const char *name)
+{
+	libr_section *scn = NULL;
+	
+	if(find_section(file_handle, (char *) name, &scn).status != LIBR_OK)
+		return 0;
+	return section_size(file_handle, scn);
+}
+
+/*
+ * Read the table of contents section (only done once per handle)
+ */
+static void toc_load(libr_file *file_handle)
+{
+	uint32_t count, names_size, stamp, sections, file_stamp, file_sections, field;
+	char header[TOC_HEADER], *table, *names;
+	size_t section_length, table_size;
+	libr_toc *toc = &file_handle->front.toc;
+	libr_section *scn = NULL;
+	uint64_t pack_size;
+	unsigned long i;
+	
+	/* Loaded images and sources for linking have no sections to describe */
+	if(toc->loaded || toc->changed || file_handle->front.image.loaded || file_handle->front.embed.enabled)
+		return;
+	toc->loaded = true;
+	if(find_section(file_handle, TOC_SECTION, &scn).status != LIBR_OK)
+		return;
+	section_length = section_size(file_handle, scn);
+	if(read_section(file_handle, scn, 0, header, TOC_HEADER) != TOC_HEADER
+		|| memcmp(header, TOC_MAGIC, strlen(TOC_MAGIC)) != 0)
+		return;
+	memcpy(&count, &header[OFFSET_COUNT], sizeof(uint32_t));
+	memcpy(&names_size, &header[OFFSET_NAMES], sizeof(uint32_t));
+	memcpy(&stamp, &header[OFFSET_STAMP], sizeof(uint32_t));
+	memcpy(&sections, &header[OFFSET_SECTIONS], sizeof(uint32_t));
+	memcpy(&pack_size, &header[OFFSET_PACKSIZE], sizeof(uint64_t));
+	if(count > (section_length-TOC_HEADER)/TOC_ENTRY || names_size > section_length-TOC_HEADER-count*TOC_ENTRY)
+		return;
+	/* A table written for a different set of sections no longer describes the file */
+	section_stamp(file_handle, &file_stamp, &file_sections);
+	if(file_stamp != stamp || file_sections != sections || stored_length(file_handle, ARCHIVE_SECTION) != pack_size)
+		return;
+	/* The whole table (and the names following it) is read at once */
+	table_size = count*TOC_ENTRY+names_size;
+	if((toc->table = (char *) malloc(table_size)) == NULL)
+		return;
+	table = toc->table;
+	names = &table[count*TOC_ENTRY];
+	toc->entries = (libr_tocentry *) malloc((count == 0 ? 1 : count)*sizeof(libr_tocentry));
+	if(toc->entries == NULL || read_section(file_handle, scn, TOC_HEADER, table, table_size) != table_size
+		|| !nameindex_init(&toc->index, count, false))
+		goto failed;
+	for(i=0;i<count;i++)
+	{
+		libr_tocentry *entry = &toc->entries[i];
+		char *record = &table[i*TOC_ENTRY];
+		
+		memcpy(&field, &record[ENTRY_NAME], sizeof(uint32_t));
+		if(field >= names_size || memchr(&names[field], '\0', names_size-field) == NULL)
+			goto failed;
+		entry->name = &names[field];
+		memcpy(&entry->size, &record[ENTRY_SIZE], sizeof(uint64_t));
+		memcpy(&entry->stored_size, &record[ENTRY_STORED], sizeof(uint64_t));
+		memcpy(&entry->length, &record[ENTRY_LENGTH], sizeof(uint64_t));
+		memcpy(&entry->digest, &record[ENTRY_DIGEST], sizeof(uint32_t));
+		memcpy(&entry->alignment, &record[ENTRY_ALIGNMENT], sizeof(uint32_t));
+		entry->type = (libr_type_t) (unsigned char) record[ENTRY_TYPE];
+		entry->version = (unsigned char) record[ENTRY_VERSION];
+		entry->flags = (unsigned char) record[ENTRY_FLAGS];
+		entry->packed = (record[ENTRY_PACKED] != 0);
+		entry->checked = 0;
+		/* Archived resources were checked along with the size of the archive section */
+		if((!entry->packed && stored_length(file_handle, entry->name) != entry->length)
+			|| !nameindex_add(&toc->index, entry->name, entry))
+			goto failed;
+	}
+	toc->count = count;
+	toc->valid = true;
+	return;
+failed:
+	/* The table is only a shortcut, the sections are probed instead */
+	nameindex_free(&toc->index);
+	free(toc->entries);
+	free(toc->table);
+	toc->entries = NULL;
+	toc->table = NULL;
+}
+
+/*
+ * Check whether the resources can be looked up in the table of contents
+ */
+int toc_ready(libr_file *file_handle)
+{
+	toc_load(file_handle);
+	return file_handle->front.toc.valid;
+}
+
+/*
+ * Find a resource in the table of contents (NULL when the table cannot answer)
+ */
+libr_tocentry *toc_find(libr_file *file_handle, const char *name)
+{
+	if(file_handle == NULL || name == NULL || !toc_ready(file_handle))
+		return NULL;
+	return (libr_tocentry *) nameindex_find(&file_handle->front.toc.index, name);
+}
+
+/*
+ * Return a resource of the table of contents by position (NULL past the last entry)
+ */
+libr_tocentry *toc_entry(libr_file *file_handle, unsigned long index)
+{
+	if(!toc_ready(file_handle) || index >= file_handle->front.toc.count)
+		return NULL;
+	return &file_handle->front.toc.entries[index];
+}
+
+/*
+ * Stop answering from the table of contents, it is written again with the changes
+ */
+void toc_changed(libr_file *file_handle)
+{
+	toc_free(file_handle);
+	file_handle->front.toc.changed = true;
+}
+
+/*
+ * Remove the table of contents section once the last resource is gone
+ */
+static libr_intstatus toc_clear(libr_file *file_handle, libr_section *scn)
+{
+	libr_data *data;
+	libr_intstatus ret;
+	
+	if((data = get_data(file_handle, scn)) == NULL)
+		RETURN(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+	ret = set_data(file_handle, scn, data, 0, NULL, 0);
+	free_data(file_handle, scn, data);
+	if(ret.status != LIBR_OK)
+		return ret;
+	return remove_section(file_handle, scn);
+}
+
+/*
+ * Append the description of a resource to a table that is being built
+ */
+static int toc_add(libr_toc *toc, unsigned long *max, const char *name, libr_resource_info *info, uint64_t length, int packed)
+{
+	libr_tocentry *entry;
+	
+	if(toc->count == *max)
+	{
+		unsigned long grown = (*max == 0 ? TOC_MINSIZE : *max*2);
+		
+		if((entry = (libr_tocentry *) realloc(toc->entries, grown*sizeof(libr_tocentry))) == NULL)
+			return false;
+		toc->entries = entry;
+		*max = grown;
+	}
+	entry = &toc->entries[toc->count];
+	if((entry->name = strdup(name)) == NULL)
+		return false;
+	entry->size = info->size;
+	entry->stored_size = info->stored_size;
+	entry->length = length;
+	entry->digest = info->digest;
+	entry->alignment = info->alignment;
+	entry->type = info->type;
+	entry->version = info->version;
+	entry->flags = info->flags;
+	entry->packed = packed;
+	entry->checked = 0;
+	toc->count++;
+	return true;
+}
+
+/*
+ * Lay out the table of contents section for the resources that were listed
+ */
+static char *toc_build(libr_file *file_handle, libr_toc *toc, size_t *table_size)
+{
+	size_t names_size = 0, name_position = 0;
+	uint32_t field, stamp, sections;
+	uint64_t pack_size;
+	unsigned long i;
+	char *buffer;
+	
+	for(i=0;i<toc->count;i++)
+		names_size += strlen(toc->entries[i].name)+1;
+	*table_size = TOC_HEADER+toc->count*TOC_ENTRY+names_size;
+	if((buffer = (char *) calloc(1, *table_size)) == NULL)
+		return NULL;
+	memcpy(buffer, TOC_MAGIC, strlen(TOC_MAGIC));
+	field = toc->count;
+	memcpy(&buffer[OFFSET_COUNT], &field, sizeof(uint32_t));
+	field = names_size;
+	memcpy(&buffer[OFFSET_NAMES], &field, sizeof(uint32_t));
+	section_stamp(file_handle, &stamp, &sections);
+	memcpy(&buffer[OFFSET_STAMP], &stamp, sizeof(uint32_t));
+	memcpy(&buffer[OFFSET_SECTIONS], &sections, sizeof(uint32_t));
+	pack_size = stored_length(file_handle, ARCHIVE_SECTION);
+	memcpy(&buffer[OFFSET_PACKSIZE], &pack_size, sizeof(uint64_t));
+	for(i=0;i<toc->count;i++)
+	{
+		char *record = &buffer[TOC_HEADER+i*TOC_ENTRY];
+		libr_tocentry *entry = &toc->entries[i];
+		
+		memcpy(&record[ENTRY_SIZE], &entry->size, sizeof(uint64_t));
+		memcpy(&record[ENTRY_STORED], &entry->stored_size, sizeof(uint64_t));
+		memcpy(&record[ENTRY_LENGTH], &entry->length, sizeof(uint64_t));
+		field = name_position;
+		memcpy(&record[ENTRY_NAME], &field, sizeof(uint32_t));
+		memcpy(&record[ENTRY_DIGEST], &entry->digest, sizeof(uint32_t));
+		memcpy(&record[ENTRY_ALIGNMENT], &entry->alignment, sizeof(uint32_t));
+		record[ENTRY_TYPE] = (char) entry->type;
+		record[ENTRY_VERSION] = (char) entry->version;
+		record[ENTRY_FLAGS] = (char) entry->flags;
+		record[ENTRY_PACKED] = (char) entry->packed;
+		strcpy(&buffer[TOC_HEADER+toc->count*TOC_ENTRY+name_position], entry->name);
+		name_position += strlen(entry->name)+1;
+	}
+	return buffer;
+}
+
+/*
+ * Write out the table of contents section for the resources of the handle
+ * NOTE: Must follow archive_flush, the table records where the archived resources ended up.
+ */
+libr_intstatus toc_flush(libr_file *file_handle)
+{
+	libr_toc *toc = &file_handle->front.toc, listed;
+	libr_section *scn = NULL;
+	libr_data *data = NULL;
+	libr_resource_info info;
+	unsigned long i, max = 0;
+	libr_packed *packed;
+	libr_intstatus ret;
+	size_t table_size;
+	libr_iter iter;
+	char *buffer;
+	
+	if(!toc->changed)
+		RETURN_OK;
+	/* Describe every resource the way the sections are probed without a table */
+	memset(&listed, 0, sizeof(libr_toc));
+	ret = SET_ERROR(LIBR_OK, NULL);
+	libr_iter_begin(file_handle, &iter);
+	while(ret.status == LIBR_OK && libr_iter_next(&iter))
+	{
+		uint64_t length;
+		int in_archive = (iter.section == NULL);
+		
+		if(!libr_stat(file_handle, (char *) iter.name, &info))
+			continue;
+		if(!in_archive)
+			length = section_size(file_handle, (libr_section *) iter.section);
+		else if(archive_find(file_handle, iter.name, &packed).status == LIBR_OK)
+			length = packed->length;
+		else
+			continue;
+		if(!toc_add(&listed, &max, iter.name, &info, length, in_archive))
+			ret = SET_ERROR(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+	}
+	if(ret.status == LIBR_OK)
+		ret = find_section(file_handle, TOC_SECTION, &scn);
+	if(ret.status == LIBR_ERROR_NOSECTION)
+	{
+		scn = NULL;
+		ret = SET_ERROR(LIBR_OK, NULL);
+	}
+	if(ret.status == LIBR_OK && listed.count == 0)
+	{
+		/* Nothing to describe */
+		if(scn != NULL)
+			ret = toc_clear(file_handle, scn);
+	}
+	else if(ret.status == LIBR_OK)
+	{
+		if(scn == NULL)
+		{
+			if((ret = add_section(file_handle, TOC_SECTION, &scn)).status == LIBR_OK && (data = new_data(file_handle, scn)) == NULL)
+				ret = SET_ERROR(LIBR_ERROR_NEWDATA, "Failed to create data for section");
+		}
+		else if((data = get_data(file_handle, scn)) == NULL)
+			ret = SET_ERROR(LIBR_ERROR_GETDATA, "Failed to obtain data of section");
+		/* The table has to exist before the section names are summarized */
+		if(ret.status == LIBR_OK && (buffer = toc_build(file_handle, &listed, &table_size)) == NULL)
+			ret = SET_ERROR(LIBR_ERROR_MEMALLOC, "Failed to allocate memory for data");
+		if(ret.status == LIBR_OK)
+		{
+			if((ret = set_data(file_handle, scn, data, 0, buffer, table_size)).status != LIBR_OK)
+				free_data(file_handle, scn, data);
+			free(buffer);
+		}
+	}
+	for(i=0;i<listed.count;i++)
+		free((char *) listed.entries[i].name);
+	free(listed.entries);
+	/* The table is read back from the section when it is next needed */
+	if(ret.status == LIBR_OK)
+		toc->changed = false;
+	return ret;
+}
+
+/*
+ * Release the table of contents of a handle
+ */
+void toc_free(libr_file *file_handle)
+{
+	libr_toc *toc = &file_handle->front.toc;
+	int changed = toc->changed;
+	
+	nameindex_free(&toc->index);
+	free(toc->entries);
+	free(toc->table);
+	memset(toc, 0, sizeof(libr_toc));
+	toc->changed = changed;
+}
@@ -0,0 +1,16 @@
+#ifndef __TOC_H
+#define __TOC_H
+
+#include "libr.h"
+
+/* Section describing every resource of the binary */
+#define TOC_SECTION ".libr.toc"
+
+int toc_ready(libr_file *file_handle);
+libr_tocentry *toc_find(libr_file *file_handle, const char *name);
+libr_tocentry *toc_entry(libr_file *file_handle, unsigned long index);
+void toc_changed(libr_file *file_handle);
+libr_intstatus toc_flush(libr_file *file_handle);
+void toc_free(libr_file *file_handle);
+
+#endif /* __TOC_H */